@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# Compares the start up cost of builds of xfce4-screenshooter, for example
+# one linked with libsoup and libxml2 and one loading the upload module:
+#
+#   bench/startup.sh /usr/bin/xfce4-screenshooter src/xfce4-screenshooter
+#
+# For each binary, prints the number of shared libraries mapped at start up,
+# the relocations processed by the dynamic linker and its time, and the
+# mean wall time of RUNS runs (20 by default) of a plain capture saved to a
+# temporary folder. A display is needed for the last measure.
+
+RUNS=${RUNS:-20}
+
+if [ $# -eq 0 ]; then
+  echo "Usage: $0 BINARY..." >&2
+  exit 1
+fi
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+for binary in "$@"; do
+  libraries=$(LD_TRACE_LOADED_OBJECTS=1 "$binary" | wc -l)
+
+  # ld.so prints its statistics on stderr when the program exits
+  statistics=$(LD_DEBUG=statistics "$binary" --version 2>&1 >/dev/null)
+  relocations=$(echo "$statistics" | sed -n 's/.*number of relocations: *//p' | head -n 1)
+  loader=$(echo "$statistics" | sed -n 's/.*total startup time in dynamic loader: *//p' | head -n 1)
+
+  start=$(date +%s%N)
+  i=0
+  while [ $i -lt "$RUNS" ]; do
+    "$binary" --fullscreen --save="$dir" --no-daemon >/dev/null 2>&1
+    i=$((i + 1))
+  done
+  end=$(date +%s%N)
+
+  echo "$binary"
+  echo "  shared libraries:    $libraries"
+  echo "  relocations:         $relocations"
+  echo "  dynamic loader time: $loader"
+  echo "  mean capture time:   $(( (end - start) / RUNS / 1000 )) us"
+
+  rm -f "$dir"/*
+done
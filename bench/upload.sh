@@ -0,0 +1,138 @@
+#!/bin/sh
+#
+# Measures what sharing one HTTP session between uploads saves, by sending
+# the same files with the custom upload service:
+#
+#   bench/upload.sh src/xfce4-screenshooter [URL]
+#
+# The files are first uploaded by a single process, over one session, then
+# by one process per file, each opening its own session. For each way,
+# prints the wall time per upload and the mean time spent resolving the
+# host, connecting and negotiating TLS, as reported by --timings. The
+# second time per upload also includes the start up of a process.
+#
+# Without URL, the files are sent to a local HTTP server started by this
+# script, which only shows the cost of the connections. Give the URL of an
+# HTTPS endpoint accepting POSTed forms to include the TLS handshakes.
+# FILES (20 by default) files are sent. A display is needed.
+
+FILES=${FILES:-20}
+
+if [ $# -lt 1 ] || [ $# -gt 2 ]; then
+  echo "Usage: $0 BINARY [URL]" >&2
+  exit 1
+fi
+
+binary=$1
+url=$2
+
+dir=$(mktemp -d) || exit 1
+server=
+trap '[ -n "$server" ] && kill "$server"; rm -rf "$dir"' EXIT
+
+# A 512x512 PNG of noise, which does not compress
+python3 - "$dir/image.png" <<'EOF'
+import os, struct, sys, zlib
+
+def chunk(kind, data):
+    return (struct.pack(">I", len(data)) + kind + data +
+            struct.pack(">I", zlib.crc32(kind + data) & 0xffffffff))
+
+size = 512
+rows = b"".join(b"\0" + os.urandom(size * 3) for _ in range(size))
+with open(sys.argv[1], "wb") as f:
+    f.write(b"\x89PNG\r\n\x1a\n")
+    f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", size, size, 8, 2, 0, 0, 0)))
+    f.write(chunk(b"IDAT", zlib.compress(rows)))
+    f.write(chunk(b"IEND", b""))
+EOF
+
+i=0
+while [ $i -lt "$FILES" ]; do
+  cp "$dir/image.png" "$dir/image-$i.png"
+  i=$((i + 1))
+done
+rm -f "$dir/image.png"
+
+if [ -z "$url" ]; then
+  # A keep-alive server answering each upload with a link
+  python3 - "$dir/port" <<'EOF' &
+import http.server, sys
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        if self.headers.get("Transfer-Encoding", "") == "chunked":
+            while True:
+                length = int(self.rfile.readline().split(b";")[0], 16)
+                self.rfile.read(length + 2)
+                if length == 0:
+                    break
+        else:
+            self.rfile.read(int(self.headers.get("Content-Length", 0)))
+
+        body = b"http://localhost/image.png"
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, *args):
+        pass
+
+httpd = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+with open(sys.argv[1], "w") as f:
+    f.write(str(httpd.server_address[1]))
+httpd.serve_forever()
+EOF
+  server=$!
+
+  while [ ! -s "$dir/port" ]; do
+    sleep 0.1
+  done
+
+  url="http://127.0.0.1:$(cat "$dir/port")/upload"
+fi
+
+cat > "$dir/rc" <<EOF
+[Global]
+custom_upload_url=$url
+EOF
+
+# Prints the mean of the dns, connect and tls timings read on stdin, in ms
+connections ()
+{
+  awk -F '\t' '/^timings/ {
+      for (i = 2; i <= NF; i++) {
+        split ($i, field, "=");
+        if (field[1] == "dns" || field[1] == "connect" || field[1] == "tls")
+          total += field[2];
+      }
+      n++;
+    }
+    END { if (n > 0) printf "%.1f ms\n", total / n * 1000; else print "-"; }'
+}
+
+start=$(date +%s%N)
+"$binary" --rc-file="$dir/rc" --upload-custom --jobs=1 --timings \
+  "$dir"/image-*.png 2>"$dir/shared" >/dev/null
+end=$(date +%s%N)
+shared=$(( (end - start) / FILES / 1000 ))
+
+start=$(date +%s%N)
+for file in "$dir"/image-*.png; do
+  "$binary" --rc-file="$dir/rc" --upload-custom --timings \
+    "$file" 2>>"$dir/separate" >/dev/null
+done
+end=$(date +%s%N)
+separate=$(( (end - start) / FILES / 1000 ))
+
+echo "$FILES uploads to $url"
+echo "  one session:"
+echo "    time per upload:       $shared us"
+echo "    connection per upload: $(connections < "$dir/shared")"
+echo "  one session per upload:"
+echo "    time per upload:       $separate us"
+echo "    connection per upload: $(connections < "$dir/separate")"
@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# Checks that interrupting a capture waiting for a stable screen gives the
+# capture up:
+#
+#   bench/when-stable.sh src/xfce4-screenshooter
+#
+# A fullscreen capture waits for the screen to be stable for a minute,
+# and is interrupted with SIGINT after a second. The program must exit
+# with a failure right away, without saving a screenshot. Then the same
+# is done with SIGTERM. A display is needed.
+
+if [ $# -ne 1 ]; then
+  echo "Usage: $0 BINARY" >&2
+  exit 1
+fi
+
+binary=$1
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+failed=0
+
+for signal in INT TERM; do
+  rm -f "$dir"/*.png
+
+  start=$(date +%s)
+  LC_ALL=C "$binary" --fullscreen --when-stable=60000 --no-daemon --save="$dir" \
+    2>"$dir/stderr" &
+  pid=$!
+
+  sleep 1
+  kill -"$signal" "$pid"
+  wait "$pid"
+  status=$?
+  end=$(date +%s)
+
+  if [ "$status" -eq 0 ]; then
+    echo "SIG$signal: exited with status 0" >&2
+    failed=1
+  elif [ $((end - start)) -ge 30 ]; then
+    echo "SIG$signal: the wait was not cancelled" >&2
+    failed=1
+  elif ls "$dir"/*.png >/dev/null 2>&1; then
+    echo "SIG$signal: a screenshot was saved" >&2
+    failed=1
+  elif ! grep -q "cancelled" "$dir/stderr"; then
+    echo "SIG$signal: the capture was killed, not cancelled" >&2
+    failed=1
+  else
+    echo "SIG$signal: cancelled, exit status $status"
+  fi
+done
+
+exit $failed
@@ -24,6 +24,9 @@
 #include "screenshooter-utils.h"
 #include "screenshooter-actions.h"
 #include "screenshooter-capture.h"
+#include "screenshooter-delay.h"
 #include "screenshooter-global.h"
+#include "screenshooter-headless.h"
+#include "screenshooter-settle.h"
 
 #endif
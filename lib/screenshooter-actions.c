@@ -19,6 +19,21 @@
 
 #include "screenshooter-actions.h"
 
+#include <signal.h>
+#include <glib-unix.h>
+
+
+
+/* A wait for a stable screen, SIGINT and SIGTERM cancel it */
+typedef struct
+{
+  ScreenshotData *sd;
+  GCancellable   *cancellable;
+  guint           sigint_id;
+  guint           sigterm_id;
+}
+StableWait;
+
 
 
 static void
@@ -33,21 +48,125 @@ cb_help_response (GtkWidget *dialog, gint response, gpointer unused)
 
 
 
+static void
+cb_captured (GdkPixbuf *screenshot, ScreenshotData *sd)
+{
+  sd->screenshot = screenshot;
+
+  if (sd->screenshot != NULL)
+    g_idle_add ((GSourceFunc) screenshooter_action_idle, sd);
+  else
+    {
+      sd->capturing = FALSE;
+
+      if (!sd->plugin)
+        gtk_main_quit ();
+    }
+}
+
+
+
+static void
+actions_capture (ScreenshotData *sd)
+{
+  gboolean own_ui = sd->own_ui;
+
+  /* The next capture may not follow a dialog */
+  sd->own_ui = FALSE;
+
+  screenshooter_take_screenshot (sd->region,
+                                 sd->delay,
+                                 sd->show_mouse,
+                                 sd->plugin,
+                                 own_ui,
+                                 sd->freeze_selection,
+                                 sd->cancellable,
+                                 (ScreenshooterCaptureFunc) cb_captured,
+                                 sd);
+}
+
+
+
+static gboolean
+cb_signal (GCancellable *cancellable)
+{
+  g_cancellable_cancel (cancellable);
+
+  return TRUE;
+}
+
+
+
+static void
+cb_stable (ScreenshooterSettleResult result, gint waited, StableWait *wait)
+{
+  ScreenshotData *sd = wait->sd;
+
+  g_source_remove (wait->sigint_id);
+  g_source_remove (wait->sigterm_id);
+  g_object_unref (wait->cancellable);
+  g_free (wait);
+
+  if (result == SCREENSHOOTER_SETTLE_QUIET)
+    g_print (_("The screen was stable after %d ms.\n"), waited);
+  else if (result == SCREENSHOOTER_SETTLE_TIMEOUT)
+    g_printerr (_("The screen was still changing after %d ms.\n"), waited);
+  else
+    {
+      /* A screenshot of a screen which may still change is not wanted */
+      g_printerr (_("The wait for a stable screen was cancelled, no"
+                    " screenshot was taken.\n"));
+
+      sd->aborted = TRUE;
+      sd->capturing = FALSE;
+
+      if (!sd->plugin)
+        gtk_main_quit ();
+
+      return;
+    }
+
+  actions_capture (sd);
+}
+
+
+
 /* Public */
 
 
 
 gboolean screenshooter_take_screenshot_idle (ScreenshotData *sd)
 {
-  sd->screenshot = screenshooter_take_screenshot (sd->region,
-                                                  sd->delay,
-                                                  sd->show_mouse,
-                                                  sd->plugin);
+  /* The main loop runs during the delay, the capture continues from
+   * callbacks and a second one must not start meanwhile */
+  if (sd->capturing)
+    return FALSE;
 
-  if (sd->screenshot != NULL)
-    g_idle_add ((GSourceFunc) screenshooter_action_idle, sd);
-  else if (!sd->plugin)
-    gtk_main_quit ();
+  sd->capturing = TRUE;
+
+  /* Wait for the screen to stop changing, for automated tests. A test
+   * interrupting the program meanwhile gets no screenshot and a failure
+   * exit status. */
+  if (sd->when_stable > 0 && sd->region != SELECT)
+    {
+      StableWait *wait = g_new0 (StableWait, 1);
+
+      wait->sd = sd;
+      wait->cancellable = sd->cancellable != NULL ?
+        g_object_ref (sd->cancellable) : g_cancellable_new ();
+      wait->sigint_id = g_unix_signal_add (SIGINT, (GSourceFunc) cb_signal,
+                                           wait->cancellable);
+      wait->sigterm_id = g_unix_signal_add (SIGTERM, (GSourceFunc) cb_signal,
+                                            wait->cancellable);
+
+      screenshooter_wait_for_stable_screen (sd->region,
+                                            sd->when_stable,
+                                            wait->cancellable,
+                                            (ScreenshooterSettleFunc) cb_stable,
+                                            wait);
+    }
+  else
+    actions_capture (sd);
 
   return FALSE;
 }
@@ -76,6 +195,7 @@ gboolean screenshooter_action_idle (ScreenshotData *sd)
             gtk_main_quit ();
 
           g_object_unref (sd->screenshot);
+          sd->capturing = FALSE;
           return FALSE;
         }
     }
@@ -122,21 +242,33 @@ gboolean screenshooter_action_idle (ScreenshotData *sd)
 
       if (screenshot_path != NULL)
         {
+          const ScreenshooterUploadModule *module = NULL;
+
+          if (sd->action != OPEN)
+            module = screenshooter_upload_module_get ();
+
           if (sd->action == OPEN)
             screenshooter_open_screenshot (screenshot_path, sd->app);
+          else if (module == NULL)
+            TRACE ("The upload module is not available");
           else if (sd->action == UPLOAD_IMGUR) {
-              screenshooter_upload_to_imgur           (screenshot_path,
+              module->upload_to_imgur                 (screenshot_path,
                                                        sd->title);
             }
           else if (sd->action == UPLOAD_IMGUR_COPY) {
-              screenshooter_upload_to_imgur_copy_link (screenshot_path,
+              module->upload_to_imgur_copy_link       (screenshot_path,
                                                        sd->title);
             }
+          else if (sd->action == UPLOAD_CUSTOM)
+            module->upload_to_custom (screenshot_path, sd->title,
+                                      sd->custom_upload);
+          else if (sd->action == UPLOAD_S3)
+            module->upload_to_s3 (screenshot_path, sd->s3);
           else
             {
               gchar *new_last_user = NULL;
 
-              screenshooter_upload_to_zimagez         (screenshot_path,
+              module->upload_to_zimagez               (screenshot_path,
                                                        sd->last_user,
                                                        sd->title,
                                                        &new_last_user);
@@ -156,7 +288,26 @@ gboolean screenshooter_action_idle (ScreenshotData *sd)
     gtk_main_quit ();
 
   g_object_unref (sd->screenshot);
+  sd->capturing = FALSE;
 
   return FALSE;
 }
 
+
+
+/* Loads the upload module and connects to the upload host of the action
+ * while the screenshot is taken */
+void screenshooter_action_warm_up (ScreenshotData *sd)
+{
+  const ScreenshooterUploadModule *module;
+
+  if (sd->action != UPLOAD && sd->action != UPLOAD_IMGUR &&
+      sd->action != UPLOAD_IMGUR_COPY && sd->action != UPLOAD_CUSTOM &&
+      sd->action != UPLOAD_S3)
+    return;
+
+  module = screenshooter_upload_module_get ();
+
+  if (module != NULL)
+    module->warm_up (sd);
+}
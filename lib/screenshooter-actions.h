@@ -24,10 +24,13 @@
 #include "screenshooter-capture.h"
 #include "screenshooter-global.h"
 #include "screenshooter-dialogs.h"
-#include "screenshooter-zimagez.h"
-#include "screenshooter-imgur.h"
+#include "screenshooter-custom-upload.h"
+#include "screenshooter-s3.h"
+#include "screenshooter-upload-module.h"
+#include "screenshooter-daemon.h"
 
 gboolean screenshooter_take_screenshot_idle (ScreenshotData *sd);
 gboolean screenshooter_action_idle          (ScreenshotData *sd);
+void     screenshooter_action_warm_up       (ScreenshotData *sd);
 
 #endif
@@ -18,9 +18,37 @@
  */
 
 #include "screenshooter-capture.h"
+#include "screenshooter-delay.h"
+#include "screenshooter-edge-map.h"
+#include "screenshooter-settle.h"
+#include "screenshooter-window-index.h"
 
 #define BACKGROUND_TRANSPARENCY 0.4
 
+/* Time nothing must be drawn on the screen after our windows were hidden,
+ * and longest wait for it, in milliseconds */
+#define UI_QUIET_PERIOD 100
+#define UI_TIMEOUT      1000
+
+/* Longest wait for a stable screen, in milliseconds */
+#define STABLE_TIMEOUT  10000
+
+/* Largest move of the selection to an edge of the frozen screen, in
+ * pixels */
+#define SNAP_DISTANCE   8
+
+/* Shortest time between two redraws of the selection, in milliseconds,
+ * the pointer motions in between are coalesced */
+#define REDRAW_INTERVAL 16
+
+/* The loupe shows LOUPE_PIXELS pixels of the frozen screen around the
+ * pointer, each LOUPE_ZOOM times larger, LOUPE_OFFSET pixels away from
+ * the pointer */
+#define LOUPE_PIXELS    21
+#define LOUPE_ZOOM      8
+#define LOUPE_SIZE      (LOUPE_PIXELS * LOUPE_ZOOM)
+#define LOUPE_OFFSET    24
+
 /* Rubberband data for composited environment */
 typedef struct
 {
@@ -32,6 +60,40 @@ typedef struct
   gint y_root;
   GdkRectangle rectangle;
   GdkRectangle rectangle_root;
+
+  /* The last pointer motion, which the next redraw applies, and the
+   * source of this redraw, 0 if none is pending */
+  gint pointer_x;
+  gint pointer_y;
+  gint pointer_x_root;
+  gint pointer_y_root;
+  guint pointer_state;
+  guint redraw_id;
+  GdkWindow *overlay;
+
+  /* The screen read before the selection in the frozen mode, and its
+   * copies on the X server which are painted inside and outside of the
+   * selection */
+  GdkPixbuf *frozen;
+  GdkPixmap *frozen_pixmap;
+  GdkPixmap *dimmed_pixmap;
+
+  /* The frame of the window under the pointer, which a click selects, its
+   * width is 0 if there is none */
+  ScreenshooterWindowIndex *windows;
+  GdkRectangle hover;
+
+  /* The edges of the frozen screen which the selection snaps to */
+  ScreenshooterEdgeMap *edges;
+
+  /* The magnified frozen screen around the pointer, which is rendered
+   * again by the redraws. loupe_pixel_x and loupe_pixel_y are the
+   * position of the pointer pixel in the loupe, loupe_rect its place on
+   * the window, its width is 0 if it is not shown yet. */
+  cairo_surface_t *loupe;
+  gint loupe_pixel_x;
+  gint loupe_pixel_y;
+  GdkRectangle loupe_rect;
 } RubberBandData;
 
 /* For non-composited environments */
@@ -43,13 +105,59 @@ typedef struct
   gint x1, y1; /* holds the position where the mouse was pressed */
   GdkGC *gc;
   GdkWindow *root_window;
+
+  /* The last pointer position, which the next redraw applies, and the
+   * source of this redraw, 0 if none is pending */
+  gint x2, y2;
+  guint redraw_id;
 } RbData;
 
+/* A capture waiting for the screen to settle or for its delay, it
+ * continues with next () at the end of the wait */
+typedef struct _CaptureJob CaptureJob;
+
+typedef void (*CaptureStep) (CaptureJob *job, gboolean elapsed);
+
+struct _CaptureJob
+{
+  gint region;
+  gint delay;
+  gboolean show_mouse;
+  GCancellable *cancellable;
+
+  /* The selected region, on the screen, and whether it is read with an
+   * alpha channel */
+  GdkRectangle area;
+  gboolean alpha;
+
+  CaptureStep next;
+
+  ScreenshooterCaptureFunc func;
+  gpointer user_data;
+};
+
 
 /* Prototypes */
 
 
 
+static void             capture_finish                      (CaptureJob     *job,
+                                                             GdkPixbuf      *screenshot);
+static void             wait_before_capture                 (CaptureJob     *job,
+                                                             gboolean        own_ui,
+                                                             const GdkRectangle *area,
+                                                             CaptureStep     next);
+static void             cb_settled                          (ScreenshooterSettleResult result,
+                                                             gint            waited,
+                                                             CaptureJob     *job);
+static void             cb_delay_elapsed                    (gboolean        elapsed,
+                                                             CaptureJob     *job);
+static void             capture_window                      (CaptureJob     *job,
+                                                             gboolean        elapsed);
+static void             capture_area                        (CaptureJob     *job,
+                                                             gboolean        elapsed);
+static void             capture_frozen                      (CaptureJob     *job,
+                                                             gboolean        elapsed);
 static GdkWindow       *get_active_window                   (GdkScreen      *screen,
                                                              gboolean       *needs_unref,
                                                              gboolean       *border);
@@ -64,10 +172,20 @@ static GdkPixbuf       *get_cursor_pixbuf                   (GdkDisplay *display
 static GdkPixbuf       *get_window_screenshot               (GdkWindow      *window,
                                                              gboolean        show_mouse,
                                                              gboolean        border);
+static void             snap_to_edges                       (RubberBandData *rbdata,
+                                                             guint           state,
+                                                             gint           *x,
+                                                             gint           *y);
+static void             render_loupe                        (RubberBandData *rbdata);
+static void             update_loupe                        (RubberBandData *rbdata);
+static void             update_selection                    (RubberBandData *rbdata);
+static gboolean         cb_redraw                           (RubberBandData *rbdata);
+static void             erase_rectangle                     (RbData         *rbdata);
+static gboolean         cb_redraw_rectangle                 (RbData         *rbdata);
 static GdkFilterReturn  region_filter_func                  (GdkXEvent      *xevent,
                                                              GdkEvent       *event,
                                                              RbData         *rbdata);
-static GdkPixbuf       *get_rectangle_screenshot            (gint delay);
+static gboolean         select_region                       (GdkRectangle   *area);
 static gboolean         cb_key_pressed                      (GtkWidget      *widget,
                                                              GdkEventKey    *event,
                                                              gboolean       *cancelled);
@@ -83,7 +201,9 @@ static gboolean         cb_button_released                  (GtkWidget      *wid
 static gboolean         cb_motion_notify                    (GtkWidget      *widget,
                                                              GdkEventMotion *event,
                                                              RubberBandData *rbdata);
-static GdkPixbuf       *get_rectangle_screenshot_composited (gint delay);
+static gboolean         select_region_composited            (gboolean        freeze,
+                                                             GdkRectangle   *area,
+                                                             GdkPixbuf     **screenshot);
 
 
 
@@ -91,6 +211,162 @@ static GdkPixbuf       *get_rectangle_screenshot_composited (gint delay);
 
 
 
+/* Gives the screenshot to the caller and frees @job */
+static void
+capture_finish (CaptureJob *job, GdkPixbuf *screenshot)
+{
+  ScreenshooterCaptureFunc func = job->func;
+  gpointer user_data = job->user_data;
+
+  if (job->cancellable != NULL)
+    g_object_unref (job->cancellable);
+
+  g_free (job);
+
+  func (screenshot, user_data);
+}
+
+
+
+/* Waits for the delay of @job, then continues the capture with @next,
+ * from the main loop. If our own windows were hidden right before, waits
+ * first until @area is repainted without them, which counts in the
+ * delay. */
+static void
+wait_before_capture (CaptureJob         *job,
+                     gboolean            own_ui,
+                     const GdkRectangle *area,
+                     CaptureStep         next)
+{
+  job->next = next;
+
+  if (own_ui)
+    screenshooter_settle_start (area, UI_QUIET_PERIOD, UI_TIMEOUT,
+                                job->cancellable,
+                                (ScreenshooterSettleFunc) cb_settled, job);
+  else
+    screenshooter_delay_start (job->delay, job->cancellable,
+                               (ScreenshooterDelayFunc) cb_delay_elapsed,
+                               job);
+}
+
+
+
+static void
+cb_settled (ScreenshooterSettleResult result, gint waited, CaptureJob *job)
+{
+  if (result == SCREENSHOOTER_SETTLE_CANCELLED)
+    job->next (job, FALSE);
+  else
+    screenshooter_delay_start (job->delay - waited, job->cancellable,
+                               (ScreenshooterDelayFunc) cb_delay_elapsed,
+                               job);
+}
+
+
+
+static void
+cb_delay_elapsed (gboolean elapsed, CaptureJob *job)
+{
+  job->next (job, elapsed);
+}
+
+
+
+/* Reads the entire screen or the active window */
+static void
+capture_window (CaptureJob *job, gboolean elapsed)
+{
+  GdkPixbuf *screenshot = NULL;
+  GdkWindow *window;
+  gboolean border;
+
+  /* gdk_get_default_root_window () does not need to be unrefed,
+   * needs_unref enables us to unref *window only if a non default
+   * window has been grabbed. */
+  gboolean needs_unref = TRUE;
+
+  if (!elapsed)
+    {
+      capture_finish (job, NULL);
+      return;
+    }
+
+  /* Get the window/desktop we want to screenshot*/
+  if (job->region == FULLSCREEN)
+    {
+      TRACE ("We grab the entire screen");
+
+      window = gdk_get_default_root_window ();
+      needs_unref = FALSE;
+      border = FALSE;
+    }
+  else
+    {
+      TRACE ("We grab the active window");
+
+      window = get_active_window (gdk_screen_get_default (), &needs_unref,
+                                  &border);
+    }
+
+  TRACE ("Get the screenshot of the given window");
+
+  screenshot = get_window_screenshot (window, job->show_mouse, border);
+
+  if (needs_unref)
+    g_object_unref (window);
+
+  capture_finish (job, screenshot);
+}
+
+
+
+/* Reads the selected region */
+static void
+capture_area (CaptureJob *job, gboolean elapsed)
+{
+  GdkPixbuf *screenshot = NULL;
+  GdkWindow *root = gdk_get_default_root_window ();
+
+  if (elapsed)
+    {
+      TRACE ("Get the pixbuf for the screenshot");
+
+      if (job->alpha)
+        {
+          screenshot = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                       job->area.width, job->area.height);
+          gdk_pixbuf_get_from_drawable (screenshot, root, NULL,
+                                        job->area.x, job->area.y, 0, 0,
+                                        job->area.width, job->area.height);
+        }
+      else
+        screenshot = gdk_pixbuf_get_from_drawable (NULL, root, NULL,
+                                                   job->area.x, job->area.y,
+                                                   0, 0, job->area.width,
+                                                   job->area.height);
+    }
+
+  capture_finish (job, screenshot);
+}
+
+
+
+/* Lets the user select the region on a still image of the screen, once
+ * the delay elapsed */
+static void
+capture_frozen (CaptureJob *job, gboolean elapsed)
+{
+  GdkPixbuf *screenshot = NULL;
+
+  if (elapsed)
+    select_region_composited (TRUE, &job->area, &screenshot);
+
+  capture_finish (job, screenshot);
+}
+
+
+
 static GdkWindow
 *get_active_window (GdkScreen *screen,
                     gboolean  *needs_unref,
@@ -505,64 +781,188 @@ static gboolean cb_expose (GtkWidget *widget,
                            GdkEventExpose *event,
                            RubberBandData *rbdata)
 {
-  GdkRectangle *rects = NULL;
-  gint n_rects = 0, i;
+  GdkRectangle *highlight = NULL;
+  GdkRectangle clipbox, intersect;
+  gboolean highlighted;
+  cairo_t *cr;
 
   TRACE ("Expose event received.");
 
-  gdk_region_get_rectangles (event->region, &rects, &n_rects);
-
+  /* The rubber banding rectangle, else the window under the pointer */
   if (rbdata->rubber_banding)
-    {
-      GdkRectangle intersect;
-      cairo_t *cr;
+    highlight = &rbdata->rectangle;
+  else if (rbdata->hover.width > 0)
+    highlight = &rbdata->hover;
 
-      cr = gdk_cairo_create (GDK_DRAWABLE (widget->window));
-      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  gdk_region_get_clipbox (event->region, &clipbox);
+  highlighted = highlight != NULL &&
+    gdk_rectangle_intersect (&clipbox, highlight, &intersect);
 
-      for (i = 0; i < n_rects; ++i)
-        {
-          /* Restore the transparent background */
-          cairo_set_source_rgba (cr, 0, 0, 0, BACKGROUND_TRANSPARENCY);
-          gdk_cairo_rectangle (cr, &rects[i]);
-          cairo_fill (cr);
-
-          if (!gdk_rectangle_intersect (&rects[i],
-                                        &rbdata->rectangle,
-                                        &intersect))
-            {
-              continue;
-            }
+  cr = gdk_cairo_create (GDK_DRAWABLE (widget->window));
 
-          /* Paint the rubber banding rectangles */
-          cairo_set_source_rgba (cr, 1.0f, 1.0f, 1.0f, 0.0f);
-          gdk_cairo_rectangle (cr, &intersect);
-          cairo_fill (cr);
-        }
+  gdk_cairo_region (cr, event->region);
+  cairo_clip (cr);
 
-      cairo_destroy (cr);
-    }
+  /* Every pixel is painted once: the darkened screen outside of the
+   * highlighted rectangle, then the screen inside of it */
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+
+  if (rbdata->frozen_pixmap != NULL)
+    gdk_cairo_set_source_pixmap (cr, rbdata->dimmed_pixmap, 0, 0);
   else
+    cairo_set_source_rgba (cr, 0, 0, 0, BACKGROUND_TRANSPARENCY);
+
+  gdk_cairo_rectangle (cr, &clipbox);
+
+  if (highlighted)
+    gdk_cairo_rectangle (cr, &intersect);
+
+  cairo_fill (cr);
+
+  if (highlighted)
+    {
+      if (rbdata->frozen_pixmap != NULL)
+        gdk_cairo_set_source_pixmap (cr, rbdata->frozen_pixmap, 0, 0);
+      else
+        cairo_set_source_rgba (cr, 1.0f, 1.0f, 1.0f, 0.0f);
+
+      gdk_cairo_rectangle (cr, &intersect);
+      cairo_fill (cr);
+    }
+
+  /* Paint the cached loupe over the rest, with the pixel under the
+   * pointer framed */
+  if (rbdata->loupe_rect.width > 0 &&
+      gdk_region_rect_in (event->region,
+                          &rbdata->loupe_rect) != GDK_OVERLAP_RECTANGLE_OUT)
     {
-      cairo_t *cr;
+      GdkRectangle *loupe = &rbdata->loupe_rect;
 
-      /* Draw the transparent background */
-      cr = gdk_cairo_create (GDK_DRAWABLE (widget->window));
-      cairo_set_source_rgba (cr, 0, 0, 0, BACKGROUND_TRANSPARENCY);
       cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_set_source_rgb (cr, 1.0, 1.0, 1.0);
+      gdk_cairo_rectangle (cr, loupe);
+      cairo_fill (cr);
+
+      cairo_set_source_surface (cr, rbdata->loupe, loupe->x + 1, loupe->y + 1);
+      cairo_rectangle (cr, loupe->x + 1, loupe->y + 1, LOUPE_SIZE, LOUPE_SIZE);
+      cairo_fill (cr);
+
+      cairo_set_source_rgb (cr, 1.0, 0.0, 0.0);
+      cairo_set_line_width (cr, 1.0);
+      cairo_rectangle (cr,
+                       loupe->x + 1 + rbdata->loupe_pixel_x * LOUPE_ZOOM + 0.5,
+                       loupe->y + 1 + rbdata->loupe_pixel_y * LOUPE_ZOOM + 0.5,
+                       LOUPE_ZOOM - 1, LOUPE_ZOOM - 1);
+      cairo_stroke (cr);
+    }
+
+  cairo_destroy (cr);
+
+  return FALSE;
+}
+
+
+
+/* Moves x and y to the closest edges of the frozen screen, unless Control
+ * is held. The selection window covers the screen from its origin. */
+static void
+snap_to_edges (RubberBandData *rbdata, guint state, gint *x, gint *y)
+{
+  gint snapped_x, snapped_y;
+
+  if (rbdata->edges == NULL || (state & GDK_CONTROL_MASK))
+    return;
+
+  snapped_x = screenshooter_edge_map_snap_x (rbdata->edges, *x, *y,
+                                             SNAP_DISTANCE);
+  snapped_y = screenshooter_edge_map_snap_y (rbdata->edges, *x, *y,
+                                             SNAP_DISTANCE);
+
+  *x = snapped_x;
+  *y = snapped_y;
+}
+
 
-      for (i = 0; i < n_rects; ++i)
+
+/* Magnifies the frozen screen around the pointer into the loupe surface,
+ * repeating each pixel into a LOUPE_ZOOM wide run, then copying this row
+ * LOUPE_ZOOM - 1 times. Both loops are plain fills and copies, which the
+ * compiler and the C library vectorize. */
+static void
+render_loupe (RubberBandData *rbdata)
+{
+  const guchar *pixels = gdk_pixbuf_get_pixels (rbdata->frozen);
+  gint rowstride = gdk_pixbuf_get_rowstride (rbdata->frozen);
+  gint n_channels = gdk_pixbuf_get_n_channels (rbdata->frozen);
+  gint width = gdk_pixbuf_get_width (rbdata->frozen);
+  gint height = gdk_pixbuf_get_height (rbdata->frozen);
+  guchar *data;
+  gint stride, source_x, source_y, x, y, i;
+
+  /* Keep the magnified pixels on the screen */
+  source_x = CLAMP (rbdata->pointer_x - LOUPE_PIXELS / 2,
+                    0, MAX (width - LOUPE_PIXELS, 0));
+  source_y = CLAMP (rbdata->pointer_y - LOUPE_PIXELS / 2,
+                    0, MAX (height - LOUPE_PIXELS, 0));
+
+  rbdata->loupe_pixel_x = rbdata->pointer_x - source_x;
+  rbdata->loupe_pixel_y = rbdata->pointer_y - source_y;
+
+  cairo_surface_flush (rbdata->loupe);
+  data = cairo_image_surface_get_data (rbdata->loupe);
+  stride = cairo_image_surface_get_stride (rbdata->loupe);
+
+  for (y = 0; y < MIN (LOUPE_PIXELS, height); y++)
+    {
+      const guchar *source =
+        pixels + (source_y + y) * rowstride + source_x * n_channels;
+      guchar *first_row = data + y * LOUPE_ZOOM * stride;
+      guint32 *target = (guint32 *) first_row;
+
+      for (x = 0; x < MIN (LOUPE_PIXELS, width); x++, source += n_channels)
         {
-            gdk_cairo_rectangle (cr, &rects[i]);
-            cairo_fill (cr);
+          guint32 pixel = 0xff000000 | (source[0] << 16) |
+                          (source[1] << 8) | source[2];
+
+          for (i = 0; i < LOUPE_ZOOM; i++)
+            *target++ = pixel;
         }
 
-      cairo_destroy (cr);
+      for (i = 1; i < LOUPE_ZOOM; i++)
+        memcpy (first_row + i * stride, first_row, LOUPE_SIZE * 4);
     }
 
-  g_free (rects);
+  cairo_surface_mark_dirty (rbdata->loupe);
+}
+
 
-  return FALSE;
+
+/* Renders the loupe for the last pointer position and moves it next to
+ * the pointer, on the side where it fits on the screen */
+static void
+update_loupe (RubberBandData *rbdata)
+{
+  GdkRectangle rect;
+
+  render_loupe (rbdata);
+
+  /* The loupe has a one pixel border */
+  rect.width = rect.height = LOUPE_SIZE + 2;
+
+  rect.x = rbdata->pointer_x + LOUPE_OFFSET;
+  if (rect.x + rect.width > gdk_pixbuf_get_width (rbdata->frozen))
+    rect.x = rbdata->pointer_x - LOUPE_OFFSET - rect.width;
+
+  rect.y = rbdata->pointer_y + LOUPE_OFFSET;
+  if (rect.y + rect.height > gdk_pixbuf_get_height (rbdata->frozen))
+    rect.y = rbdata->pointer_y - LOUPE_OFFSET - rect.height;
+
+  if (rbdata->loupe_rect.width > 0)
+    gdk_window_invalidate_rect (rbdata->overlay, &rbdata->loupe_rect, FALSE);
+
+  gdk_window_invalidate_rect (rbdata->overlay, &rect, FALSE);
+  rbdata->loupe_rect = rect;
 }
 
 
@@ -573,13 +973,24 @@ static gboolean cb_button_pressed (GtkWidget *widget,
 {
   if (event->button == 1)
     {
+      gint x = event->x, y = event->y;
+
       TRACE ("Left button pressed");
 
+      /* Apply the motion before the press */
+      if (rbdata->redraw_id != 0)
+        {
+          g_source_remove (rbdata->redraw_id);
+          cb_redraw (rbdata);
+        }
+
+      snap_to_edges (rbdata, event->state, &x, &y);
+
       rbdata->left_pressed = TRUE;
-      rbdata->x = event->x;
-      rbdata->y = event->y;
-      rbdata->x_root = event->x_root;
-      rbdata->y_root = event->y_root;
+      rbdata->x = x;
+      rbdata->y = y;
+      rbdata->x_root = event->x_root + x - event->x;
+      rbdata->y_root = event->y_root + y - event->y;
 
       return TRUE;
     }
@@ -595,11 +1006,28 @@ static gboolean cb_button_released (GtkWidget *widget,
 {
   if (event->button == 1)
     {
+      /* Apply the motion which was not redrawn yet */
+      if (rbdata->redraw_id != 0)
+        {
+          g_source_remove (rbdata->redraw_id);
+          cb_redraw (rbdata);
+        }
+
       if (rbdata->rubber_banding)
         {
           gtk_dialog_response (GTK_DIALOG (widget), GTK_RESPONSE_NONE);
           return TRUE;
         }
+      else if (rbdata->left_pressed && rbdata->hover.width > 0)
+        {
+          /* A click selects the window under the pointer, the selection
+           * window covers the screen from its origin */
+          TRACE ("Select the window under the pointer");
+
+          rbdata->rectangle = rbdata->rectangle_root = rbdata->hover;
+          gtk_dialog_response (GTK_DIALOG (widget), GTK_RESPONSE_NONE);
+          return TRUE;
+        }
       else
         rbdata->left_pressed = rbdata->rubber_banding = FALSE;
     }
@@ -612,21 +1040,51 @@ static gboolean cb_button_released (GtkWidget *widget,
 static gboolean cb_motion_notify (GtkWidget *widget,
                                   GdkEventMotion *event,
                                   RubberBandData *rbdata)
+{
+  /* Only remember where the pointer is, the motions are coalesced until
+   * the next redraw */
+  rbdata->pointer_x = event->x;
+  rbdata->pointer_y = event->y;
+  rbdata->pointer_x_root = event->x_root;
+  rbdata->pointer_y_root = event->y_root;
+  rbdata->pointer_state = event->state;
+
+  if (rbdata->redraw_id == 0)
+    rbdata->redraw_id = g_timeout_add (REDRAW_INTERVAL,
+                                       (GSourceFunc) cb_redraw, rbdata);
+
+  return TRUE;
+}
+
+
+
+/* Applies the last pointer motion: updates the rubber banding rectangle
+ * or the highlighted window, and only invalidates what changed */
+static void
+update_selection (RubberBandData *rbdata)
 {
   if (rbdata->left_pressed)
     {
       GdkRectangle *new_rect, *new_rect_root;
       GdkRectangle old_rect, intersect;
       GdkRegion *region;
+      gint x = rbdata->pointer_x, y = rbdata->pointer_y, x_root, y_root;
 
-      TRACE ("Mouse is moving with left button pressed");
+      TRACE ("Update the rubber banding rectangle");
 
       new_rect = &rbdata->rectangle;
       new_rect_root = &rbdata->rectangle_root;
 
       if (!rbdata->rubber_banding)
         {
-          /* This is the start of a rubber banding */
+          /* This is the start of a rubber banding, which replaces the
+           * highlighted window */
+          if (rbdata->hover.width > 0)
+            {
+              gdk_window_invalidate_rect (rbdata->overlay, &rbdata->hover, TRUE);
+              rbdata->hover.width = rbdata->hover.height = 0;
+            }
+
           rbdata->rubber_banding = TRUE;
           old_rect.x = rbdata->x;
           old_rect.y = rbdata->y;
@@ -641,16 +1099,21 @@ static gboolean cb_motion_notify (GtkWidget *widget,
           old_rect.height = new_rect->height;
         }
 
+      /* Snap the dragged corner to the closest edges */
+      snap_to_edges (rbdata, rbdata->pointer_state, &x, &y);
+      x_root = rbdata->pointer_x_root + x - rbdata->pointer_x;
+      y_root = rbdata->pointer_y_root + y - rbdata->pointer_y;
+
       /* Get the new rubber banding rectangle */
-      new_rect->x = MIN (rbdata->x , event->x);
-      new_rect->y = MIN (rbdata->y, event->y);
-      new_rect->width = ABS (rbdata->x - event->x) + 1;
-      new_rect->height = ABS (rbdata->y - event->y) +1;
+      new_rect->x = MIN (rbdata->x , x);
+      new_rect->y = MIN (rbdata->y, y);
+      new_rect->width = ABS (rbdata->x - x) + 1;
+      new_rect->height = ABS (rbdata->y - y) +1;
 
-      new_rect_root->x = MIN (rbdata->x_root , event->x_root);
-      new_rect_root->y = MIN (rbdata->y_root, event->y_root);
-      new_rect_root->width = ABS (rbdata->x_root - event->x_root) + 1;
-      new_rect_root->height = ABS (rbdata->y_root - event->y_root) +1;
+      new_rect_root->x = MIN (rbdata->x_root , x_root);
+      new_rect_root->y = MIN (rbdata->y_root, y_root);
+      new_rect_root->width = ABS (rbdata->x_root - x_root) + 1;
+      new_rect_root->height = ABS (rbdata->y_root - y_root) +1;
 
       region = gdk_region_rectangle (&old_rect);
       gdk_region_union_with_rect (region, new_rect);
@@ -672,30 +1135,137 @@ static gboolean cb_motion_notify (GtkWidget *widget,
           gdk_region_destroy(region_intersect);
         }
 
-      gdk_window_invalidate_region (widget->window, region, TRUE);
+      gdk_window_invalidate_region (rbdata->overlay, region, TRUE);
       gdk_region_destroy (region);
+    }
+  else if (rbdata->windows != NULL)
+    {
+      GdkRectangle frame = { 0, 0, 0, 0 };
+      GdkRectangle screen = { 0, 0, gdk_screen_width (), gdk_screen_height () };
+
+      /* Highlight the window under the pointer, found in memory */
+      if (!screenshooter_window_index_lookup (rbdata->windows,
+                                              rbdata->pointer_x_root,
+                                              rbdata->pointer_y_root,
+                                              &frame) ||
+          !gdk_rectangle_intersect (&frame, &screen, &frame))
+        frame.width = frame.height = 0;
+
+      if (frame.x != rbdata->hover.x || frame.y != rbdata->hover.y ||
+          frame.width != rbdata->hover.width ||
+          frame.height != rbdata->hover.height)
+        {
+          if (rbdata->hover.width > 0)
+            gdk_window_invalidate_rect (rbdata->overlay, &rbdata->hover, TRUE);
 
-      return TRUE;
+          if (frame.width > 0)
+            gdk_window_invalidate_rect (rbdata->overlay, &frame, TRUE);
+
+          rbdata->hover = frame;
+        }
     }
+}
+
+
+
+static gboolean
+cb_redraw (RubberBandData *rbdata)
+{
+  rbdata->redraw_id = 0;
+
+  update_selection (rbdata);
+
+  if (rbdata->loupe != NULL)
+    update_loupe (rbdata);
 
   return FALSE;
 }
 
 
-static GdkPixbuf
-*get_rectangle_screenshot_composited (gint delay)
+/* Lets the user select a region on a fullscreen window which darkens the
+ * screen. With @freeze, the screen is read first and the window shows
+ * this still image, then the region is cut out of it into @screenshot.
+ * Otherwise the window is transparent, which needs a compositor, and
+ * @area is read by the caller. Returns FALSE if the selection was
+ * cancelled. */
+static gboolean
+select_region_composited (gboolean      freeze,
+                          GdkRectangle *area,
+                          GdkPixbuf   **screenshot)
 {
   GtkWidget *window;
   RubberBandData rbdata;
   gboolean cancelled = FALSE;
-  GdkPixbuf *screenshot;
   GdkWindow *root;
-  GdkCursor *xhair_cursor = gdk_cursor_new (GDK_CROSSHAIR);
+  GdkCursor *xhair_cursor;
+  cairo_t *cr;
+  gint width, height;
 
   /* Initialize the rubber band data */
   rbdata.left_pressed = FALSE;
   rbdata.rubber_banding = FALSE;
   rbdata.x = rbdata.y = 0;
+  rbdata.frozen = NULL;
+  rbdata.frozen_pixmap = NULL;
+  rbdata.hover.x = rbdata.hover.y = 0;
+  rbdata.hover.width = rbdata.hover.height = 0;
+  rbdata.edges = NULL;
+  rbdata.dimmed_pixmap = NULL;
+  rbdata.loupe = NULL;
+  rbdata.overlay = NULL;
+  rbdata.redraw_id = 0;
+  rbdata.loupe_rect.x = rbdata.loupe_rect.y = 0;
+  rbdata.loupe_rect.width = rbdata.loupe_rect.height = 0;
+
+  root = gdk_get_default_root_window ();
+  width = gdk_screen_get_width (gdk_screen_get_default ());
+  height = gdk_screen_get_height (gdk_screen_get_default ());
+
+  if (freeze)
+    {
+      /* Read the whole screen once, GDK uses shared memory for this when
+       * the X server allows it */
+      TRACE ("Freeze the screen");
+      rbdata.frozen = gdk_pixbuf_get_from_drawable (NULL, root, NULL,
+                                                    0, 0, 0, 0,
+                                                    width, height);
+
+      if (G_UNLIKELY (rbdata.frozen == NULL))
+        return FALSE;
+
+      /* Find the edges to snap to while the selection window shows up */
+      rbdata.edges = screenshooter_edge_map_new (rbdata.frozen);
+
+      /* Keep a copy on the server, the expose events only composite
+       * it */
+      rbdata.frozen_pixmap = gdk_pixmap_new (root, width, height, -1);
+      gdk_draw_pixbuf (rbdata.frozen_pixmap, NULL, rbdata.frozen,
+                       0, 0, 0, 0, width, height,
+                       GDK_RGB_DITHER_NONE, 0, 0);
+
+      /* and a darkened copy, so that the expose events do not darken
+       * the screen again */
+      rbdata.dimmed_pixmap = gdk_pixmap_new (root, width, height, -1);
+
+      cr = gdk_cairo_create (GDK_DRAWABLE (rbdata.dimmed_pixmap));
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      gdk_cairo_set_source_pixmap (cr, rbdata.frozen_pixmap, 0, 0);
+      cairo_paint (cr);
+      cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+      cairo_set_source_rgba (cr, 0, 0, 0, BACKGROUND_TRANSPARENCY);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+
+      /* The loupe is magnified from the frozen screen in memory */
+      rbdata.loupe = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                                 LOUPE_SIZE, LOUPE_SIZE);
+    }
+
+  /* List the windows before the selection window is shown, on the frozen
+   * screen they do not move anymore */
+  rbdata.windows = screenshooter_window_index_new (!freeze);
+
+  xhair_cursor = gdk_cursor_new (GDK_CROSSHAIR);
 
   /* Create the fullscreen window on which the rubber banding
    * will be drawn. */
@@ -711,8 +1281,12 @@ static GdkPixbuf
                          GDK_EXPOSURE_MASK |
                          GDK_POINTER_MOTION_MASK |
                          GDK_KEY_PRESS_MASK);
-  gtk_widget_set_colormap (window,
-                           gdk_screen_get_rgba_colormap (gdk_screen_get_default ()));
+
+  /* The frozen screen covers the whole window, it does not need an
+   * alpha channel */
+  if (!freeze)
+    gtk_widget_set_colormap (window,
+                             gdk_screen_get_rgba_colormap (gdk_screen_get_default ()));
 
   /* Connect to the interesting signals */
   g_signal_connect (window, "key-press-event",
@@ -729,11 +1303,10 @@ static GdkPixbuf
   /* This window is not managed by the window manager, we have to set everything
    * ourselves */
   gtk_widget_realize (window);
+  rbdata.overlay = window->window;
   gdk_window_set_cursor (window->window, xhair_cursor);
   gdk_window_set_override_redirect (window->window, TRUE);
-  gtk_widget_set_size_request (window,
-                               gdk_screen_get_width (gdk_screen_get_default ()),
-                               gdk_screen_get_height (gdk_screen_get_default ()));
+  gtk_widget_set_size_request (window, width, height);
   gdk_window_raise (window->window);
   gtk_widget_show_now (window);
   gtk_widget_grab_focus (window);
@@ -746,37 +1319,104 @@ static GdkPixbuf
                     NULL, GDK_CURRENT_TIME);
 
   gtk_dialog_run (GTK_DIALOG (window));
+
+  if (rbdata.redraw_id != 0)
+    g_source_remove (rbdata.redraw_id);
+
   gtk_widget_destroy (window);
   gdk_cursor_unref (xhair_cursor);
+  screenshooter_window_index_free (rbdata.windows);
+
+  if (rbdata.edges != NULL)
+    screenshooter_edge_map_free (rbdata.edges);
+
+  /* Ungrab the mouse and the keyboard, the other applications can be used
+   * during the delay */
+  gdk_pointer_ungrab (GDK_CURRENT_TIME);
+  gdk_keyboard_ungrab (GDK_CURRENT_TIME);
   gdk_flush();
 
-  if (cancelled)
-    return NULL;
+  if (freeze)
+    {
+      GdkRectangle screen = { 0, 0, width, height };
 
-  screenshot = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
-                               TRUE,
-                               8,
-                               rbdata.rectangle.width,
-                               rbdata.rectangle.height);
+      g_object_unref (rbdata.frozen_pixmap);
+      g_object_unref (rbdata.dimmed_pixmap);
+      cairo_surface_destroy (rbdata.loupe);
 
-  /* Grab the screenshot on the main window */
-  root = gdk_get_default_root_window ();
+      /* Cut the region out of the frozen screen, without reading the
+       * screen again */
+      if (!cancelled &&
+          gdk_rectangle_intersect (&rbdata.rectangle_root, &screen, area))
+        {
+          GdkPixbuf *region =
+            gdk_pixbuf_new_subpixbuf (rbdata.frozen, area->x, area->y,
+                                      area->width, area->height);
 
-  sleep(delay);
+          *screenshot = gdk_pixbuf_copy (region);
+          g_object_unref (region);
+        }
+      else
+        cancelled = TRUE;
 
-  gdk_pixbuf_get_from_drawable (screenshot, root, NULL,
-                                rbdata.rectangle_root.x,
-                                rbdata.rectangle_root.y,
-                                0, 0,
-                                rbdata.rectangle.width,
-                                rbdata.rectangle.height);
+      g_object_unref (rbdata.frozen);
 
-  /* Ungrab the mouse and the keyboard */
-  gdk_pointer_ungrab (GDK_CURRENT_TIME);
-  gdk_keyboard_ungrab (GDK_CURRENT_TIME);
-  gdk_flush ();
+      return !cancelled;
+    }
 
-  return screenshot;
+  *area = rbdata.rectangle_root;
+
+  return !cancelled;
+}
+
+
+
+/* Removes the XOR rectangle drawn on the root window, if any */
+static void
+erase_rectangle (RbData *rbdata)
+{
+  if (rbdata->rectangle.width > 0 && rbdata->rectangle.height > 0)
+    {
+      TRACE ("Remove the rectangle drawn previously");
+
+      gdk_draw_rectangle (rbdata->root_window,
+                          rbdata->gc,
+                          FALSE,
+                          rbdata->rectangle.x,
+                          rbdata->rectangle.y,
+                          rbdata->rectangle.width,
+                          rbdata->rectangle.height);
+    }
+}
+
+
+
+/* Draws the XOR rectangle again for the last pointer position */
+static gboolean
+cb_redraw_rectangle (RbData *rbdata)
+{
+  rbdata->redraw_id = 0;
+
+  erase_rectangle (rbdata);
+
+  rbdata->rectangle.x = MIN (rbdata->x1, rbdata->x2);
+  rbdata->rectangle.y = MIN (rbdata->y1, rbdata->y2);
+  rbdata->rectangle.width = ABS (rbdata->x2 - rbdata->x1);
+  rbdata->rectangle.height = ABS (rbdata->y2 - rbdata->y1);
+
+  /* Draw the rectangle as the user drags the mouse */
+  TRACE ("Draw the new rectangle");
+  if (rbdata->rectangle.width > 0 &&
+      rbdata->rectangle.height > 0)
+    gdk_draw_rectangle (rbdata->root_window,
+                        rbdata->gc,
+                        FALSE,
+                        rbdata->rectangle.x,
+                        rbdata->rectangle.y,
+                        rbdata->rectangle.width,
+                        rbdata->rectangle.height);
+
+  return FALSE;
 }
 
 
@@ -785,7 +1425,6 @@ static GdkFilterReturn
 region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
 {
   XEvent *x_event = (XEvent *) xevent;
-  gint x2 = 0, y2 = 0;
 
   switch (x_event->type)
     {
@@ -806,21 +1445,17 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
       case ButtonRelease:
         if (rbdata->pressed)
           {
+            /* Apply the motion which was not redrawn yet */
+            if (rbdata->redraw_id != 0)
+              {
+                g_source_remove (rbdata->redraw_id);
+                cb_redraw_rectangle (rbdata);
+              }
+
             if (rbdata->rectangle.width > 0 &&
                 rbdata->rectangle.height > 0)
               {
-                /* Remove the rectangle drawn previously */
-
-                TRACE ("Remove the rectangle drawn previously");
-
-                gdk_draw_rectangle (rbdata->root_window,
-                                    rbdata->gc,
-                                    FALSE,
-                                    rbdata->rectangle.x,
-                                    rbdata->rectangle.y,
-                                    rbdata->rectangle.width,
-                                    rbdata->rectangle.height);
-
+                erase_rectangle (rbdata);
                 gtk_main_quit ();
               }
             else
@@ -835,46 +1470,18 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
         return GDK_FILTER_REMOVE;
       break;
 
-      /* The user is moving the mouse */
+      /* The user is moving the mouse, only remember where it is, the
+       * motions are coalesced until the next redraw */
       case MotionNotify:
         if (rbdata->pressed)
           {
-            TRACE ("Mouse is moving");
-
-            if (rbdata->rectangle.width > 0 &&
-                rbdata->rectangle.height > 0)
-              {
-                /* Remove the rectangle drawn previously */
-
-                TRACE ("Remove the rectangle drawn previously");
-                gdk_draw_rectangle (rbdata->root_window,
-                                    rbdata->gc,
-                                    FALSE,
-                                    rbdata->rectangle.x,
-                                    rbdata->rectangle.y,
-                                    rbdata->rectangle.width,
-                                    rbdata->rectangle.height);
-              }
+            rbdata->x2 = x_event->xmotion.x_root;
+            rbdata->y2 = x_event->xmotion.y_root;
 
-            x2 = x_event->xkey.x_root;
-            y2 = x_event->xkey.y_root;
-
-            rbdata->rectangle.x = MIN (rbdata->x1, x2);
-            rbdata->rectangle.y = MIN (rbdata->y1, y2);
-            rbdata->rectangle.width = ABS (x2 - rbdata->x1);
-            rbdata->rectangle.height = ABS (y2 - rbdata->y1);
-
-            /* Draw  the rectangle as the user drags the mouse */
-            TRACE ("Draw the new rectangle");
-            if (rbdata->rectangle.width > 0 &&
-                rbdata->rectangle.height > 0)
-              gdk_draw_rectangle (rbdata->root_window,
-                                  rbdata->gc,
-                                  FALSE,
-                                  rbdata->rectangle.x,
-                                  rbdata->rectangle.y,
-                                  rbdata->rectangle.width,
-                                  rbdata->rectangle.height);
+            if (rbdata->redraw_id == 0)
+              rbdata->redraw_id =
+                g_timeout_add (REDRAW_INTERVAL,
+                               (GSourceFunc) cb_redraw_rectangle, rbdata);
           }
         return GDK_FILTER_REMOVE;
         break;
@@ -885,23 +1492,7 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
             TRACE ("Escape key was pressed, cancel the screenshot.");
 
             if (rbdata->pressed)
-              {
-                if (rbdata->rectangle.width > 0 &&
-                    rbdata->rectangle.height > 0)
-                  {
-                    /* Remove the rectangle drawn previously */
-
-                    TRACE ("Remove the rectangle drawn previously");
-
-                    gdk_draw_rectangle (rbdata->root_window,
-                                        rbdata->gc,
-                                        FALSE,
-                                        rbdata->rectangle.x,
-                                        rbdata->rectangle.y,
-                                        rbdata->rectangle.width,
-                                        rbdata->rectangle.height);
-                  }
-              }
+              erase_rectangle (rbdata);
 
             rbdata->cancelled = TRUE;
             gtk_main_quit ();
@@ -918,10 +1509,11 @@ region_filter_func (GdkXEvent *xevent, GdkEvent *event, RbData *rbdata)
 
 
 
-static GdkPixbuf
-*get_rectangle_screenshot (gint delay)
+/* Lets the user select a region with a rectangle drawn on the screen.
+ * Returns FALSE if the selection was cancelled. */
+static gboolean
+select_region (GdkRectangle *area)
 {
-  GdkPixbuf *screenshot = NULL;
   GdkWindow *root_window;
 
   GdkGCValues gc_values;
@@ -980,6 +1572,7 @@ static GdkPixbuf
   rbdata.gc = gc;
   rbdata.pressed = FALSE;
   rbdata.cancelled = FALSE;
+  rbdata.redraw_id = 0;
 
   /* Set the filter function to handle the GDK events */
   TRACE ("Add the events filter");
@@ -990,6 +1583,9 @@ static GdkPixbuf
 
   gtk_main ();
 
+  if (rbdata.redraw_id != 0)
+    g_source_remove (rbdata.redraw_id);
+
   gdk_window_remove_filter (root_window,
                             (GdkFilterFunc) region_filter_func,
                             &rbdata);
@@ -997,28 +1593,14 @@ static GdkPixbuf
   gdk_pointer_ungrab(GDK_CURRENT_TIME);
   gdk_keyboard_ungrab (GDK_CURRENT_TIME);
 
-  /* Get the screenshot's pixbuf */
-  if (G_LIKELY (!rbdata.cancelled))
-    {
-      TRACE ("Get the pixbuf for the screenshot");
-
-      sleep(delay);
-
-      screenshot =
-        gdk_pixbuf_get_from_drawable (NULL, root_window, NULL,
-                                      rbdata.rectangle.x,
-                                      rbdata.rectangle.y,
-                                      0, 0,
-                                      rbdata.rectangle.width,
-                                      rbdata.rectangle.height);
-    }
-
   if (G_LIKELY (gc != NULL))
     g_object_unref (gc);
 
   gdk_cursor_unref (xhair_cursor);
 
-  return screenshot;
+  *area = rbdata.rectangle;
+
+  return !rbdata.cancelled;
 }
 
 
@@ -1031,84 +1613,146 @@ static GdkPixbuf
  * screenshooter_take_screenshot:
  * @region: the region to be screenshoted. It can be FULLSCREEN,
  *          ACTIVE_WINDOW or SELECT.
- * @delay: the delay before the screenshot is taken, in seconds.
+ * @delay: the delay before the screenshot is taken, in milliseconds.
  * @mouse: whether the mouse pointer should be displayed on the screenshot.
+ * @own_ui: whether a window of this process was hidden right before.
+ * @freeze: whether the region is selected on a still image of the screen.
+ * @cancellable: a #GCancellable to stop the delay, or %NULL.
+ * @func: function called with the screenshot.
+ * @user_data: data passed to @func.
  *
  * Takes a screenshot with the given options. If @region is FULLSCREEN,
- * the screenshot is taken after @delay seconds. If @region is
- * ACTIVE_WINDOW, a delay of @delay seconds elapses, then the active
+ * the screenshot is taken after @delay milliseconds. If @region is
+ * ACTIVE_WINDOW, a delay of @delay milliseconds elapses, then the active
  * window is detected and captured. If @region is SELECT, the user will
  * have to select a portion of the screen with the mouse. Then a delay of
- * @delay seconds elapses, and a screenshot is taken.
+ * @delay milliseconds elapses, and a screenshot is taken.
+ *
+ * The delay is a source of the main loop, which keeps running meanwhile,
+ * and the capture continues from its callback. If @own_ui is %TRUE, or
+ * if @region is SELECT on a composited screen, the capture also waits for
+ * the screen to be repainted without our windows, and this wait counts in
+ * the delay.
+ *
+ * If @freeze is %TRUE and @region is SELECT, the delay elapses first,
+ * then the screen is read and the region is selected on this image and
+ * cut out of it.
  *
  * @show_mouse is only taken into account when @region is FULLSCREEN
  * or ACTIVE_WINDOW.
  *
- * Return value: a #GdkPixbuf containing the screenshot or %NULL
- * (if @region is SELECT, the user can cancel the operation).
+ * @func is called with a #GdkPixbuf containing the screenshot, which it
+ * owns, or %NULL (if @region is SELECT, the user can cancel the
+ * operation, and the delay can be cancelled with @cancellable). Without
+ * delay, it may be called before this function returns.
  **/
-GdkPixbuf *screenshooter_take_screenshot (gint     region,
-                                          gint     delay,
-                                          gboolean show_mouse,
-                                          gboolean plugin)
+void
+screenshooter_take_screenshot (gint                      region,
+                               gint                      delay,
+                               gboolean                  show_mouse,
+                               gboolean                  plugin,
+                               gboolean                  own_ui,
+                               gboolean                  freeze,
+                               GCancellable             *cancellable,
+                               ScreenshooterCaptureFunc  func,
+                               gpointer                  user_data)
 {
-  GdkPixbuf *screenshot = NULL;
-  GdkWindow *window = NULL;
-  GdkScreen *screen;
-  GdkDisplay *display;
-  gboolean border;
+  CaptureJob *job;
 
-  /* gdk_get_default_root_window () does not need to be unrefed,
-   * needs_unref enables us to unref *window only if a non default
-   * window has been grabbed. */
-  gboolean needs_unref = TRUE;
+  g_return_if_fail (func != NULL);
 
-  /* Get the screen on which the screenshot should be taken */
-  screen = gdk_screen_get_default ();
+  job = g_new0 (CaptureJob, 1);
+  job->region = region;
+  job->delay = delay;
+  job->show_mouse = show_mouse;
+  job->cancellable = cancellable != NULL ? g_object_ref (cancellable) : NULL;
+  job->func = func;
+  job->user_data = user_data;
 
   /* Sync the display */
-  display = gdk_display_get_default ();
-  gdk_display_sync (display);
+  gdk_display_sync (gdk_display_get_default ());
 
   gdk_window_process_all_updates ();
 
-  /* wait for n=delay seconds */
   if (region != SELECT)
-    sleep (delay);
-
-  /* Get the window/desktop we want to screenshot*/
-  if (region == FULLSCREEN)
     {
-      TRACE ("We grab the entire screen");
+      wait_before_capture (job, own_ui, NULL, capture_window);
+      return;
+    }
 
-      window = gdk_get_default_root_window ();
-      needs_unref = FALSE;
-      border = FALSE;
+  TRACE ("Let the user select the region to screenshot");
+
+  /* The delay elapses before the screen is frozen, so that menus and
+   * tooltips can be opened meanwhile. The window showing the frozen
+   * screen does not need a compositor. */
+  if (freeze)
+    wait_before_capture (job, own_ui, NULL, capture_frozen);
+  else if (!gdk_screen_is_composited (gdk_screen_get_default ()))
+    {
+      if (select_region (&job->area))
+        wait_before_capture (job, own_ui, &job->area, capture_area);
+      else
+        capture_finish (job, NULL);
     }
-  else if (region == ACTIVE_WINDOW)
+  else
     {
-      TRACE ("We grab the active window");
+      job->alpha = TRUE;
 
-      window = get_active_window (screen, &needs_unref, &border);
+      /* The selection window may still be fading out */
+      if (select_region_composited (FALSE, &job->area, NULL))
+        wait_before_capture (job, TRUE, &job->area, capture_area);
+      else
+        capture_finish (job, NULL);
     }
+}
 
-  if (region == FULLSCREEN || region == ACTIVE_WINDOW)
-    {
-      TRACE ("Get the screenshot of the given window");
 
-      screenshot = get_window_screenshot (window, show_mouse, border);
 
-      if (needs_unref)
-        g_object_unref (window);
-    }
-  else if (region == SELECT)
+/**
+ * screenshooter_wait_for_stable_screen:
+ * @region: FULLSCREEN or ACTIVE_WINDOW.
+ * @quiet: the time nothing must be drawn, in milliseconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @func: function called at the end of the wait.
+ * @user_data: data passed to @func.
+ *
+ * Waits until nothing was drawn on the screen, or on the active window
+ * if @region is ACTIVE_WINDOW, for @quiet milliseconds. The wait gives up
+ * after ten seconds. The main loop keeps running meanwhile, then @func is
+ * called with whether the screen became stable, the wait timed out or it
+ * was cancelled, see screenshooter_settle_start().
+ **/
+void
+screenshooter_wait_for_stable_screen (gint                     region,
+                                      gint                     quiet,
+                                      GCancellable            *cancellable,
+                                      ScreenshooterSettleFunc  func,
+                                      gpointer                 user_data)
+{
+  GdkRectangle area;
+  GdkWindow *window;
+  gboolean needs_unref = TRUE, border;
+
+  g_return_if_fail (region == FULLSCREEN || region == ACTIVE_WINDOW);
+  g_return_if_fail (quiet > 0);
+
+  if (region == FULLSCREEN)
     {
-      TRACE ("Let the user select the region to screenshot");
-      if (!gdk_screen_is_composited (screen))
-        screenshot = get_rectangle_screenshot (delay);
-      else
-        screenshot = get_rectangle_screenshot_composited (delay);
+      screenshooter_settle_start (NULL, quiet, MAX (quiet, STABLE_TIMEOUT),
+                                  cancellable, func, user_data);
+      return;
     }
 
-  return screenshot;
+  /* Only watch the frame of the active window */
+  window = get_active_window (gdk_screen_get_default (), &needs_unref, &border);
+  gdk_window_get_frame_extents (window, &area);
+
+  if (needs_unref)
+    g_object_unref (window);
+
+  TRACE ("Watch the damage on %dx%d+%d+%d",
+         area.width, area.height, area.x, area.y);
+
+  screenshooter_settle_start (&area, quiet, MAX (quiet, STABLE_TIMEOUT),
+                              cancellable, func, user_data);
 }
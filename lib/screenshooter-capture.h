@@ -25,6 +25,7 @@
 #endif
 
 #include "screenshooter-global.h"
+#include "screenshooter-settle.h"
 
 #ifdef HAVE_XFIXES
 #include <X11/extensions/Xfixes.h>
@@ -33,16 +34,31 @@
 #include <gdk/gdkkeysyms.h>
 #include <gdk/gdkx.h>
 #include <glib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <libxfce4util/libxfce4util.h>
 
 
 
-GdkPixbuf
-*screenshooter_take_screenshot   (gint     region,
-                                  gint     delay,
-                                  gboolean show_mouse,
-                                  gboolean plugin);
+/* Called with the screenshot, which it owns, or NULL */
+typedef void (*ScreenshooterCaptureFunc) (GdkPixbuf *screenshot,
+                                          gpointer   user_data);
+
+void screenshooter_take_screenshot        (gint                      region,
+                                           gint                      delay,
+                                           gboolean                  show_mouse,
+                                           gboolean                  plugin,
+                                           gboolean                  own_ui,
+                                           gboolean                  freeze,
+                                           GCancellable             *cancellable,
+                                           ScreenshooterCaptureFunc  func,
+                                           gpointer                  user_data);
+
+void screenshooter_wait_for_stable_screen (gint                      region,
+                                           gint                      quiet,
+                                           GCancellable             *cancellable,
+                                           ScreenshooterSettleFunc   func,
+                                           gpointer                  user_data);
 
 #endif
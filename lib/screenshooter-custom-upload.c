@@ -0,0 +1,151 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Upload service defined by the user in the rc file.
+
+   The following keys describe it:
+
+   custom_upload_name      name shown in the actions dialog
+   custom_upload_url       URL the image is sent to, required
+   custom_upload_method    POST (default) or PUT
+   custom_upload_body      "multipart" (default) to send a form, or "raw"
+                           to send the PNG file as the body
+   custom_upload_field     name of the form field holding the image,
+                           "file" by default
+   custom_upload_title     name of the form field holding the title, the
+                           title is not sent if it is empty
+   custom_upload_headers   extra headers, as "Name: value" separated by ';'
+   custom_upload_response  how to find the link in the response:
+                           "xpath:<expression>" for XML answers,
+                           "regex:<pattern>" to use the first group (or
+                           the whole match) of a pattern, "header:<name>"
+                           to use a response header such as Location. By
+                           default the whole body is the link.
+   custom_upload_max_bytes   largest file accepted by the service
+   custom_upload_max_pixels  largest image accepted by the service
+   custom_upload_formats     accepted formats by order of preference,
+                             "png" by default, or "png,jpeg"
+
+   Images which do not fit the limits are downscaled and converted first.
+
+   The image is streamed from the disk and sent over the shared session,
+   so the uploads reuse the connections to the server.
+*/
+
+#include "screenshooter-custom-upload.h"
+
+
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_custom_upload_new_from_rc:
+ * @rc: the rc file of the application or of the panel plugin.
+ *
+ * Reads the description of the custom upload service from @rc.
+ *
+ * Return value: a new #ScreenshooterCustomUpload, or %NULL if no service is
+ * defined in @rc.
+ **/
+ScreenshooterCustomUpload
+*screenshooter_custom_upload_new_from_rc (XfceRc *rc)
+{
+  ScreenshooterCustomUpload *custom;
+  const gchar *url, *title_field;
+
+  g_return_val_if_fail (rc != NULL, NULL);
+
+  url = xfce_rc_read_entry (rc, "custom_upload_url", NULL);
+
+  if (url == NULL || *url == '\0')
+    return NULL;
+
+  custom = g_new0 (ScreenshooterCustomUpload, 1);
+  custom->url = g_strdup (url);
+  custom->name =
+    g_strdup (xfce_rc_read_entry (rc, "custom_upload_name", _("Custom")));
+  custom->method =
+    g_ascii_strup (xfce_rc_read_entry (rc, "custom_upload_method", "POST"), -1);
+  custom->multipart =
+    g_ascii_strcasecmp (xfce_rc_read_entry (rc, "custom_upload_body",
+                                            "multipart"), "raw") != 0;
+  custom->field =
+    g_strdup (xfce_rc_read_entry (rc, "custom_upload_field", "file"));
+  custom->headers = xfce_rc_read_list_entry (rc, "custom_upload_headers", ";");
+  custom->response =
+    g_strdup (xfce_rc_read_entry (rc, "custom_upload_response", NULL));
+
+  title_field = xfce_rc_read_entry (rc, "custom_upload_title", NULL);
+
+  if (title_field != NULL && *title_field != '\0')
+    custom->title_field = g_strdup (title_field);
+
+  custom->formats =
+    g_strdup (xfce_rc_read_entry (rc, "custom_upload_formats", "png"));
+  custom->limits.formats = custom->formats;
+  custom->limits.max_bytes = xfce_rc_read_int_entry (rc, "custom_upload_max_bytes", 0);
+  custom->limits.max_pixels = xfce_rc_read_int_entry (rc, "custom_upload_max_pixels", 0);
+
+  return custom;
+}
+
+
+
+/**
+ * screenshooter_custom_upload_free:
+ * @custom: a #ScreenshooterCustomUpload, or %NULL.
+ *
+ * Frees @custom.
+ **/
+void
+screenshooter_custom_upload_free (ScreenshooterCustomUpload *custom)
+{
+  if (custom == NULL)
+    return;
+
+  g_free (custom->name);
+  g_free (custom->url);
+  g_free (custom->method);
+  g_free (custom->field);
+  g_free (custom->title_field);
+  g_strfreev (custom->headers);
+  g_free (custom->response);
+  g_free (custom->formats);
+  g_free (custom);
+}
+
+
+
+/**
+ * screenshooter_custom_upload_get_name:
+ * @custom: a #ScreenshooterCustomUpload.
+ *
+ * Return value: the name of the service, to be shown to the user.
+ **/
+const gchar
+*screenshooter_custom_upload_get_name (ScreenshooterCustomUpload *custom)
+{
+  g_return_val_if_fail (custom != NULL, NULL);
+
+  return custom->name;
+}
@@ -0,0 +1,601 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Resident process taking the screenshots requested over D-Bus.
+
+   Starting xfce4-screenshooter initializes GTK, reads the translations
+   and the rc file and connects to the X server before the first pixel is
+   read. Started with --daemon, it keeps all this ready, along with the
+   upload session, and owns org.xfce.Screenshooter on the session bus.
+   Later invocations send their options to the Capture method and exit
+   with its result. The daemon is never started by the bus: it would not
+   run in the environment of the session, so the user starts it, from
+   the autostarted applications for example. Without it, the instances
+   take the screenshots themselves.
+
+   The Capture method takes an a{sv} with the following optional keys:
+
+   region          u  FULLSCREEN, ACTIVE_WINDOW or SELECT, FULLSCREEN
+                      by default
+   delay           i  delay before the capture, in milliseconds
+   show-mouse      b  whether the pointer is captured
+   freeze          b  whether the region is selected on a still image of
+                      the screen, the freeze_selection preference by
+                      default
+   action          i  what to do with the screenshot, the actions dialog
+                      is shown when it is not given
+   app             s  application to open the screenshot with
+   screenshot-dir  s  URI of the directory the screenshot is saved to
+   display         s  name of the display of the client
+
+   The method returns once the screenshot was taken and its action ran,
+   with whether a screenshot was taken. It fails if a capture is already
+   running or if the daemon is connected to another display, the client
+   then takes the screenshot itself. The Cancel method stops the delay of
+   the running capture.
+
+   The daemon also grabs the shortcuts of screenshooter-hotkeys.c. The
+   key press schedules the capture at a high priority, so that the screen
+   is read as soon as the event filter returns. With --timings, the time
+   from the key press to the screenshot is printed on stderr.
+*/
+
+#include "screenshooter-daemon.h"
+#include "screenshooter-actions.h"
+#include "screenshooter-hotkeys.h"
+
+#include <libxfce4util/libxfce4util.h>
+
+
+
+typedef struct
+{
+  ScreenshotData *sd;
+  gchar          *rc_file;
+  guint           owner_id;
+  gboolean        acquired;
+  gboolean        busy;
+
+  /* The Capture call answered when the actions are done, may be NULL */
+  GDBusMethodInvocation *invocation;
+
+  /* Monotonic time of the key press of the capture, 0 if none */
+  gint64          pressed;
+
+  /* Monotonic time the capture was started at */
+  gint64          started;
+}
+ScreenshooterDaemon;
+
+
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='" SCREENSHOOTER_DBUS_INTERFACE "'>"
+  "    <method name='Capture'>"
+  "      <arg type='a{sv}' name='options' direction='in'/>"
+  "      <arg type='b' name='taken' direction='out'/>"
+  "    </method>"
+  "    <method name='Cancel'/>"
+  "    <method name='Quit'/>"
+  "  </interface>"
+  "</node>";
+
+static ScreenshooterDaemon *daemon_data = NULL;
+static gboolean             print_timings = FALSE;
+
+
+
+static void     daemon_apply_options (ScreenshooterDaemon   *daemon,
+                                      GVariant              *options);
+static gboolean daemon_capture_idle  (ScreenshooterDaemon   *daemon);
+static gboolean daemon_action_idle   (ScreenshooterDaemon   *daemon);
+static void     cb_captured          (GdkPixbuf             *screenshot,
+                                      ScreenshooterDaemon   *daemon);
+static void     cb_hotkey            (gint                   region,
+                                      ScreenshooterDaemon   *daemon);
+static void     cb_method_call       (GDBusConnection       *connection,
+                                      const gchar           *sender,
+                                      const gchar           *object_path,
+                                      const gchar           *interface_name,
+                                      const gchar           *method_name,
+                                      GVariant              *parameters,
+                                      GDBusMethodInvocation *invocation,
+                                      ScreenshooterDaemon   *daemon);
+static void     cb_bus_acquired      (GDBusConnection       *connection,
+                                      const gchar           *name,
+                                      ScreenshooterDaemon   *daemon);
+static void     cb_name_acquired     (GDBusConnection       *connection,
+                                      const gchar           *name,
+                                      ScreenshooterDaemon   *daemon);
+static void     cb_name_lost         (GDBusConnection       *connection,
+                                      const gchar           *name,
+                                      ScreenshooterDaemon   *daemon);
+
+
+
+static const GDBusInterfaceVTable interface_vtable =
+{
+  (GDBusInterfaceMethodCallFunc) cb_method_call,
+  NULL,
+  NULL
+};
+
+
+
+/* Internals */
+
+
+
+/* Sets the capture up from the preferences and @options, like the
+ * command line options of a new instance would */
+static void
+daemon_apply_options (ScreenshooterDaemon *daemon, GVariant *options)
+{
+  ScreenshotData *sd = daemon->sd;
+  const gchar *app = NULL, *screenshot_dir = NULL;
+  gboolean show_mouse;
+  guint region;
+  gint action;
+
+  /* The preferences may have changed since the last capture */
+  g_free (sd->screenshot_dir);
+  g_free (sd->title);
+  g_free (sd->app);
+  g_free (sd->last_user);
+  screenshooter_read_rc_file (daemon->rc_file, sd);
+
+  if (!g_variant_lookup (options, "region", "u", &region))
+    region = FULLSCREEN;
+
+  sd->region = region;
+
+  if (!g_variant_lookup (options, "delay", "i", &sd->delay))
+    sd->delay = 0;
+
+  if (g_variant_lookup (options, "show-mouse", "b", &show_mouse))
+    sd->show_mouse = show_mouse ? 1 : 0;
+
+  g_variant_lookup (options, "freeze", "b", &sd->freeze_selection);
+
+  /* Without an action, the actions dialog is shown with Save selected */
+  sd->action_specified = g_variant_lookup (options, "action", "i", &action);
+  sd->action = sd->action_specified ? action : SAVE;
+
+  /* The backend of the action may not be set up anymore */
+  if ((sd->action == UPLOAD_CUSTOM && sd->custom_upload == NULL) ||
+      (sd->action == UPLOAD_S3 && sd->s3 == NULL))
+    {
+      sd->action = SAVE;
+      sd->action_specified = FALSE;
+    }
+
+  if (!g_variant_lookup (options, "app", "&s", &app))
+    app = "none";
+
+  g_free (sd->app);
+  sd->app = g_strdup (app);
+
+  if (g_variant_lookup (options, "screenshot-dir", "&s", &screenshot_dir))
+    {
+      GFile *dir = g_file_new_for_uri (screenshot_dir);
+
+      if (g_file_query_exists (dir, NULL))
+        {
+          g_free (sd->screenshot_dir);
+          sd->screenshot_dir = g_strdup (screenshot_dir);
+          sd->action_specified = TRUE;
+        }
+
+      g_object_unref (dir);
+    }
+}
+
+
+
+static gboolean
+daemon_capture_idle (ScreenshooterDaemon *daemon)
+{
+  ScreenshotData *sd = daemon->sd;
+
+  daemon->started = g_get_monotonic_time ();
+
+  /* Connect to the upload host during the delay, after the screenshot of
+   * a shortcut */
+  if (daemon->pressed == 0)
+    screenshooter_action_warm_up (sd);
+
+  /* The main loop runs during the delay, Cancel and Quit can stop it */
+  sd->cancellable = g_cancellable_new ();
+  screenshooter_take_screenshot (sd->region,
+                                 sd->delay,
+                                 sd->show_mouse,
+                                 sd->plugin, FALSE,
+                                 sd->freeze_selection,
+                                 sd->cancellable,
+                                 (ScreenshooterCaptureFunc) cb_captured,
+                                 daemon);
+
+  return FALSE;
+}
+
+
+
+static void
+cb_captured (GdkPixbuf *screenshot, ScreenshooterDaemon *daemon)
+{
+  ScreenshotData *sd = daemon->sd;
+
+  sd->screenshot = screenshot;
+  g_object_unref (sd->cancellable);
+  sd->cancellable = NULL;
+
+  if (daemon->pressed == 0)
+    {
+      daemon_action_idle (daemon);
+      return;
+    }
+
+  /* The selection of a region waits for the user */
+  if (sd->region != SELECT)
+    {
+      gint64 read = g_get_monotonic_time ();
+      gchar queued[G_ASCII_DTOSTR_BUF_SIZE], total[G_ASCII_DTOSTR_BUF_SIZE];
+
+      g_ascii_formatd (queued, sizeof (queued), "%.4f",
+                       (daemon->started - daemon->pressed) / (gdouble) G_USEC_PER_SEC);
+      g_ascii_formatd (total, sizeof (total), "%.4f",
+                       (read - daemon->pressed) / (gdouble) G_USEC_PER_SEC);
+
+      TRACE ("Screen read %s s after the key press", total);
+
+      if (print_timings)
+        g_printerr ("hotkey\tregion=%d\tqueued=%s\ttotal=%s\n",
+                    sd->region, queued, total);
+    }
+
+  daemon->pressed = 0;
+  screenshooter_action_warm_up (sd);
+
+  daemon_action_idle (daemon);
+}
+
+
+
+static gboolean
+daemon_action_idle (ScreenshooterDaemon *daemon)
+{
+  ScreenshotData *sd = daemon->sd;
+  gboolean taken = sd->screenshot != NULL;
+
+  /* Runs the actions dialog and the upload dialogs, if any */
+  if (taken)
+    screenshooter_action_idle (sd);
+
+  screenshooter_write_rc_file (daemon->rc_file, sd);
+  daemon->busy = FALSE;
+
+  /* The client exits with the result of the capture */
+  if (daemon->invocation != NULL)
+    {
+      g_dbus_method_invocation_return_value (daemon->invocation,
+                                             g_variant_new ("(b)", taken));
+      daemon->invocation = NULL;
+    }
+
+  return FALSE;
+}
+
+
+
+static void
+cb_hotkey (gint region, ScreenshooterDaemon *daemon)
+{
+  GVariantBuilder builder;
+  GVariant *options;
+
+  if (daemon->busy)
+    return;
+
+  daemon->pressed = g_get_monotonic_time ();
+
+  /* Like a shortcut running xfce4-screenshooter with a region option */
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&builder, "{sv}", "region", g_variant_new_uint32 (region));
+  options = g_variant_ref_sink (g_variant_builder_end (&builder));
+  daemon_apply_options (daemon, options);
+  g_variant_unref (options);
+
+  daemon->busy = TRUE;
+
+  /* Not from the event filter, which must return before the selection
+   * of a region or the dialogs can run. Before the redraws, the screen is
+   * read right after the filter returns. */
+  g_idle_add_full (G_PRIORITY_HIGH, (GSourceFunc) daemon_capture_idle,
+                   daemon, NULL);
+}
+
+
+
+static void
+cb_method_call (GDBusConnection       *connection,
+                const gchar           *sender,
+                const gchar           *object_path,
+                const gchar           *interface_name,
+                const gchar           *method_name,
+                GVariant              *parameters,
+                GDBusMethodInvocation *invocation,
+                ScreenshooterDaemon   *daemon)
+{
+  if (g_strcmp0 (method_name, "Capture") == 0)
+    {
+      GVariant *options;
+      const gchar *display = NULL;
+
+      if (daemon->busy)
+        {
+          g_dbus_method_invocation_return_dbus_error (invocation,
+                                                      SCREENSHOOTER_DBUS_INTERFACE ".Error.Busy",
+                                                      "A screenshot is already being taken");
+          return;
+        }
+
+      g_variant_get (parameters, "(@a{sv})", &options);
+
+      /* The client captures another screen than this process would */
+      if (g_variant_lookup (options, "display", "&s", &display) &&
+          g_strcmp0 (display, gdk_display_get_name (gdk_display_get_default ())) != 0)
+        {
+          g_variant_unref (options);
+          g_dbus_method_invocation_return_dbus_error (invocation,
+                                                      SCREENSHOOTER_DBUS_INTERFACE ".Error.OtherDisplay",
+                                                      "The daemon runs on another display");
+          return;
+        }
+
+      TRACE ("Capture requested by %s", sender);
+
+      daemon_apply_options (daemon, options);
+      g_variant_unref (options);
+
+      /* Answered by daemon_action_idle () */
+      daemon->busy = TRUE;
+      daemon->invocation = invocation;
+      g_idle_add ((GSourceFunc) daemon_capture_idle, daemon);
+    }
+  else if (g_strcmp0 (method_name, "Cancel") == 0)
+    {
+      if (daemon->sd->cancellable != NULL)
+        g_cancellable_cancel (daemon->sd->cancellable);
+
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+  else if (g_strcmp0 (method_name, "Quit") == 0)
+    {
+      if (daemon->sd->cancellable != NULL)
+        g_cancellable_cancel (daemon->sd->cancellable);
+
+      g_dbus_method_invocation_return_value (invocation, NULL);
+      gtk_main_quit ();
+    }
+}
+
+
+
+static void
+cb_bus_acquired (GDBusConnection     *connection,
+                 const gchar         *name,
+                 ScreenshooterDaemon *daemon)
+{
+  GDBusNodeInfo *info;
+  GError *error = NULL;
+  guint registration_id;
+
+  info = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+  registration_id =
+    g_dbus_connection_register_object (connection, SCREENSHOOTER_DBUS_PATH,
+                                       info->interfaces[0], &interface_vtable,
+                                       daemon, NULL, &error);
+  g_dbus_node_info_unref (info);
+
+  if (registration_id == 0)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+    }
+}
+
+
+
+static void
+cb_name_acquired (GDBusConnection     *connection,
+                  const gchar         *name,
+                  ScreenshooterDaemon *daemon)
+{
+  TRACE ("Waiting for captures as %s", name);
+
+  daemon->acquired = TRUE;
+
+  /* Only the running daemon grabs the shortcuts */
+  screenshooter_hotkeys_grab (daemon->rc_file,
+                              (ScreenshooterHotkeyFunc) cb_hotkey, daemon);
+}
+
+
+
+static void
+cb_name_lost (GDBusConnection     *connection,
+              const gchar         *name,
+              ScreenshooterDaemon *daemon)
+{
+  if (!daemon->acquired)
+    g_printerr (_("The screenshooter daemon could not be registered on the"
+                  " session bus, another one may be running.\n"));
+
+  gtk_main_quit ();
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_daemon_start:
+ * @sd: the #ScreenshotData used for all the captures.
+ * @rc_file: the path of the rc file.
+ *
+ * Owns the D-Bus name of the daemon and takes the requested screenshots
+ * from the GTK main loop, until the Quit method is called or the name is
+ * lost. The caller runs gtk_main(), then calls
+ * screenshooter_daemon_stop().
+ **/
+void
+screenshooter_daemon_start (ScreenshotData *sd, const gchar *rc_file)
+{
+  g_return_if_fail (sd != NULL);
+  g_return_if_fail (rc_file != NULL);
+  g_return_if_fail (daemon_data == NULL);
+
+  daemon_data = g_new0 (ScreenshooterDaemon, 1);
+  daemon_data->sd = sd;
+  daemon_data->rc_file = g_strdup (rc_file);
+
+  /* Like the panel plugin, the process outlives the captures */
+  sd->plugin = TRUE;
+
+  daemon_data->owner_id =
+    g_bus_own_name (G_BUS_TYPE_SESSION, SCREENSHOOTER_DBUS_NAME,
+                    G_BUS_NAME_OWNER_FLAGS_NONE,
+                    (GBusAcquiredCallback) cb_bus_acquired,
+                    (GBusNameAcquiredCallback) cb_name_acquired,
+                    (GBusNameLostCallback) cb_name_lost,
+                    daemon_data, NULL);
+}
+
+
+
+/**
+ * screenshooter_daemon_stop:
+ *
+ * Releases the D-Bus name of the daemon.
+ *
+ * Return value: %FALSE if the daemon could not own its name, because the
+ * session bus is not available or another daemon is running.
+ **/
+gboolean
+screenshooter_daemon_stop (void)
+{
+  gboolean acquired;
+
+  g_return_val_if_fail (daemon_data != NULL, FALSE);
+
+  acquired = daemon_data->acquired;
+
+  if (daemon_data->invocation != NULL)
+    g_dbus_method_invocation_return_dbus_error (daemon_data->invocation,
+                                                SCREENSHOOTER_DBUS_INTERFACE ".Error.Quit",
+                                                "The daemon was stopped");
+
+  screenshooter_hotkeys_ungrab ();
+  g_bus_unown_name (daemon_data->owner_id);
+
+  daemon_data->sd->plugin = FALSE;
+  g_free (daemon_data->rc_file);
+  g_free (daemon_data);
+  daemon_data = NULL;
+
+  return acquired;
+}
+
+
+
+/**
+ * screenshooter_daemon_set_print_timings:
+ * @print: whether the timings of the shortcut captures should be printed.
+ *
+ * Enables the output, on stderr, of the time between the key press of a
+ * shortcut and the screenshot of the entire screen or of the active
+ * window. Each capture prints a single line of tab separated name=value
+ * fields: region, queued, the time before the capture started, and
+ * total. Durations are in seconds.
+ **/
+void
+screenshooter_daemon_set_print_timings (gboolean print)
+{
+  print_timings = print;
+}
+
+
+
+/**
+ * screenshooter_daemon_capture:
+ * @options: a floating a{sv} #GVariant with the options of the capture,
+ * which is consumed.
+ * @taken: return location for whether a screenshot was taken.
+ * @error: return location for errors.
+ *
+ * Asks a running daemon to take a screenshot and waits until it is done.
+ * The daemon is not started if it is not running. Only GIO is used, so
+ * this can be called before gtk_init().
+ *
+ * Return value: %TRUE if the daemon took the request, %FALSE if the
+ * capture should be done in this process.
+ **/
+gboolean
+screenshooter_daemon_capture (GVariant  *options,
+                              gboolean  *taken,
+                              GError   **error)
+{
+  GDBusConnection *connection;
+  GVariant *result;
+
+  g_return_val_if_fail (options != NULL, FALSE);
+  g_return_val_if_fail (taken != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, error);
+
+  if (connection == NULL)
+    {
+      g_variant_unref (g_variant_ref_sink (options));
+
+      return FALSE;
+    }
+
+  result = g_dbus_connection_call_sync (connection,
+                                        SCREENSHOOTER_DBUS_NAME,
+                                        SCREENSHOOTER_DBUS_PATH,
+                                        SCREENSHOOTER_DBUS_INTERFACE,
+                                        "Capture",
+                                        g_variant_new ("(@a{sv})", options),
+                                        G_VARIANT_TYPE ("(b)"),
+                                        G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                        G_MAXINT, NULL, error);
+  g_object_unref (connection);
+
+  if (result == NULL)
+    return FALSE;
+
+  g_variant_get (result, "(b)", taken);
+  g_variant_unref (result);
+
+  return TRUE;
+}
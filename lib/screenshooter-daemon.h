@@ -0,0 +1,44 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_DAEMON_H__
+#define __HAVE_DAEMON_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "screenshooter-global.h"
+
+#define SCREENSHOOTER_DBUS_NAME      "org.xfce.Screenshooter"
+#define SCREENSHOOTER_DBUS_PATH      "/org/xfce/Screenshooter"
+#define SCREENSHOOTER_DBUS_INTERFACE "org.xfce.Screenshooter"
+
+void     screenshooter_daemon_start              (ScreenshotData  *sd,
+                                                  const gchar     *rc_file);
+gboolean screenshooter_daemon_stop               (void);
+void     screenshooter_daemon_set_print_timings  (gboolean         print);
+gboolean screenshooter_daemon_capture            (GVariant        *options,
+                                                  gboolean        *taken,
+                                                  GError         **error);
+
+#endif
@@ -0,0 +1,209 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+
+/* Delay before a capture.
+
+   The delay used to be a sleep () on the GTK main thread, which froze
+   the dialogs and the uploads still running and, for a region, kept the
+   pointer and the keyboard grabbed. The delay is now a timeout source:
+   the capture continues from its callback, so everything else keeps
+   being dispatched meanwhile, and no other capture can start from a main
+   loop nested in this one. The timeout has a millisecond resolution, and
+   the delay ends as soon as its GCancellable is cancelled.
+
+   The delays are given in milliseconds. On the command line, they are
+   written as "250ms", "2s" or "2", which means seconds.
+*/
+
+#include "screenshooter-delay.h"
+
+#include <stdlib.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Longest delay accepted on the command line, one hour */
+#define DELAY_MAX (60 * 60 * 1000)
+
+
+
+typedef struct
+{
+  guint                   timeout_id;
+  GSource                *cancel_source;
+  ScreenshooterDelayFunc  func;
+  gpointer                user_data;
+}
+DelayWait;
+
+
+
+static void     delay_finish       (DelayWait    *wait,
+                                    gboolean      elapsed);
+static gboolean cb_delay_elapsed   (DelayWait    *wait);
+static gboolean cb_delay_cancelled (GCancellable *cancellable,
+                                    DelayWait    *wait);
+
+
+
+/* Internals */
+
+
+
+static void
+delay_finish (DelayWait *wait, gboolean elapsed)
+{
+  if (wait->timeout_id != 0)
+    g_source_remove (wait->timeout_id);
+
+  if (wait->cancel_source != NULL)
+    {
+      g_source_destroy (wait->cancel_source);
+      g_source_unref (wait->cancel_source);
+    }
+
+  wait->func (elapsed, wait->user_data);
+  g_free (wait);
+}
+
+
+
+static gboolean
+cb_delay_elapsed (DelayWait *wait)
+{
+  wait->timeout_id = 0;
+  delay_finish (wait, TRUE);
+
+  return FALSE;
+}
+
+
+
+/* Dispatched from the main loop, even if @cancellable was cancelled from
+ * another thread */
+static gboolean
+cb_delay_cancelled (GCancellable *cancellable, DelayWait *wait)
+{
+  TRACE ("The delay was cancelled");
+
+  delay_finish (wait, FALSE);
+
+  return FALSE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_delay_start:
+ * @delay: the delay, in milliseconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @func: function called at the end of the delay.
+ * @user_data: data passed to @func.
+ *
+ * Calls @func from the default main context once @delay milliseconds
+ * elapsed, with %TRUE, or as soon as @cancellable is cancelled, with
+ * %FALSE. The main loop keeps dispatching the other sources meanwhile.
+ * The caller should release its grabs before.
+ *
+ * Without delay, or if @cancellable is already cancelled, @func is called
+ * before this function returns.
+ **/
+void
+screenshooter_delay_start (gint                    delay,
+                           GCancellable           *cancellable,
+                           ScreenshooterDelayFunc  func,
+                           gpointer                user_data)
+{
+  DelayWait *wait;
+
+  g_return_if_fail (func != NULL);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    {
+      func (FALSE, user_data);
+      return;
+    }
+
+  if (delay <= 0)
+    {
+      func (TRUE, user_data);
+      return;
+    }
+
+  TRACE ("Wait %d ms", delay);
+
+  wait = g_new0 (DelayWait, 1);
+  wait->func = func;
+  wait->user_data = user_data;
+  wait->timeout_id = g_timeout_add_full (G_PRIORITY_HIGH, delay,
+                                         (GSourceFunc) cb_delay_elapsed,
+                                         wait, NULL);
+
+  if (cancellable != NULL)
+    {
+      wait->cancel_source = g_cancellable_source_new (cancellable);
+      g_source_set_callback (wait->cancel_source,
+                             (GSourceFunc) cb_delay_cancelled, wait, NULL);
+      g_source_attach (wait->cancel_source, NULL);
+    }
+}
+
+
+
+/**
+ * screenshooter_delay_parse:
+ * @text: the delay, like "250ms", "2s" or "2".
+ * @delay: return location for the delay, in milliseconds.
+ *
+ * Parses a delay given on the command line. A number without a unit is a
+ * number of seconds.
+ *
+ * Return value: %FALSE if @text is not a valid delay.
+ **/
+gboolean
+screenshooter_delay_parse (const gchar *text, gint *delay)
+{
+  gchar *end;
+  gdouble value;
+
+  g_return_val_if_fail (text != NULL, FALSE);
+  g_return_val_if_fail (delay != NULL, FALSE);
+
+  value = g_ascii_strtod (text, &end);
+
+  if (end == text || !(value >= 0))
+    return FALSE;
+
+  if (g_ascii_strcasecmp (end, "ms") == 0)
+    ;
+  else if (*end == '\0' || g_ascii_strcasecmp (end, "s") == 0)
+    value *= 1000;
+  else
+    return FALSE;
+
+  if (value > DELAY_MAX)
+    return FALSE;
+
+  *delay = (gint) (value + 0.5);
+
+  return TRUE;
+}
@@ -18,6 +18,8 @@
  */
 
 #include "screenshooter-dialogs.h"
+#include "screenshooter-custom-upload.h"
+#include "screenshooter-s3.h"
 
 #define ICON_SIZE 16
 #define THUMB_X_SIZE 200
@@ -62,12 +64,14 @@ static void
 cb_imgur_copy_toggled              (GtkToggleButton    *tb,
                                     ScreenshotData     *sd);
 static void
+cb_custom_upload_toggled           (GtkToggleButton    *tb,
+                                    ScreenshotData     *sd);
+static void
+cb_s3_toggled                      (GtkToggleButton    *tb,
+                                    ScreenshotData     *sd);
+static void
 cb_delay_spinner_changed           (GtkWidget          *spinner,
                                     ScreenshotData     *sd);
-static gchar
-*generate_filename_for_uri         (const gchar        *uri,
-                                    const gchar        *title,
-                                    gboolean            timestamp);
 static void
 cb_combo_active_item_changed       (GtkWidget          *box,
                                     ScreenshotData     *sd);
@@ -208,95 +212,25 @@ static void cb_imgur_copy_toggled (GtkToggleButton *tb, ScreenshotData *sd)
     sd->action = UPLOAD_IMGUR_COPY;
 }
 
-
-
-
-/* Set the delay according to the spinner */
-static void cb_delay_spinner_changed (GtkWidget *spinner, ScreenshotData *sd)
+static void cb_custom_upload_toggled (GtkToggleButton *tb, ScreenshotData *sd)
 {
-  sd->delay = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (spinner));
+  if (gtk_toggle_button_get_active (tb))
+    sd->action = UPLOAD_CUSTOM;
 }
 
-
-
-/* If @timestamp is true, generates a file name @title - date - hour - n.png,
- * where n is the lowest integer such as this file does not exist in the @uri
- * folder.
- * Else, generates a file name @title-n.png, where n is the lowest integer
- * such as this file does not exist in the @uri folder.
- *
- * @uri: uri of the folder for which the filename should be generated.
- * @title: the main title of the file name.
- * @timestamp: whether the date and the hour should be appended to the file name.
- *
- * returns: the filename or NULL if *uri == NULL.
-*/
-static gchar *generate_filename_for_uri (const gchar *uri,
-                                         const gchar *title,
-                                         gboolean timestamp)
+static void cb_s3_toggled (GtkToggleButton *tb, ScreenshotData *sd)
 {
-  gboolean exists = TRUE;
-  GFile *directory;
-  GFile *file;
-  gchar *base_name;
-  gchar *datetime;
-  const gchar *strftime_format = "%Y-%m-%d_%H-%M-%S";
-
-  gint i;
-
-  if (G_UNLIKELY (uri == NULL))
-    {
-      TRACE ("URI was NULL");
-
-      return NULL;
-    }
-
-  TRACE ("Get the folder corresponding to the URI");
-  datetime = screenshooter_get_datetime (strftime_format);
-  directory = g_file_new_for_uri (uri);
-  if (!timestamp)
-    base_name = g_strconcat (title, ".png", NULL);
-  else
-    base_name = g_strconcat (title, "_", datetime, ".png", NULL);
-
-  file = g_file_get_child (directory, base_name);
-
-  if (!g_file_query_exists (file, NULL))
-    {
-      g_object_unref (file);
-      g_object_unref (directory);
-
-      return base_name;
-    }
-
-  g_object_unref (file);
-  g_free (base_name);
-
-  for (i = 1; exists; ++i)
-    {
-      const gchar *extension =
-        g_strdup_printf ("-%d.png", i);
-
-      if (!timestamp)
-         base_name = g_strconcat (title, extension, NULL);
-       else
-         base_name = g_strconcat (title, "_", datetime, extension, NULL);
-
-      file = g_file_get_child (directory, base_name);
-
-      if (!g_file_query_exists (file, NULL))
-        exists = FALSE;
+  if (gtk_toggle_button_get_active (tb))
+    sd->action = UPLOAD_S3;
+}
 
-      if (exists)
-        g_free (base_name);
 
-      g_object_unref (file);
-    }
 
-  g_free(datetime);
-  g_object_unref (directory);
 
-  return base_name;
+/* Set the delay according to the spinner */
+static void cb_delay_spinner_changed (GtkWidget *spinner, ScreenshotData *sd)
+{
+  sd->delay = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (spinner)) * 1000;
 }
 
 
@@ -865,7 +799,7 @@ GtkWidget *screenshooter_region_dialog_new (ScreenshotData *sd, gboolean plugin)
   gtk_box_pack_start (GTK_BOX (delay_box), delay_spinner_box, FALSE, FALSE, 0);
 
   delay_spinner = gtk_spin_button_new_with_range(0.0, 60.0, 1.0);
-  gtk_spin_button_set_value (GTK_SPIN_BUTTON (delay_spinner), sd->delay);
+  gtk_spin_button_set_value (GTK_SPIN_BUTTON (delay_spinner), sd->delay / 1000.0);
   gtk_widget_set_tooltip_text (delay_spinner,
                                _("Delay in seconds before the screenshot is taken"));
   gtk_box_pack_start (GTK_BOX (delay_spinner_box), delay_spinner, FALSE, FALSE, 0);
@@ -897,6 +831,8 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
   GtkWidget *zimagez_radio_button;
   GtkWidget *imgur_radio_button;
   GtkWidget *imgur_copy_radio_button;
+  GtkWidget *custom_upload_radio_button;
+  GtkWidget *s3_radio_button;
 
   GtkListStore *liststore;
   GtkWidget *combobox;
@@ -957,7 +893,7 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
   gtk_box_pack_start (GTK_BOX (left_box), actions_alignment, TRUE, TRUE, 0);
 
   /* Create the actions box */
-  actions_table = gtk_table_new (6, 2, FALSE);
+  actions_table = gtk_table_new (8, 2, FALSE);
   gtk_container_add (GTK_CONTAINER (actions_alignment), actions_table);
   gtk_table_set_row_spacings (GTK_TABLE (actions_table), 6);
   gtk_table_set_col_spacings (GTK_TABLE (actions_table), 6);
@@ -1063,6 +999,44 @@ GtkWidget *screenshooter_actions_dialog_new (ScreenshotData *sd)
                     G_CALLBACK (cb_imgur_copy_toggled), sd);
   gtk_table_attach (GTK_TABLE (actions_table), imgur_copy_radio_button, 0, 1, 5, 6, GTK_FILL, GTK_FILL, 0, 0);
 
+  if (sd->custom_upload != NULL)
+    {
+      const gchar *name = screenshooter_custom_upload_get_name (sd->custom_upload);
+      gchar *label = g_strdup_printf (_("Host on %s"), name);
+      gchar *tooltip = g_strdup_printf (_("Host the screenshot on %s, as set up"
+                                          " in the configuration file"), name);
+
+      /* Upload to the custom service radio button */
+      custom_upload_radio_button =
+        gtk_radio_button_new_with_label_from_widget (GTK_RADIO_BUTTON (save_radio_button),
+                                                     label);
+      gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (custom_upload_radio_button),
+                                    (sd->action == UPLOAD_CUSTOM));
+      gtk_widget_set_tooltip_text (custom_upload_radio_button, tooltip);
+      g_signal_connect (G_OBJECT (custom_upload_radio_button), "toggled",
+                        G_CALLBACK (cb_custom_upload_toggled), sd);
+      gtk_table_attach (GTK_TABLE (actions_table), custom_upload_radio_button, 0, 1, 6, 7, GTK_FILL, GTK_FILL, 0, 0);
+
+      g_free (label);
+      g_free (tooltip);
+    }
+
+  if (sd->s3 != NULL)
+    {
+      /* Upload to the S3 bucket radio button */
+      s3_radio_button =
+        gtk_radio_button_new_with_label_from_widget (GTK_RADIO_BUTTON (save_radio_button),
+                                                     _("Host on S3"));
+      gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (s3_radio_button),
+                                    (sd->action == UPLOAD_S3));
+      gtk_widget_set_tooltip_text (s3_radio_button,
+                                   _("Upload the screenshot to the S3 bucket set up"
+                                     " in the configuration file"));
+      g_signal_connect (G_OBJECT (s3_radio_button), "toggled",
+                        G_CALLBACK (cb_s3_toggled), sd);
+      gtk_table_attach (GTK_TABLE (actions_table), s3_radio_button, 0, 1, 7, 8, GTK_FILL, GTK_FILL, 0, 0);
+    }
+
   /* Preview box */
   preview_box = gtk_vbox_new (FALSE, 6);
   gtk_container_set_border_width (GTK_CONTAINER (preview_box), 0);
@@ -1122,7 +1096,7 @@ gchar
                                 gboolean save_dialog,
                                 gboolean show_preview)
 {
-  const gchar *filename = generate_filename_for_uri (directory, title, timestamp);
+  const gchar *filename = screenshooter_generate_filename_for_uri (directory, title, timestamp);
   gchar *save_uri = g_build_filename (directory, filename, NULL);
   gchar *result;
 
@@ -0,0 +1,371 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+
+/* Edges of a frozen screen, for the snapping of the region selection.
+
+   When the screen is frozen before a region is selected, the sides of
+   the selection snap to the nearby boundaries of the windows, buttons and
+   other elements shown on the image.
+
+   The edges are found by gradient thresholding: a vertical edge lies
+   between two horizontal neighbours whose luminance differs by more than
+   EDGE_THRESHOLD, and likewise for the horizontal edges. The rows are
+   processed in byte arrays with simple loops which the compiler turns
+   into vector instructions. The edges shorter than EDGE_MIN_LENGTH, like
+   the ones of the text, are then removed, so that only the boundaries of
+   the elements are left. The result is two bitmaps of the size of the
+   screen, 8 MB for an 8K screen.
+
+   The map is computed on a worker thread started when the selection
+   begins, and it is used as soon as it is ready. A query looks at a
+   bounded number of bits around the pointer, so the dragging does not
+   depend on the size of the screen.
+*/
+
+#include "screenshooter-edge-map.h"
+
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Difference of luminance which makes an edge, out of 255 */
+#define EDGE_THRESHOLD 24
+
+/* Shortest edge kept, in pixels */
+#define EDGE_MIN_LENGTH 12
+
+#define EDGE_GET(bits, stride, x, y) \
+  ((bits)[(y) * (stride) + ((x) >> 3)] & (1 << ((x) & 7)))
+#define EDGE_CLEAR(bits, stride, x, y) \
+  ((bits)[(y) * (stride) + ((x) >> 3)] &= ~(1 << ((x) & 7)))
+
+
+
+struct _ScreenshooterEdgeMap
+{
+  GdkPixbuf     *pixbuf;
+  GThread       *thread;
+
+  gint           width;
+  gint           height;
+
+  /* Bytes in a row of the bitmaps */
+  gint           stride;
+
+  /* Edges between the pixels x - 1 and x of a row */
+  guint8        *vertical;
+
+  /* Edges between the pixels y - 1 and y of a column */
+  guint8        *horizontal;
+
+  volatile gint  ready;
+  volatile gint  cancelled;
+};
+
+
+
+static void     compute_luminance  (const guchar         *pixels,
+                                    gint                  n_channels,
+                                    guint8               *luminance,
+                                    gint                  width);
+static void     pack_mask          (const guint8         *mask,
+                                    guint8               *bits,
+                                    gint                  width);
+static void     remove_short_edges (ScreenshooterEdgeMap *map);
+static gpointer edge_map_thread    (ScreenshooterEdgeMap *map);
+
+
+
+/* Internals */
+
+
+
+static void
+compute_luminance (const guchar *pixels,
+                   gint          n_channels,
+                   guint8       *luminance,
+                   gint          width)
+{
+  gint x;
+
+  for (x = 0; x < width; x++, pixels += n_channels)
+    luminance[x] = (pixels[0] * 77 + pixels[1] * 150 + pixels[2] * 29) >> 8;
+}
+
+
+
+/* Packs a row of 0 and 1 bytes into bits */
+static void
+pack_mask (const guint8 *mask, guint8 *bits, gint width)
+{
+  gint x;
+
+  for (x = 0; x < width; x++)
+    bits[x >> 3] |= mask[x] << (x & 7);
+}
+
+
+
+/* Removes the runs of edge pixels shorter than EDGE_MIN_LENGTH, along the
+ * columns for the vertical edges and along the rows for the horizontal
+ * ones */
+static void
+remove_short_edges (ScreenshooterEdgeMap *map)
+{
+  gint x, y, start, i;
+
+  for (x = 0; x < map->width && !g_atomic_int_get (&map->cancelled); x++)
+    for (y = 0; y < map->height; y++)
+      {
+        if (!EDGE_GET (map->vertical, map->stride, x, y))
+          continue;
+
+        for (start = y; y < map->height &&
+             EDGE_GET (map->vertical, map->stride, x, y); y++);
+
+        if (y - start < EDGE_MIN_LENGTH)
+          for (i = start; i < y; i++)
+            EDGE_CLEAR (map->vertical, map->stride, x, i);
+      }
+
+  for (y = 0; y < map->height && !g_atomic_int_get (&map->cancelled); y++)
+    for (x = 0; x < map->width; x++)
+      {
+        if (!EDGE_GET (map->horizontal, map->stride, x, y))
+          continue;
+
+        for (start = x; x < map->width &&
+             EDGE_GET (map->horizontal, map->stride, x, y); x++);
+
+        if (x - start < EDGE_MIN_LENGTH)
+          for (i = start; i < x; i++)
+            EDGE_CLEAR (map->horizontal, map->stride, i, y);
+      }
+}
+
+
+
+static gpointer
+edge_map_thread (ScreenshooterEdgeMap *map)
+{
+  const guchar *pixels = gdk_pixbuf_get_pixels (map->pixbuf);
+  gint rowstride = gdk_pixbuf_get_rowstride (map->pixbuf);
+  gint n_channels = gdk_pixbuf_get_n_channels (map->pixbuf);
+  guint8 *luminance = g_malloc (map->width);
+  guint8 *previous = g_malloc (map->width);
+  guint8 *mask = g_malloc0 (map->width);
+  gint64 start = g_get_monotonic_time ();
+  gint x, y, d;
+
+  for (y = 0; y < map->height; y++)
+    {
+      guint8 *swap;
+
+      if (g_atomic_int_get (&map->cancelled))
+        goto out;
+
+      compute_luminance (pixels + y * rowstride, n_channels,
+                         luminance, map->width);
+
+      mask[0] = 0;
+
+      for (x = 1; x < map->width; x++)
+        {
+          d = luminance[x] - luminance[x - 1];
+          mask[x] = (d > EDGE_THRESHOLD) | (d < -EDGE_THRESHOLD);
+        }
+
+      pack_mask (mask, map->vertical + y * map->stride, map->width);
+
+      if (y > 0)
+        {
+          for (x = 0; x < map->width; x++)
+            {
+              d = luminance[x] - previous[x];
+              mask[x] = (d > EDGE_THRESHOLD) | (d < -EDGE_THRESHOLD);
+            }
+
+          pack_mask (mask, map->horizontal + y * map->stride, map->width);
+        }
+
+      swap = previous;
+      previous = luminance;
+      luminance = swap;
+    }
+
+  remove_short_edges (map);
+
+  if (!g_atomic_int_get (&map->cancelled))
+    {
+      TRACE ("Edge map of %dx%d computed in %" G_GINT64_FORMAT " ms",
+             map->width, map->height,
+             (g_get_monotonic_time () - start) / 1000);
+
+      g_atomic_int_set (&map->ready, 1);
+    }
+
+out:
+  g_free (luminance);
+  g_free (previous);
+  g_free (mask);
+
+  return NULL;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_edge_map_new:
+ * @pixbuf: a #GdkPixbuf of the frozen screen, which must not be modified
+ * until the map is freed.
+ *
+ * Starts computing the edges of @pixbuf on a worker thread. The map
+ * does not snap anything until the edges are computed.
+ *
+ * Return value: a new #ScreenshooterEdgeMap, to be freed with
+ * screenshooter_edge_map_free().
+ **/
+ScreenshooterEdgeMap *
+screenshooter_edge_map_new (GdkPixbuf *pixbuf)
+{
+  ScreenshooterEdgeMap *map;
+
+  g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
+  g_return_val_if_fail (gdk_pixbuf_get_n_channels (pixbuf) >= 3, NULL);
+
+  map = g_new0 (ScreenshooterEdgeMap, 1);
+  map->pixbuf = g_object_ref (pixbuf);
+  map->width = gdk_pixbuf_get_width (pixbuf);
+  map->height = gdk_pixbuf_get_height (pixbuf);
+  map->stride = (map->width + 7) / 8;
+  map->vertical = g_malloc0 (map->stride * map->height);
+  map->horizontal = g_malloc0 (map->stride * map->height);
+
+  map->thread = g_thread_new ("edge-map", (GThreadFunc) edge_map_thread, map);
+
+  return map;
+}
+
+
+
+/**
+ * screenshooter_edge_map_snap_x:
+ * @map: a #ScreenshooterEdgeMap.
+ * @x: the horizontal position of a side of the selection.
+ * @y: the vertical position of the pointer.
+ * @distance: the largest move, in pixels.
+ *
+ * Finds the vertical edge closest to @x on the row @y.
+ *
+ * Return value: the position of the edge, or @x if there is none within
+ * @distance pixels or the edges are not computed yet.
+ **/
+gint
+screenshooter_edge_map_snap_x (ScreenshooterEdgeMap *map,
+                               gint                  x,
+                               gint                  y,
+                               gint                  distance)
+{
+  gint d;
+
+  g_return_val_if_fail (map != NULL, x);
+
+  if (!g_atomic_int_get (&map->ready) || y < 0 || y >= map->height)
+    return x;
+
+  for (d = 0; d <= distance; d++)
+    {
+      if (x - d >= 0 && x - d < map->width &&
+          EDGE_GET (map->vertical, map->stride, x - d, y))
+        return x - d;
+
+      if (x + d >= 0 && x + d < map->width &&
+          EDGE_GET (map->vertical, map->stride, x + d, y))
+        return x + d;
+    }
+
+  return x;
+}
+
+
+
+/**
+ * screenshooter_edge_map_snap_y:
+ * @map: a #ScreenshooterEdgeMap.
+ * @x: the horizontal position of the pointer.
+ * @y: the vertical position of a side of the selection.
+ * @distance: the largest move, in pixels.
+ *
+ * Finds the horizontal edge closest to @y on the column @x.
+ *
+ * Return value: the position of the edge, or @y if there is none within
+ * @distance pixels or the edges are not computed yet.
+ **/
+gint
+screenshooter_edge_map_snap_y (ScreenshooterEdgeMap *map,
+                               gint                  x,
+                               gint                  y,
+                               gint                  distance)
+{
+  gint d;
+
+  g_return_val_if_fail (map != NULL, y);
+
+  if (!g_atomic_int_get (&map->ready) || x < 0 || x >= map->width)
+    return y;
+
+  for (d = 0; d <= distance; d++)
+    {
+      if (y - d >= 0 && y - d < map->height &&
+          EDGE_GET (map->horizontal, map->stride, x, y - d))
+        return y - d;
+
+      if (y + d >= 0 && y + d < map->height &&
+          EDGE_GET (map->horizontal, map->stride, x, y + d))
+        return y + d;
+    }
+
+  return y;
+}
+
+
+
+/**
+ * screenshooter_edge_map_free:
+ * @map: a #ScreenshooterEdgeMap.
+ *
+ * Stops the computation of the edges if it still runs, and frees @map.
+ **/
+void
+screenshooter_edge_map_free (ScreenshooterEdgeMap *map)
+{
+  g_return_if_fail (map != NULL);
+
+  g_atomic_int_set (&map->cancelled, 1);
+  g_thread_join (map->thread);
+
+  g_object_unref (map->pixbuf);
+  g_free (map->vertical);
+  g_free (map->horizontal);
+  g_free (map);
+}
@@ -0,0 +1,42 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_EDGE_MAP_H__
+#define __HAVE_EDGE_MAP_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+typedef struct _ScreenshooterEdgeMap ScreenshooterEdgeMap;
+
+ScreenshooterEdgeMap *screenshooter_edge_map_new    (GdkPixbuf            *pixbuf);
+gint                  screenshooter_edge_map_snap_x (ScreenshooterEdgeMap *map,
+                                                     gint                  x,
+                                                     gint                  y,
+                                                     gint                  distance);
+gint                  screenshooter_edge_map_snap_y (ScreenshooterEdgeMap *map,
+                                                     gint                  x,
+                                                     gint                  y,
+                                                     gint                  distance);
+void                  screenshooter_edge_map_free   (ScreenshooterEdgeMap *map);
+
+#endif
@@ -36,10 +36,32 @@ enum {
   UPLOAD,
   UPLOAD_IMGUR,
   UPLOAD_IMGUR_COPY,
+  UPLOAD_CUSTOM,
+  UPLOAD_S3,
 };
 
 
 
+/* Upload service defined in the rc file, see screenshooter-custom-upload.c */
+typedef struct _ScreenshooterCustomUpload ScreenshooterCustomUpload;
+
+/* S3 bucket defined in the rc file, see screenshooter-s3.c */
+typedef struct _ScreenshooterS3 ScreenshooterS3;
+
+/* What a service accepts. Zero means that there is no limit. */
+typedef struct
+{
+  gint64       max_bytes;
+  gint64       max_pixels;
+
+  /* Comma separated list of the accepted formats, by order of
+   * preference, like "png,jpeg" */
+  const gchar *formats;
+}
+ScreenshooterUploadLimits;
+
+
+
 /* Struct to store the screenshot options */
 typedef struct
 {
@@ -55,7 +77,31 @@ typedef struct
   gchar *title;
   gchar *app;
   gchar *last_user;
+  gint upload_max_conns;
+  gint upload_max_conns_per_host;
+  gint upload_bandwidth_limit;
+  ScreenshooterCustomUpload *custom_upload;
+  ScreenshooterS3 *s3;
   GdkPixbuf *screenshot;
+
+  /* Stops the delay of the capture being taken, may be NULL */
+  GCancellable *cancellable;
+
+  /* A window of this process was hidden right before the capture */
+  gboolean own_ui;
+
+  /* Time nothing must be drawn on the captured area before the capture,
+   * in milliseconds, 0 to capture right away */
+  gint when_stable;
+
+  /* Whether the region is selected on a still image of the screen */
+  gboolean freeze_selection;
+
+  /* A screenshot is being taken or its actions are running */
+  gboolean capturing;
+
+  /* The capture was given up, the process exits with an error */
+  gboolean aborted;
 }
 ScreenshotData;
 
@@ -0,0 +1,610 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+
+/* Captures taken without initializing GTK.
+
+   When the screenshot is only saved to a local folder, nothing needs the
+   toolkit: no dialog is shown and no event loop is run. The screen is
+   read with Xlib, the pixels are converted to a GdkPixbuf and the PNG
+   encoder of gdk-pixbuf writes the file. This saves the start up of GTK,
+   the theme and the display connection it opens, which dominates the run
+   time of scripted captures.
+
+   Only the fullscreen and the active window captures are handled here.
+   Like the captures through GDK, the part of a window outside of its
+   XShape bounding region is transparent. When the visual of the screen
+   cannot be converted, the capture fails with G_IO_ERROR_NOT_SUPPORTED
+   before the delay and before anything was written, so that the caller
+   can take the screenshot the usual way.
+*/
+
+#include "screenshooter-headless.h"
+#include "screenshooter-global.h"
+#include "screenshooter-utils.h"
+
+#include <string.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/shape.h>
+#include <libxfce4util/libxfce4util.h>
+
+#ifdef HAVE_XFIXES
+#include <X11/extensions/Xfixes.h>
+#endif
+
+
+
+static gboolean   x_error = FALSE;
+
+
+
+static int        headless_error_handler    (Display      *display,
+                                             XErrorEvent  *event);
+static gboolean   headless_is_desktop       (Display      *display,
+                                             Window        xid);
+static Window     headless_get_frame        (Display      *display,
+                                             Window        xid);
+static Window     headless_get_active_frame (Display      *display,
+                                             Window        root);
+static void       headless_mask_shift       (gulong        mask,
+                                             gint         *shift,
+                                             gint         *bits);
+static gboolean   headless_check_visual     (Display      *display,
+                                             GError      **error);
+static GdkPixbuf *headless_image_to_pixbuf  (XImage       *image,
+                                             GError      **error);
+static GdkPixbuf *headless_apply_shape      (Display      *display,
+                                             Window        xid,
+                                             GdkPixbuf    *pixbuf,
+                                             gint          x,
+                                             gint          y);
+static void       headless_draw_cursor      (Display      *display,
+                                             GdkPixbuf    *pixbuf,
+                                             gint          x,
+                                             gint          y);
+
+
+
+/* Internals */
+
+
+
+/* The active window may be destroyed while it is inspected, X errors are
+ * recorded instead of aborting the program */
+static int
+headless_error_handler (Display *display, XErrorEvent *event)
+{
+  x_error = TRUE;
+
+  return 0;
+}
+
+
+
+static gboolean
+headless_is_desktop (Display *display, Window xid)
+{
+  Atom window_type = XInternAtom (display, "_NET_WM_WINDOW_TYPE", False);
+  Atom desktop = XInternAtom (display, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
+  Atom type;
+  int format;
+  unsigned long n_items, bytes_after, i;
+  unsigned char *data = NULL;
+  gboolean result = FALSE;
+
+  if (XGetWindowProperty (display, xid, window_type, 0, G_MAXLONG, False,
+                          XA_ATOM, &type, &format, &n_items, &bytes_after,
+                          &data) != Success || data == NULL)
+    return FALSE;
+
+  if (type == XA_ATOM && format == 32)
+    for (i = 0; i < n_items; i++)
+      if (((Atom *) data)[i] == desktop)
+        result = TRUE;
+
+  XFree (data);
+
+  return result;
+}
+
+
+
+/* Returns the child of the root window holding @xid, that is the frame
+ * added by the window manager, to grab the decorations too */
+static Window
+headless_get_frame (Display *display, Window xid)
+{
+  Window root, parent, *children;
+  unsigned int n_children;
+
+  while (XQueryTree (display, xid, &root, &parent, &children, &n_children))
+    {
+      if (children != NULL)
+        XFree (children);
+
+      if (parent == root || parent == None)
+        return xid;
+
+      xid = parent;
+    }
+
+  return None;
+}
+
+
+
+static Window
+headless_get_active_frame (Display *display, Window root)
+{
+  Atom active = XInternAtom (display, "_NET_ACTIVE_WINDOW", False);
+  Atom type;
+  int format;
+  unsigned long n_items, bytes_after;
+  unsigned char *data = NULL;
+  Window xid = None, frame;
+
+  if (XGetWindowProperty (display, root, active, 0, 1, False, XA_WINDOW,
+                          &type, &format, &n_items, &bytes_after,
+                          &data) == Success && data != NULL)
+    {
+      if (type == XA_WINDOW && format == 32 && n_items == 1)
+        xid = ((Window *) data)[0];
+
+      XFree (data);
+    }
+
+  if (xid == None)
+    {
+      TRACE ("No active window, fallback to the root window");
+
+      return root;
+    }
+
+  if (headless_is_desktop (display, xid))
+    {
+      TRACE ("The active window is the desktop, fallback to the root window");
+
+      return root;
+    }
+
+  frame = headless_get_frame (display, xid);
+  XSync (display, False);
+
+  if (frame == None || x_error)
+    {
+      TRACE ("The active window is destroyed, fallback to the root window");
+
+      x_error = FALSE;
+      return root;
+    }
+
+  return frame;
+}
+
+
+
+static void
+headless_mask_shift (gulong mask, gint *shift, gint *bits)
+{
+  *shift = 0;
+  *bits = 0;
+
+  if (mask == 0)
+    return;
+
+  while (!(mask & 1))
+    {
+      mask >>= 1;
+      (*shift)++;
+    }
+
+  while (mask & 1)
+    {
+      mask >>= 1;
+      (*bits)++;
+    }
+}
+
+
+
+/* Whether the pixels of the default visual can be converted without the
+ * colormap */
+static gboolean
+headless_check_visual (Display *display, GError **error)
+{
+  Visual *visual = DefaultVisual (display, DefaultScreen (display));
+  gulong masks[3];
+  gint c, shift, bits;
+
+  masks[0] = visual->red_mask;
+  masks[1] = visual->green_mask;
+  masks[2] = visual->blue_mask;
+
+  for (c = 0; c < 3; c++)
+    {
+      headless_mask_shift (masks[c], &shift, &bits);
+
+      if (visual->class != TrueColor || bits == 0 || bits > 8)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       _("The visual of the screen is not a true color visual"));
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+
+
+static GdkPixbuf
+*headless_image_to_pixbuf (XImage *image, GError **error)
+{
+  GdkPixbuf *pixbuf;
+  guchar *pixels;
+  gint rowstride, x, y, c;
+  gint shift[3], bits[3];
+  gulong masks[3];
+  gboolean direct;
+
+  masks[0] = image->red_mask;
+  masks[1] = image->green_mask;
+  masks[2] = image->blue_mask;
+
+  for (c = 0; c < 3; c++)
+    {
+      headless_mask_shift (masks[c], &shift[c], &bits[c]);
+
+      /* Palette based visuals need the colormap, leave them to GDK */
+      if (bits[c] == 0 || bits[c] > 8)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       _("The visual of the screen is not a true color visual"));
+          return NULL;
+        }
+    }
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+                           image->width, image->height);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  /* 32 bits pixels in the byte order of the host are read directly, the
+   * other layouts go through XGetPixel () */
+  direct = image->bits_per_pixel == 32 &&
+    image->byte_order == (G_BYTE_ORDER == G_LITTLE_ENDIAN ? LSBFirst : MSBFirst);
+
+  TRACE ("Convert a %dx%d image, %d bits per pixel", image->width,
+         image->height, image->bits_per_pixel);
+
+  for (y = 0; y < image->height; y++)
+    {
+      const guint32 *src = (const guint32 *) (image->data + y * image->bytes_per_line);
+      guchar *dest = pixels + y * rowstride;
+
+      for (x = 0; x < image->width; x++, dest += 3)
+        {
+          gulong pixel = direct ? src[x] : XGetPixel (image, x, y);
+
+          for (c = 0; c < 3; c++)
+            {
+              guint value = (pixel & masks[c]) >> shift[c];
+
+              /* Scale channels narrower than 8 bits to the full range */
+              dest[c] = bits[c] == 8 ? value :
+                (value * 255 + ((1 << bits[c]) - 1) / 2) / ((1 << bits[c]) - 1);
+            }
+        }
+    }
+
+  return pixbuf;
+}
+
+
+
+/* Returns @pixbuf with an alpha channel, where the pixels outside of the
+ * bounding region of @xid are transparent. The window is at @x, @y in
+ * @pixbuf. @pixbuf is consumed. */
+static GdkPixbuf
+*headless_apply_shape (Display *display, Window xid, GdkPixbuf *pixbuf,
+                       gint x, gint y)
+{
+  XRectangle *rectangles;
+  GdkPixbuf *shaped;
+  gint event_base, error_base, count, order, width, height, i, j, k;
+
+  if (!XShapeQueryExtension (display, &event_base, &error_base))
+    return pixbuf;
+
+  rectangles = XShapeGetRectangles (display, xid, ShapeBounding, &count, &order);
+
+  if (rectangles == NULL || count <= 0)
+    {
+      if (rectangles != NULL)
+        XFree (rectangles);
+
+      return pixbuf;
+    }
+
+  TRACE ("Apply the %d rectangles of the shape of the window", count);
+
+  width = gdk_pixbuf_get_width (pixbuf);
+  height = gdk_pixbuf_get_height (pixbuf);
+  shaped = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, width, height);
+  gdk_pixbuf_fill (shaped, 0);
+
+  for (k = 0; k < count; k++)
+    {
+      gint left = MAX (x + rectangles[k].x, 0);
+      gint top = MAX (y + rectangles[k].y, 0);
+      gint right = MIN (x + rectangles[k].x + rectangles[k].width, width);
+      gint bottom = MIN (y + rectangles[k].y + rectangles[k].height, height);
+
+      for (j = top; j < bottom; j++)
+        {
+          const guchar *src = gdk_pixbuf_get_pixels (pixbuf) +
+            j * gdk_pixbuf_get_rowstride (pixbuf) + left * 3;
+          guchar *dest = gdk_pixbuf_get_pixels (shaped) +
+            j * gdk_pixbuf_get_rowstride (shaped) + left * 4;
+
+          for (i = left; i < right; i++, src += 3, dest += 4)
+            {
+              dest[0] = src[0];
+              dest[1] = src[1];
+              dest[2] = src[2];
+              dest[3] = 255;
+            }
+        }
+    }
+
+  XFree (rectangles);
+  g_object_unref (pixbuf);
+
+  return shaped;
+}
+
+
+
+/* Blends the cursor on @pixbuf, which was taken at @x, @y on the screen */
+static void
+headless_draw_cursor (Display *display, GdkPixbuf *pixbuf, gint x, gint y)
+{
+#ifdef HAVE_XFIXES
+  XFixesCursorImage *cursor;
+  guchar *pixels = gdk_pixbuf_get_pixels (pixbuf);
+  gint rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  gint n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+  gint width = gdk_pixbuf_get_width (pixbuf);
+  gint height = gdk_pixbuf_get_height (pixbuf);
+  gint event_base, error_base, left, top, i, j;
+
+  if (!XFixesQueryExtension (display, &event_base, &error_base))
+    return;
+
+  cursor = XFixesGetCursorImage (display);
+
+  if (cursor == NULL)
+    return;
+
+  TRACE ("Draw the mouse cursor");
+
+  left = cursor->x - cursor->xhot - x;
+  top = cursor->y - cursor->yhot - y;
+
+  for (j = MAX (0, -top); j < cursor->height && top + j < height; j++)
+    for (i = MAX (0, -left); i < cursor->width && left + i < width; i++)
+      {
+        /* Premultiplied 32-bit ARGB stored in longs */
+        guint32 argb = cursor->pixels[j * cursor->width + i];
+        guint alpha = argb >> 24;
+        guchar *dest = pixels + (top + j) * rowstride + (left + i) * n_channels;
+        guint dest_alpha = n_channels == 4 ? dest[3] : 255;
+        guint blended = alpha + dest_alpha * (255 - alpha) / 255;
+        gint c;
+
+        /* Nothing to draw where both are transparent */
+        if (blended == 0)
+          continue;
+
+        for (c = 0; c < 3; c++)
+          dest[c] = MIN (((argb >> (16 - 8 * c)) & 0xff) * 255 / blended +
+                         dest[c] * dest_alpha * (255 - alpha) / 255 / blended,
+                         255);
+
+        if (n_channels == 4)
+          dest[3] = blended;
+      }
+
+  XFree (cursor);
+#endif
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_headless_capture:
+ * @region: FULLSCREEN or ACTIVE_WINDOW.
+ * @delay: the delay before the capture, in milliseconds.
+ * @show_mouse: whether the mouse cursor should be drawn on the screenshot.
+ * @directory: the URI of a local folder.
+ * @title: the title of the file.
+ * @timestamp: whether the date and time should be appended to the title.
+ * @error: return location for errors.
+ *
+ * Takes a screenshot and saves it as a PNG file in @directory, without
+ * using GTK. The file is named like the ones saved by
+ * screenshooter_save_screenshot().
+ *
+ * Return value: the path of the saved file, or %NULL on error. The error
+ * is G_IO_ERROR_NOT_SUPPORTED when the screen can only be captured through
+ * GDK. @delay may already have elapsed then, if the screen could not be
+ * read.
+ **/
+gchar
+*screenshooter_headless_capture (gint         region,
+                                 gint         delay,
+                                 gboolean     show_mouse,
+                                 const gchar *directory,
+                                 const gchar *title,
+                                 gboolean     timestamp,
+                                 GError     **error)
+{
+  Display *display;
+  Window root, target, child;
+  XWindowAttributes attributes;
+  gint window_x = 0, window_y = 0;
+  XErrorHandler old_handler;
+  XImage *image;
+  GdkPixbuf *pixbuf;
+  GFile *dir;
+  gchar *dir_path, *filename, *path = NULL;
+  gint x = 0, y = 0, width, height;
+
+  g_return_val_if_fail (region == FULLSCREEN || region == ACTIVE_WINDOW, NULL);
+  g_return_val_if_fail (directory != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  dir = g_file_new_for_uri (directory);
+  dir_path = g_file_get_path (dir);
+  g_object_unref (dir);
+
+  if (dir_path == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   _("%s is not a local folder"), directory);
+      return NULL;
+    }
+
+  display = XOpenDisplay (NULL);
+
+  if (display == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   _("Cannot open the display"));
+      g_free (dir_path);
+      return NULL;
+    }
+
+  /* Fail before the delay, the caller waits for it again */
+  if (!headless_check_visual (display, error))
+    {
+      XCloseDisplay (display);
+      g_free (dir_path);
+      return NULL;
+    }
+
+  /* Nothing else runs in this process, it can simply sleep */
+  if (delay > 0)
+    {
+      TRACE ("Wait %d ms", delay);
+      g_usleep ((gulong) delay * 1000);
+    }
+
+  old_handler = XSetErrorHandler (headless_error_handler);
+  root = DefaultRootWindow (display);
+  target = region == ACTIVE_WINDOW ?
+    headless_get_active_frame (display, root) : root;
+
+  width = DisplayWidth (display, DefaultScreen (display));
+  height = DisplayHeight (display, DefaultScreen (display));
+
+  if (target != root &&
+      XGetWindowAttributes (display, target, &attributes) &&
+      XTranslateCoordinates (display, target, root, 0, 0, &x, &y, &child))
+    {
+      gint right = MIN (x + attributes.width + 2 * attributes.border_width, width);
+      gint bottom = MIN (y + attributes.height + 2 * attributes.border_width, height);
+
+      /* Where the window is in the screenshot */
+      window_x = MIN (x, 0);
+      window_y = MIN (y, 0);
+
+      /* Only keep the part of the window which is on the screen */
+      x = MAX (x, 0);
+      y = MAX (y, 0);
+      width = right - x;
+      height = bottom - y;
+    }
+
+  TRACE ("Grab %dx%d+%d+%d", width, height, x, y);
+
+  image = width > 0 && height > 0 ?
+    XGetImage (display, root, x, y, width, height, AllPlanes, ZPixmap) : NULL;
+
+  XSync (display, False);
+  XSetErrorHandler (old_handler);
+  x_error = FALSE;
+
+  if (image == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   _("Cannot read the screen"));
+      XCloseDisplay (display);
+      g_free (dir_path);
+      return NULL;
+    }
+
+  pixbuf = headless_image_to_pixbuf (image, error);
+  XDestroyImage (image);
+
+  if (pixbuf != NULL && target != root)
+    {
+      XSetErrorHandler (headless_error_handler);
+      pixbuf = headless_apply_shape (display, target, pixbuf,
+                                     window_x, window_y);
+      XSync (display, False);
+      XSetErrorHandler (old_handler);
+      x_error = FALSE;
+    }
+
+  if (pixbuf != NULL && show_mouse)
+    headless_draw_cursor (display, pixbuf, x, y);
+
+  XCloseDisplay (display);
+
+  if (pixbuf != NULL)
+    {
+      filename = screenshooter_generate_filename_for_uri (directory, title,
+                                                          timestamp);
+      path = g_build_filename (dir_path, filename, NULL);
+      g_free (filename);
+
+      TRACE ("Save the screenshot to %s", path);
+
+      if (!gdk_pixbuf_save (pixbuf, path, "png", error, NULL))
+        {
+          g_free (path);
+          path = NULL;
+        }
+
+      g_object_unref (pixbuf);
+    }
+
+  g_free (dir_path);
+
+  return path;
+}
@@ -0,0 +1,339 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Global shortcuts grabbed by a resident process.
+
+   The shortcuts are read from the rc file, in the format of
+   gtk_accelerator_parse (), for instance "<Control><Shift>Print":
+
+   hotkey_fullscreen  captures the entire screen
+   hotkey_window      captures the active window
+   hotkey_region      lets the user select a region
+
+   Each key is grabbed on the root window with XGrabKey, once for each
+   combination of the lock modifiers, and the key presses are caught by a
+   filter on the root window. The capture then starts in the same
+   process, without spawning a new one. The same keys should not be
+   bound in the keyboard settings too, the grab fails if another client
+   holds them.
+
+   Num Lock, Scroll Lock, Super, Hyper and Meta are bound to one of the
+   Mod1 to Mod5 modifiers by the keyboard layout. The modifier map is read
+   when the keys are grabbed to know which ones.
+*/
+
+#include "screenshooter-hotkeys.h"
+#include "screenshooter-global.h"
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <libxfce4util/libxfce4util.h>
+
+
+
+typedef struct
+{
+  gint    region;
+  KeyCode keycode;
+  guint   modifiers;
+}
+Hotkey;
+
+
+
+static GArray                  *hotkeys = NULL;
+static ScreenshooterHotkeyFunc  hotkey_func = NULL;
+static gpointer                 hotkey_data = NULL;
+
+/* Modifiers which do not change the meaning of a shortcut */
+static guint                    lock_masks = LockMask;
+
+
+
+static guint           hotkeys_modifier  (Display     *display,
+                                          KeySym       keysym);
+static void            hotkeys_grab_key  (Display     *display,
+                                          Window       root,
+                                          Hotkey      *hotkey,
+                                          gboolean     grab);
+static gboolean        hotkeys_add       (Display     *display,
+                                          Window       root,
+                                          XfceRc      *rc,
+                                          const gchar *key,
+                                          gint         region);
+static GdkFilterReturn hotkeys_filter    (GdkXEvent   *xevent,
+                                          GdkEvent    *event,
+                                          gpointer     unused);
+
+
+
+/* Internals */
+
+
+
+/* Returns the real modifier @keysym is bound to, or 0 */
+static guint
+hotkeys_modifier (Display *display, KeySym keysym)
+{
+  XModifierKeymap *map;
+  KeyCode keycode = XKeysymToKeycode (display, keysym);
+  guint modifier = 0;
+  gint i;
+
+  if (keycode == 0)
+    return 0;
+
+  map = XGetModifierMapping (display);
+
+  for (i = 0; i < 8 * map->max_keypermod; i++)
+    {
+      if (map->modifiermap[i] == keycode)
+        {
+          modifier = 1 << (i / map->max_keypermod);
+          break;
+        }
+    }
+
+  XFreeModifiermap (map);
+
+  return modifier;
+}
+
+
+
+static void
+hotkeys_grab_key (Display *display, Window root, Hotkey *hotkey, gboolean grab)
+{
+  guint bits[8];
+  guint n_bits = 0, i, j;
+
+  for (i = 0; i < 8; i++)
+    if (lock_masks & (1 << i))
+      bits[n_bits++] = 1 << i;
+
+  /* Once for each combination of the lock modifiers */
+  for (i = 0; i < (1U << n_bits); i++)
+    {
+      guint locks = 0;
+
+      for (j = 0; j < n_bits; j++)
+        if (i & (1 << j))
+          locks |= bits[j];
+
+      if (grab)
+        XGrabKey (display, hotkey->keycode, hotkey->modifiers | locks,
+                  root, False, GrabModeAsync, GrabModeAsync);
+      else
+        XUngrabKey (display, hotkey->keycode, hotkey->modifiers | locks,
+                    root);
+    }
+}
+
+
+
+static gboolean
+hotkeys_add (Display     *display,
+             Window       root,
+             XfceRc      *rc,
+             const gchar *key,
+             gint         region)
+{
+  GdkModifierType modifiers;
+  const gchar *accelerator;
+  Hotkey hotkey;
+  guint keyval;
+
+  accelerator = xfce_rc_read_entry (rc, key, NULL);
+
+  if (accelerator == NULL || *accelerator == '\0')
+    return FALSE;
+
+  gtk_accelerator_parse (accelerator, &keyval, &modifiers);
+
+  hotkey.region = region;
+  hotkey.keycode = XKeysymToKeycode (display, keyval);
+  hotkey.modifiers = modifiers & (ShiftMask | ControlMask | Mod1Mask);
+
+  /* Super, Hyper and Meta are virtual modifiers, X only knows the real
+   * ones */
+  if (modifiers & GDK_SUPER_MASK)
+    hotkey.modifiers |= hotkeys_modifier (display, XK_Super_L);
+
+  if (modifiers & GDK_HYPER_MASK)
+    hotkey.modifiers |= hotkeys_modifier (display, XK_Hyper_L);
+
+  if (modifiers & GDK_META_MASK)
+    hotkey.modifiers |= hotkeys_modifier (display, XK_Meta_L);
+
+  hotkey.modifiers &= ~lock_masks;
+
+  if (keyval == 0 || hotkey.keycode == 0)
+    {
+      g_printerr (_("%s is not a valid shortcut.\n"), accelerator);
+
+      return FALSE;
+    }
+
+  gdk_error_trap_push ();
+  hotkeys_grab_key (display, root, &hotkey, TRUE);
+  gdk_flush ();
+
+  if (gdk_error_trap_pop () != 0)
+    {
+      /* BadAccess, another client grabbed the same key */
+      g_printerr (_("The %s shortcut is already used by another"
+                    " application.\n"), accelerator);
+
+      gdk_error_trap_push ();
+      hotkeys_grab_key (display, root, &hotkey, FALSE);
+      gdk_flush ();
+      gdk_error_trap_pop ();
+
+      return FALSE;
+    }
+
+  TRACE ("%s grabbed", accelerator);
+
+  g_array_append_val (hotkeys, hotkey);
+
+  return TRUE;
+}
+
+
+
+static GdkFilterReturn
+hotkeys_filter (GdkXEvent *xevent, GdkEvent *event, gpointer unused)
+{
+  XEvent *xev = (XEvent *) xevent;
+  guint i;
+
+  if (xev->type != KeyPress)
+    return GDK_FILTER_CONTINUE;
+
+  for (i = 0; i < hotkeys->len; i++)
+    {
+      Hotkey *hotkey = &g_array_index (hotkeys, Hotkey, i);
+
+      if (xev->xkey.keycode == hotkey->keycode &&
+          (xev->xkey.state & ~lock_masks & 0xff) == hotkey->modifiers)
+        {
+          TRACE ("Shortcut for region %d pressed", hotkey->region);
+
+          hotkey_func (hotkey->region, hotkey_data);
+
+          return GDK_FILTER_REMOVE;
+        }
+    }
+
+  return GDK_FILTER_CONTINUE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_hotkeys_grab:
+ * @rc_file: the path of the rc file defining the shortcuts.
+ * @func: function called when a shortcut is pressed.
+ * @user_data: data passed to @func.
+ *
+ * Grabs the capture shortcuts defined in @rc_file. @func is called from
+ * the GDK event filter with the region of the shortcut, FULLSCREEN,
+ * ACTIVE_WINDOW or SELECT, while the key is still held. It should return
+ * quickly and leave the capture to the main loop.
+ *
+ * Return value: the number of shortcuts which could be grabbed.
+ **/
+gint
+screenshooter_hotkeys_grab (const gchar             *rc_file,
+                            ScreenshooterHotkeyFunc  func,
+                            gpointer                 user_data)
+{
+  GdkWindow *root = gdk_get_default_root_window ();
+  Display *display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+  XfceRc *rc;
+
+  g_return_val_if_fail (rc_file != NULL, 0);
+  g_return_val_if_fail (func != NULL, 0);
+  g_return_val_if_fail (hotkeys == NULL, 0);
+
+  rc = xfce_rc_simple_open (rc_file, TRUE);
+
+  if (rc == NULL)
+    return 0;
+
+  hotkeys = g_array_new (FALSE, FALSE, sizeof (Hotkey));
+  hotkey_func = func;
+  hotkey_data = user_data;
+
+  /* Where the layout puts Num Lock and Scroll Lock */
+  lock_masks = LockMask | hotkeys_modifier (display, XK_Num_Lock) |
+    hotkeys_modifier (display, XK_Scroll_Lock);
+
+  hotkeys_add (display, GDK_WINDOW_XID (root), rc, "hotkey_fullscreen", FULLSCREEN);
+  hotkeys_add (display, GDK_WINDOW_XID (root), rc, "hotkey_window", ACTIVE_WINDOW);
+  hotkeys_add (display, GDK_WINDOW_XID (root), rc, "hotkey_region", SELECT);
+
+  xfce_rc_close (rc);
+
+  if (hotkeys->len > 0)
+    gdk_window_add_filter (root, hotkeys_filter, NULL);
+
+  return hotkeys->len;
+}
+
+
+
+/**
+ * screenshooter_hotkeys_ungrab:
+ *
+ * Releases the shortcuts grabbed by screenshooter_hotkeys_grab().
+ **/
+void
+screenshooter_hotkeys_ungrab (void)
+{
+  GdkWindow *root = gdk_get_default_root_window ();
+  Display *display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+  guint i;
+
+  if (hotkeys == NULL)
+    return;
+
+  if (hotkeys->len > 0)
+    gdk_window_remove_filter (root, hotkeys_filter, NULL);
+
+  gdk_error_trap_push ();
+
+  for (i = 0; i < hotkeys->len; i++)
+    hotkeys_grab_key (display, GDK_WINDOW_XID (root),
+                      &g_array_index (hotkeys, Hotkey, i), FALSE);
+
+  gdk_flush ();
+  gdk_error_trap_pop ();
+
+  g_array_free (hotkeys, TRUE);
+  hotkeys = NULL;
+  hotkey_func = NULL;
+  hotkey_data = NULL;
+}
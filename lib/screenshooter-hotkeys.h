@@ -1,6 +1,6 @@
 /*  $Id$
  *
- *  Copyright © 2009 Sebastian Waisbrot <seppo0010@gmail.com>
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
  *
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
@@ -17,24 +17,21 @@
  *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  * */
 
-#ifndef __HAVE_IMGUR_H__
-#define __HAVE_IMGUR_H__
+#ifndef __HAVE_HOTKEYS_H__
+#define __HAVE_HOTKEYS_H__
 
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
 
 #include <glib.h>
-#include <glib/gstdio.h>
 
-#include "screenshooter-utils.h"
-#include "screenshooter-simple-job.h"
-#include "katze-throbber.h"
+typedef void (*ScreenshooterHotkeyFunc) (gint     region,
+                                         gpointer user_data);
 
-void screenshooter_upload_to_imgur 				(const gchar  *image_path,
-                                    			 const gchar  *title);
-
-void screenshooter_upload_to_imgur_copy_link 	(const gchar  *image_path,
-                                    			 const gchar  *title);
+gint screenshooter_hotkeys_grab   (const gchar             *rc_file,
+                                   ScreenshooterHotkeyFunc  func,
+                                   gpointer                 user_data);
+void screenshooter_hotkeys_ungrab (void);
 
 #endif
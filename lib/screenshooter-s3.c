@@ -0,0 +1,130 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Uploads to Amazon S3 or to a compatible server such as MinIO.
+
+   The service is described by the following keys of the rc file:
+
+   s3_endpoint    URL of the server, https://s3.amazonaws.com for example
+   s3_region      region of the bucket, us-east-1 by default
+   s3_bucket      name of the bucket
+   s3_access_key  access key id
+   s3_secret_key  secret access key
+   s3_prefix      string prepended to the file name to build the object key
+   s3_part_size   size of the parts in MiB, 8 by default and at least 5
+   s3_parallel    number of parts sent at the same time, 4 by default
+
+   The file is sent with a multipart upload: its parts are read from the
+   disk and sent in parallel by a thread pool, over the connections of the
+   shared session. The requests are signed with AWS Signature Version 4 and
+   use path-style URLs, which every compatible server understands.
+
+   The upload id and the ETags of the parts already sent are saved in the
+   cache directory, so that uploading the same file again after a failure
+   only sends the missing parts.
+*/
+
+#include "screenshooter-s3.h"
+
+#include <string.h>
+
+#define S3_MIN_PART_SIZE      5
+#define S3_DEFAULT_PART_SIZE  8
+#define S3_DEFAULT_PARALLEL   4
+#define S3_MAX_PARALLEL       16
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_s3_new_from_rc:
+ * @rc: the rc file of the application or of the panel plugin.
+ *
+ * Reads the description of the S3 bucket from @rc.
+ *
+ * Return value: a new #ScreenshooterS3, or %NULL if no bucket is set up
+ * in @rc.
+ **/
+ScreenshooterS3
+*screenshooter_s3_new_from_rc (XfceRc *rc)
+{
+  ScreenshooterS3 *s3;
+  const gchar *endpoint, *bucket, *access_key, *secret_key;
+
+  g_return_val_if_fail (rc != NULL, NULL);
+
+  endpoint = xfce_rc_read_entry (rc, "s3_endpoint", NULL);
+  bucket = xfce_rc_read_entry (rc, "s3_bucket", NULL);
+  access_key = xfce_rc_read_entry (rc, "s3_access_key", NULL);
+  secret_key = xfce_rc_read_entry (rc, "s3_secret_key", NULL);
+
+  if (endpoint == NULL || *endpoint == '\0' || bucket == NULL ||
+      *bucket == '\0' || access_key == NULL || secret_key == NULL)
+    return NULL;
+
+  s3 = g_new0 (ScreenshooterS3, 1);
+  s3->endpoint = g_strdup (endpoint);
+  s3->bucket = g_strdup (bucket);
+  s3->access_key = g_strdup (access_key);
+  s3->secret_key = g_strdup (secret_key);
+  s3->region = g_strdup (xfce_rc_read_entry (rc, "s3_region", "us-east-1"));
+  s3->prefix = g_strdup (xfce_rc_read_entry (rc, "s3_prefix", ""));
+  s3->part_size =
+    (goffset) MAX (xfce_rc_read_int_entry (rc, "s3_part_size",
+                                           S3_DEFAULT_PART_SIZE),
+                   S3_MIN_PART_SIZE) * 1024 * 1024;
+  s3->parallel =
+    CLAMP (xfce_rc_read_int_entry (rc, "s3_parallel", S3_DEFAULT_PARALLEL),
+           1, S3_MAX_PARALLEL);
+
+  /* The paths are appended to the endpoint */
+  while (g_str_has_suffix (s3->endpoint, "/"))
+    s3->endpoint[strlen (s3->endpoint) - 1] = '\0';
+
+  return s3;
+}
+
+
+
+/**
+ * screenshooter_s3_free:
+ * @s3: a #ScreenshooterS3, or %NULL.
+ *
+ * Frees @s3.
+ **/
+void
+screenshooter_s3_free (ScreenshooterS3 *s3)
+{
+  if (s3 == NULL)
+    return;
+
+  if (s3->secret_key != NULL)
+    memset (s3->secret_key, 0, strlen (s3->secret_key));
+
+  g_free (s3->endpoint);
+  g_free (s3->region);
+  g_free (s3->bucket);
+  g_free (s3->access_key);
+  g_free (s3->secret_key);
+  g_free (s3->prefix);
+  g_free (s3);
+}
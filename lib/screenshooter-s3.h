@@ -0,0 +1,48 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_S3_H__
+#define __HAVE_S3_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <libxfce4util/libxfce4util.h>
+
+#include "screenshooter-global.h"
+
+/* The fields are read by the upload module */
+struct _ScreenshooterS3
+{
+  gchar   *endpoint;
+  gchar   *region;
+  gchar   *bucket;
+  gchar   *access_key;
+  gchar   *secret_key;
+  gchar   *prefix;
+  goffset  part_size;
+  gint     parallel;
+};
+
+ScreenshooterS3 *screenshooter_s3_new_from_rc (XfceRc          *rc);
+void             screenshooter_s3_free        (ScreenshooterS3 *s3);
+
+#endif
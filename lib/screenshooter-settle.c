@@ -0,0 +1,327 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+
+/* Waits for the screen to settle before a capture.
+
+   When our own dialog or selection window goes away right before a
+   capture, the windows below have to repaint the area it covered, and a
+   compositor may fade it out over several frames. A fixed delay was used
+   to let this happen, which was either too short or needlessly long.
+
+   Our windows are unmapped as soon as the X server has processed our
+   requests, which a round trip ensures. The repainting is then followed
+   with the DAMAGE extension: a damage object on the root window reports
+   every rectangle drawn on the screen, including the frames of the
+   compositor, and the screen is considered settled once nothing was
+   drawn in the captured area for a quiet period. A hard timeout bounds
+   the wait for areas which never stop changing, like a video. Without
+   the extension the repainting cannot be seen, the wait lasts a short
+   fixed time and the screen is then assumed to be settled.
+
+   Like the delay, the wait is made of sources of the main loop, and the
+   capture continues from the callback given to screenshooter_settle_start ().
+*/
+
+#include "screenshooter-settle.h"
+#include "screenshooter-delay.h"
+
+#include <gdk/gdkx.h>
+#include <libxfce4util/libxfce4util.h>
+
+#ifdef HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+
+/* Length of the wait without DAMAGE, in milliseconds, within the quiet
+ * period and the timeout */
+#define FALLBACK_WAIT 250
+
+
+
+typedef struct
+{
+  GdkRectangle             area;
+  gint                     quiet;
+  guint                    quiet_id;
+  guint                    timeout_id;
+  GSource                 *cancel_source;
+  gint64                   start;
+  ScreenshooterSettleFunc  func;
+  gpointer                 user_data;
+#ifdef HAVE_XDAMAGE
+  Damage                   damage;
+  gint                     event_base;
+#endif
+}
+SettleWait;
+
+
+
+static void            settle_finish      (SettleWait                *wait,
+                                           ScreenshooterSettleResult  result);
+static void            cb_delay_elapsed   (gboolean                   elapsed,
+                                           SettleWait                *wait);
+#ifdef HAVE_XDAMAGE
+static gboolean        cb_quiet           (SettleWait                *wait);
+static gboolean        cb_timeout         (SettleWait                *wait);
+static gboolean        cb_cancelled       (GCancellable              *cancellable,
+                                           SettleWait                *wait);
+static GdkFilterReturn damage_filter_func (GdkXEvent                 *xevent,
+                                           GdkEvent                  *event,
+                                           SettleWait                *wait);
+static gboolean        settle_with_damage (SettleWait                *wait,
+                                           gint                       timeout,
+                                           GCancellable              *cancellable);
+#endif
+
+
+
+/* Internals */
+
+
+
+static void
+settle_finish (SettleWait *wait, ScreenshooterSettleResult result)
+{
+  gint waited = (g_get_monotonic_time () - wait->start) / 1000;
+
+  if (wait->quiet_id != 0)
+    g_source_remove (wait->quiet_id);
+
+  if (wait->timeout_id != 0)
+    g_source_remove (wait->timeout_id);
+
+  if (wait->cancel_source != NULL)
+    {
+      g_source_destroy (wait->cancel_source);
+      g_source_unref (wait->cancel_source);
+    }
+
+#ifdef HAVE_XDAMAGE
+  if (wait->damage != None)
+    {
+      gdk_window_remove_filter (NULL, (GdkFilterFunc) damage_filter_func, wait);
+
+      gdk_error_trap_push ();
+      XDamageDestroy (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
+                      wait->damage);
+      gdk_flush ();
+      gdk_error_trap_pop ();
+    }
+#endif
+
+  TRACE ("Waited %d ms for the screen to settle", waited);
+
+  wait->func (result, waited, wait->user_data);
+  g_free (wait);
+}
+
+
+
+static void
+cb_delay_elapsed (gboolean elapsed, SettleWait *wait)
+{
+  settle_finish (wait, elapsed ? SCREENSHOOTER_SETTLE_QUIET :
+                 SCREENSHOOTER_SETTLE_CANCELLED);
+}
+
+
+
+#ifdef HAVE_XDAMAGE
+static gboolean
+cb_quiet (SettleWait *wait)
+{
+  wait->quiet_id = 0;
+  settle_finish (wait, SCREENSHOOTER_SETTLE_QUIET);
+
+  return FALSE;
+}
+
+
+
+static gboolean
+cb_timeout (SettleWait *wait)
+{
+  wait->timeout_id = 0;
+  settle_finish (wait, SCREENSHOOTER_SETTLE_TIMEOUT);
+
+  return FALSE;
+}
+
+
+
+/* Dispatched from the main loop, even if @cancellable was cancelled from
+ * another thread */
+static gboolean
+cb_cancelled (GCancellable *cancellable, SettleWait *wait)
+{
+  settle_finish (wait, SCREENSHOOTER_SETTLE_CANCELLED);
+
+  return FALSE;
+}
+
+
+
+/* Restarts the quiet period when something is drawn in the area */
+static GdkFilterReturn
+damage_filter_func (GdkXEvent *xevent, GdkEvent *event, SettleWait *wait)
+{
+  XDamageNotifyEvent *damage_event = (XDamageNotifyEvent *) xevent;
+  GdkRectangle rectangle;
+
+  if (damage_event->type != wait->event_base + XDamageNotify ||
+      damage_event->damage != wait->damage)
+    return GDK_FILTER_CONTINUE;
+
+  rectangle.x = damage_event->area.x;
+  rectangle.y = damage_event->area.y;
+  rectangle.width = damage_event->area.width;
+  rectangle.height = damage_event->area.height;
+
+  if (wait->quiet_id != 0 &&
+      gdk_rectangle_intersect (&rectangle, &wait->area, NULL))
+    {
+      g_source_remove (wait->quiet_id);
+      wait->quiet_id =
+        g_timeout_add (wait->quiet, (GSourceFunc) cb_quiet, wait);
+    }
+
+  return GDK_FILTER_REMOVE;
+}
+
+
+
+/* Returns FALSE if the X server does not support DAMAGE */
+static gboolean
+settle_with_damage (SettleWait   *wait,
+                    gint          timeout,
+                    GCancellable *cancellable)
+{
+  Display *display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+  GdkWindow *root = gdk_get_default_root_window ();
+  gint error_base;
+
+  if (!XDamageQueryExtension (display, &wait->event_base, &error_base))
+    return FALSE;
+
+  gdk_error_trap_push ();
+  wait->damage = XDamageCreate (display, GDK_WINDOW_XID (root),
+                                XDamageReportRawRectangles);
+  gdk_flush ();
+
+  if (gdk_error_trap_pop () != 0)
+    {
+      wait->damage = None;
+      return FALSE;
+    }
+
+  gdk_window_add_filter (NULL, (GdkFilterFunc) damage_filter_func, wait);
+
+  wait->quiet_id = g_timeout_add (wait->quiet, (GSourceFunc) cb_quiet, wait);
+  wait->timeout_id = g_timeout_add (timeout, (GSourceFunc) cb_timeout, wait);
+
+  if (cancellable != NULL)
+    {
+      wait->cancel_source = g_cancellable_source_new (cancellable);
+      g_source_set_callback (wait->cancel_source,
+                             (GSourceFunc) cb_cancelled, wait, NULL);
+      g_source_attach (wait->cancel_source, NULL);
+    }
+
+  return TRUE;
+}
+#endif
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_settle_start:
+ * @area: the area of the screen to watch, or %NULL for the whole screen.
+ * @quiet: the time nothing must be drawn in @area, in milliseconds.
+ * @timeout: the longest wait, in milliseconds.
+ * @cancellable: a #GCancellable or %NULL.
+ * @func: function called at the end of the wait.
+ * @user_data: data passed to @func.
+ *
+ * Waits until nothing was drawn in @area for @quiet milliseconds, or
+ * until @timeout milliseconds elapsed, then calls @func from the default
+ * main context with the result of the wait and the time it took, in
+ * milliseconds. The main loop keeps running meanwhile. Without the
+ * DAMAGE extension, the wait lasts a fixed time within @quiet and
+ * @timeout, and ends as if the area was quiet.
+ *
+ * If @cancellable is already cancelled, @func is called before this
+ * function returns.
+ **/
+void
+screenshooter_settle_start (const GdkRectangle      *area,
+                            gint                     quiet,
+                            gint                     timeout,
+                            GCancellable            *cancellable,
+                            ScreenshooterSettleFunc  func,
+                            gpointer                 user_data)
+{
+  SettleWait *wait;
+
+  g_return_if_fail (quiet > 0);
+  g_return_if_fail (timeout >= quiet);
+  g_return_if_fail (func != NULL);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    {
+      func (SCREENSHOOTER_SETTLE_CANCELLED, 0, user_data);
+      return;
+    }
+
+  wait = g_new0 (SettleWait, 1);
+  wait->quiet = quiet;
+  wait->start = g_get_monotonic_time ();
+  wait->func = func;
+  wait->user_data = user_data;
+
+  if (area != NULL)
+    wait->area = *area;
+  else
+    {
+      wait->area.x = wait->area.y = 0;
+      wait->area.width = gdk_screen_width ();
+      wait->area.height = gdk_screen_height ();
+    }
+
+  /* Our windows are gone once the server processed our requests */
+  gdk_display_sync (gdk_display_get_default ());
+
+#ifdef HAVE_XDAMAGE
+  if (!settle_with_damage (wait, timeout, cancellable))
+#endif
+    {
+      gint fallback = CLAMP (FALLBACK_WAIT, quiet, timeout);
+
+      TRACE ("The damage cannot be followed, wait %d ms", fallback);
+
+      screenshooter_delay_start (fallback, cancellable,
+                                 (ScreenshooterDelayFunc) cb_delay_elapsed,
+                                 wait);
+    }
+}
@@ -0,0 +1,307 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Loading of the upload module.
+
+   Everything which uses libsoup and libxml2 is built as a separate module,
+   libscreenshooter-upload, so that the dynamic linker does not have to map
+   and relocate these libraries each time a screenshot is taken: most
+   captures are never uploaded. The module is opened with GModule the first
+   time an upload is requested, and stays loaded afterwards.
+
+   The settings of the uploads given before that are kept here, and passed
+   to the module once it is loaded. The queue of the failed uploads only
+   loads the module if it holds entries.
+
+   The module is looked for in the folder given by the
+   SCREENSHOOTER_MODULE_DIR environment variable, to run an uninstalled
+   build, and else in the folder it is installed to.
+*/
+
+#include "screenshooter-upload-module.h"
+#include "screenshooter-utils.h"
+
+#include <gmodule.h>
+#include <libxfce4util/libxfce4util.h>
+
+#define UPLOAD_MODULE_NAME "screenshooter-upload"
+
+
+
+static const ScreenshooterUploadModule *upload_module = NULL;
+static gboolean                         load_failed = FALSE;
+
+/* Settings passed to the module when it is loaded, -1 if they were not
+ * set */
+static gint                             max_conns = -1;
+static gint                             max_conns_per_host = -1;
+static gint                             bandwidth_limit = -1;
+static gboolean                         print_timings = FALSE;
+static gboolean                         cache_enabled = TRUE;
+static gboolean                         queue_started = FALSE;
+
+
+
+static const ScreenshooterUploadModule *upload_module_load           (GError **error);
+static gboolean                         upload_module_queue_is_empty (void);
+
+
+
+/* Internals */
+
+
+
+static const ScreenshooterUploadModule
+*upload_module_load (GError **error)
+{
+  const ScreenshooterUploadModule *result = NULL;
+  ScreenshooterUploadModuleInit init;
+  const gchar *dir = g_getenv ("SCREENSHOOTER_MODULE_DIR");
+  GModule *module;
+  gchar *path;
+
+  if (dir == NULL || *dir == '\0')
+    dir = SCREENSHOOTER_MODULE_DIR;
+
+  path = g_module_build_path (dir, UPLOAD_MODULE_NAME);
+
+  TRACE ("Load the upload module from %s", path);
+
+  module = g_module_open (path, G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
+
+  if (module == NULL)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "%s",
+                   g_module_error ());
+      g_free (path);
+      return NULL;
+    }
+
+  if (g_module_symbol (module, SCREENSHOOTER_UPLOAD_MODULE_INIT,
+                       (gpointer *) &init))
+    result = init ();
+
+  if (result == NULL || result->version != SCREENSHOOTER_UPLOAD_MODULE_VERSION)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   _("%s is not a compatible upload module."), path);
+      g_module_close (module);
+      g_free (path);
+      return NULL;
+    }
+
+  /* The module registers types, it cannot be unloaded */
+  g_module_make_resident (module);
+  g_free (path);
+
+  return result;
+}
+
+
+
+static gboolean
+upload_module_queue_is_empty (void)
+{
+  gchar *path = xfce_resource_lookup (XFCE_RESOURCE_CACHE, SCREENSHOOTER_QUEUE_DIR);
+  const gchar *name;
+  gboolean empty = TRUE;
+  GDir *dir;
+
+  if (path == NULL)
+    return TRUE;
+
+  dir = g_dir_open (path, 0, NULL);
+  g_free (path);
+
+  if (dir == NULL)
+    return TRUE;
+
+  while (empty && (name = g_dir_read_name (dir)) != NULL)
+    if (g_str_has_suffix (name, SCREENSHOOTER_QUEUE_ENTRY_SUFFIX))
+      empty = FALSE;
+
+  g_dir_close (dir);
+
+  return empty;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_upload_module_get:
+ *
+ * Loads the upload module if this was not done yet, and passes it the
+ * settings given until then. An error dialog is shown if the module cannot
+ * be loaded, the first time only.
+ *
+ * Return value: the functions of the module, or %NULL if it could not be
+ * loaded.
+ **/
+const ScreenshooterUploadModule
+*screenshooter_upload_module_get (void)
+{
+  GError *error = NULL;
+  gchar *message;
+
+  if (upload_module != NULL || load_failed)
+    return upload_module;
+
+  upload_module = upload_module_load (&error);
+
+  if (upload_module == NULL)
+    {
+      load_failed = TRUE;
+
+      message = g_markup_escape_text (error->message, -1);
+      screenshooter_error ("%s\n%s", _("The upload module could not be loaded."),
+                           message);
+      g_free (message);
+      g_error_free (error);
+
+      return NULL;
+    }
+
+  if (max_conns >= 0)
+    upload_module->session_configure (max_conns, max_conns_per_host);
+
+  if (bandwidth_limit >= 0)
+    upload_module->session_set_bandwidth_limit (bandwidth_limit);
+
+  upload_module->session_set_print_timings (print_timings);
+  upload_module->cache_set_enabled (cache_enabled);
+
+  if (queue_started)
+    upload_module->queue_start ();
+
+  return upload_module;
+}
+
+
+
+/**
+ * screenshooter_upload_module_configure:
+ * @max: the maximum number of connections of the uploads.
+ * @max_per_host: the maximum number of connections to a host.
+ *
+ * See screenshooter_upload_session_configure(). The values are kept until
+ * the module is loaded.
+ **/
+void
+screenshooter_upload_module_configure (gint max, gint max_per_host)
+{
+  max_conns = max;
+  max_conns_per_host = max_per_host;
+
+  if (upload_module != NULL)
+    upload_module->session_configure (max_conns, max_conns_per_host);
+}
+
+
+
+/**
+ * screenshooter_upload_module_set_bandwidth_limit:
+ * @limit: the limit in KiB/s, 0 for none.
+ *
+ * See screenshooter_upload_session_set_bandwidth_limit(). The value is kept
+ * until the module is loaded.
+ **/
+void
+screenshooter_upload_module_set_bandwidth_limit (gint limit)
+{
+  bandwidth_limit = limit;
+
+  if (upload_module != NULL)
+    upload_module->session_set_bandwidth_limit (bandwidth_limit);
+}
+
+
+
+/**
+ * screenshooter_upload_module_set_print_timings:
+ * @print: whether the timings of the uploads are printed.
+ *
+ * See screenshooter_upload_session_set_print_timings(). The value is kept
+ * until the module is loaded.
+ **/
+void
+screenshooter_upload_module_set_print_timings (gboolean print)
+{
+  print_timings = print;
+
+  if (upload_module != NULL)
+    upload_module->session_set_print_timings (print_timings);
+}
+
+
+
+/**
+ * screenshooter_upload_module_set_cache_enabled:
+ * @enabled: whether the links of the uploaded files are reused.
+ *
+ * See screenshooter_upload_cache_set_enabled(). The value is kept until the
+ * module is loaded.
+ **/
+void
+screenshooter_upload_module_set_cache_enabled (gboolean enabled)
+{
+  cache_enabled = enabled;
+
+  if (upload_module != NULL)
+    upload_module->cache_set_enabled (cache_enabled);
+}
+
+
+
+/**
+ * screenshooter_upload_module_start_queue:
+ *
+ * Retries the failed uploads while the program runs. The module is only
+ * loaded now if the queue holds entries, else the queue is started when
+ * the module gets loaded for an upload, which is the only way for entries
+ * to be added.
+ **/
+void
+screenshooter_upload_module_start_queue (void)
+{
+  queue_started = TRUE;
+
+  if (upload_module != NULL)
+    upload_module->queue_start ();
+  else if (!upload_module_queue_is_empty ())
+    screenshooter_upload_module_get ();
+}
+
+
+
+/**
+ * screenshooter_upload_module_shutdown:
+ *
+ * Waits for the uploads of the queue and closes the connections, if the
+ * module was loaded.
+ **/
+void
+screenshooter_upload_module_shutdown (void)
+{
+  if (upload_module != NULL)
+    upload_module->shutdown ();
+}
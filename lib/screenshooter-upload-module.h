@@ -0,0 +1,108 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_UPLOAD_MODULE_H__
+#define __HAVE_UPLOAD_MODULE_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "screenshooter-global.h"
+
+/* Bumped each time ScreenshooterUploadModule changes */
+#define SCREENSHOOTER_UPLOAD_MODULE_VERSION 1
+
+/* Symbol of the module returning its ScreenshooterUploadModule */
+#define SCREENSHOOTER_UPLOAD_MODULE_INIT "screenshooter_upload_module_init"
+
+/* Where the failed uploads wait, in the cache directory */
+#define SCREENSHOOTER_QUEUE_DIR          "xfce4/screenshooter/queue/"
+#define SCREENSHOOTER_QUEUE_ENTRY_SUFFIX ".entry"
+
+typedef struct
+{
+  gchar  *id;
+  gchar  *backend;
+  gchar  *image_path;
+  gchar  *title;
+  gchar  *last_error;
+  gint    attempts;
+  gint64  added;
+  gint64  next_attempt;
+}
+ScreenshooterQueueEntry;
+
+/* Functions of the upload module, which holds everything using libsoup
+ * and libxml2 */
+typedef struct
+{
+  gint       version;
+
+  void      (*session_configure)           (gint                        max_conns,
+                                            gint                        max_conns_per_host);
+  void      (*session_set_bandwidth_limit) (gint                        limit);
+  void      (*session_set_print_timings)   (gboolean                    print_timings);
+  void      (*cache_set_enabled)           (gboolean                    enabled);
+  void      (*warm_up)                     (ScreenshotData             *sd);
+  void      (*shutdown)                    (void);
+
+  void      (*upload_to_zimagez)           (const gchar                *image_path,
+                                            const gchar                *last_user,
+                                            const gchar                *title,
+                                            gchar                     **new_last_user);
+  void      (*upload_to_imgur)             (const gchar                *image_path,
+                                            const gchar                *title);
+  void      (*upload_to_imgur_copy_link)   (const gchar                *image_path,
+                                            const gchar                *title);
+  void      (*upload_to_imgur_album)       (gchar                     **image_paths,
+                                            const gchar                *title);
+  void      (*upload_to_custom)            (const gchar                *image_path,
+                                            const gchar                *title,
+                                            ScreenshooterCustomUpload  *custom);
+  void      (*upload_to_s3)                (const gchar                *image_path,
+                                            ScreenshooterS3            *s3);
+
+  gchar   **(*batch_expand_files)          (gchar                     **files);
+  gint      (*batch_upload)                (gchar                     **files,
+                                            ScreenshotData             *sd,
+                                            gint                        jobs);
+
+  void      (*queue_start)                 (void);
+  GList    *(*queue_list)                  (void);
+  void      (*queue_entry_free)            (ScreenshooterQueueEntry    *entry);
+  gboolean  (*queue_cancel)                (const gchar                *id);
+  gint      (*queue_flush)                 (void);
+}
+ScreenshooterUploadModule;
+
+typedef const ScreenshooterUploadModule *(*ScreenshooterUploadModuleInit) (void);
+
+const ScreenshooterUploadModule *screenshooter_upload_module_get                 (void);
+void                             screenshooter_upload_module_configure           (gint     max,
+                                                                                  gint     max_per_host);
+void                             screenshooter_upload_module_set_bandwidth_limit (gint     limit);
+void                             screenshooter_upload_module_set_print_timings   (gboolean print);
+void                             screenshooter_upload_module_set_cache_enabled   (gboolean enabled);
+void                             screenshooter_upload_module_start_queue         (void);
+void                             screenshooter_upload_module_shutdown            (void);
+
+#endif
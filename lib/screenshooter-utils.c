@@ -18,6 +18,8 @@
  */
 
 #include "screenshooter-utils.h"
+#include "screenshooter-custom-upload.h"
+#include "screenshooter-s3.h"
 #include <libxfce4ui/libxfce4ui.h>
 
 #include <gdk/gdk.h>
@@ -82,10 +84,16 @@ screenshooter_read_rc_file (const gchar *file, ScreenshotData *sd)
   gint action = SAVE;
   gint show_mouse = 1;
   gboolean timestamp = TRUE;
+  gboolean freeze_selection = FALSE;
+  gint upload_max_conns = 0;
+  gint upload_max_conns_per_host = 0;
+  gint upload_bandwidth_limit = 0;
   gchar *screenshot_dir = g_strdup (default_uri);
   gchar *title = g_strdup (_("Screenshot"));
   gchar *app = g_strdup ("none");
   gchar *last_user = g_strdup ("");
+  ScreenshooterCustomUpload *custom_upload = NULL;
+  ScreenshooterS3 *s3 = NULL;
 
   if (G_LIKELY (file != NULL))
     {
@@ -97,11 +105,21 @@ screenshooter_read_rc_file (const gchar *file, ScreenshotData *sd)
         {
           TRACE ("Read the entries");
 
-          delay = xfce_rc_read_int_entry (rc, "delay", 0);
+          /* The delay used to be saved in seconds */
+          delay = xfce_rc_read_int_entry (rc, "delay", 0) * 1000;
+          delay = xfce_rc_read_int_entry (rc, "delay_ms", delay);
           region = xfce_rc_read_int_entry (rc, "region", FULLSCREEN);
           action = xfce_rc_read_int_entry (rc, "action", SAVE);
           show_mouse = xfce_rc_read_int_entry (rc, "show_mouse", 1);
           timestamp = xfce_rc_read_bool_entry (rc, "timestamp", TRUE);
+          freeze_selection =
+            xfce_rc_read_bool_entry (rc, "freeze_selection", FALSE);
+          upload_max_conns =
+            xfce_rc_read_int_entry (rc, "upload_max_conns", 0);
+          upload_max_conns_per_host =
+            xfce_rc_read_int_entry (rc, "upload_max_conns_per_host", 0);
+          upload_bandwidth_limit =
+            xfce_rc_read_int_entry (rc, "upload_bandwidth_limit", 0);
 
           g_free (app);
           app = g_strdup (xfce_rc_read_entry (rc, "app", "none"));
@@ -117,6 +135,9 @@ screenshooter_read_rc_file (const gchar *file, ScreenshotData *sd)
           title =
             g_strdup (xfce_rc_read_entry (rc, "title", _("Screenshot")));
 
+          custom_upload = screenshooter_custom_upload_new_from_rc (rc);
+          s3 = screenshooter_s3_new_from_rc (rc);
+
           TRACE ("Close the rc file");
 
           xfce_rc_close (rc);
@@ -131,10 +152,25 @@ screenshooter_read_rc_file (const gchar *file, ScreenshotData *sd)
   sd->action = action;
   sd->show_mouse = show_mouse;
   sd->timestamp = timestamp;
+  sd->freeze_selection = freeze_selection;
   sd->screenshot_dir = screenshot_dir;
   sd->title = title;
   sd->app = app;
   sd->last_user = last_user;
+  sd->upload_max_conns = upload_max_conns;
+  sd->upload_max_conns_per_host = upload_max_conns_per_host;
+  sd->upload_bandwidth_limit = upload_bandwidth_limit;
+
+  screenshooter_custom_upload_free (sd->custom_upload);
+  sd->custom_upload = custom_upload;
+
+  screenshooter_s3_free (sd->s3);
+  sd->s3 = s3;
+
+  /* The custom upload service or the bucket was removed from the rc file */
+  if ((sd->action == UPLOAD_CUSTOM && sd->custom_upload == NULL) ||
+      (sd->action == UPLOAD_S3 && sd->s3 == NULL))
+    sd->action = SAVE;
 }
 
 
@@ -158,13 +194,19 @@ screenshooter_write_rc_file (const gchar *file, ScreenshotData *sd)
 
   TRACE ("Write the entries.");
 
-  xfce_rc_write_int_entry (rc, "delay", sd->delay);
+  xfce_rc_write_int_entry (rc, "delay", sd->delay / 1000);
+  xfce_rc_write_int_entry (rc, "delay_ms", sd->delay);
   xfce_rc_write_int_entry (rc, "region", sd->region);
   xfce_rc_write_int_entry (rc, "action", sd->action);
   xfce_rc_write_int_entry (rc, "show_mouse", sd->show_mouse);
   xfce_rc_write_entry (rc, "screenshot_dir", sd->screenshot_dir);
   xfce_rc_write_entry (rc, "app", sd->app);
   xfce_rc_write_entry (rc, "last_user", sd->last_user);
+  xfce_rc_write_int_entry (rc, "upload_max_conns", sd->upload_max_conns);
+  xfce_rc_write_int_entry (rc, "upload_max_conns_per_host",
+                           sd->upload_max_conns_per_host);
+  xfce_rc_write_int_entry (rc, "upload_bandwidth_limit",
+                           sd->upload_bandwidth_limit);
 
   TRACE ("Flush and close the rc file");
   xfce_rc_close (rc);
@@ -323,6 +365,90 @@ gchar *screenshooter_get_datetime (const gchar *format)
 
 
 
+/**
+ * screenshooter_generate_filename_for_uri:
+ * @uri: uri of the folder for which the filename should be generated.
+ * @title: the main title of the file name.
+ * @timestamp: whether the date and the hour should be appended to the file name.
+ *
+ * If @timestamp is true, generates a file name @title - date - hour - n.png,
+ * where n is the lowest integer such as this file does not exist in the @uri
+ * folder.
+ * Else, generates a file name @title-n.png, where n is the lowest integer
+ * such as this file does not exist in the @uri folder.
+ *
+ * Return value: the filename or NULL if @uri == NULL.
+ **/
+gchar *screenshooter_generate_filename_for_uri (const gchar *uri,
+                                                const gchar *title,
+                                                gboolean     timestamp)
+{
+  gboolean exists = TRUE;
+  GFile *directory;
+  GFile *file;
+  gchar *base_name;
+  gchar *datetime;
+  const gchar *strftime_format = "%Y-%m-%d_%H-%M-%S";
+
+  gint i;
+
+  if (G_UNLIKELY (uri == NULL))
+    {
+      TRACE ("URI was NULL");
+
+      return NULL;
+    }
+
+  TRACE ("Get the folder corresponding to the URI");
+  datetime = screenshooter_get_datetime (strftime_format);
+  directory = g_file_new_for_uri (uri);
+  if (!timestamp)
+    base_name = g_strconcat (title, ".png", NULL);
+  else
+    base_name = g_strconcat (title, "_", datetime, ".png", NULL);
+
+  file = g_file_get_child (directory, base_name);
+
+  if (!g_file_query_exists (file, NULL))
+    {
+      g_object_unref (file);
+      g_object_unref (directory);
+
+      return base_name;
+    }
+
+  g_object_unref (file);
+  g_free (base_name);
+
+  for (i = 1; exists; ++i)
+    {
+      const gchar *extension =
+        g_strdup_printf ("-%d.png", i);
+
+      if (!timestamp)
+         base_name = g_strconcat (title, extension, NULL);
+       else
+         base_name = g_strconcat (title, "_", datetime, extension, NULL);
+
+      file = g_file_get_child (directory, base_name);
+
+      if (!g_file_query_exists (file, NULL))
+        exists = FALSE;
+
+      if (exists)
+        g_free (base_name);
+
+      g_object_unref (file);
+    }
+
+  g_free(datetime);
+  g_object_unref (directory);
+
+  return base_name;
+}
+
+
+
 void screenshooter_open_help (GtkWindow *parent)
 {
   xfce_dialog_show_help (parent, "screenshooter", "start", "");
@@ -51,6 +51,9 @@ gchar    *rot13                               (gchar          *string);
 void      screenshooter_error                 (const gchar    *format,
                                                ...);
 gchar    *screenshooter_get_datetime          (const gchar    *format);
+gchar    *screenshooter_generate_filename_for_uri (const gchar  *uri,
+                                                   const gchar  *title,
+                                                   gboolean      timestamp);
 void      screenshooter_open_help             (GtkWindow      *parent);
 gboolean  screenshooter_f1_key                (GtkWidget      *widget,
                                                GdkEventKey    *event,
@@ -0,0 +1,465 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+
+/* Index of the windows shown on the screen, for the hover-snap of the
+   region selection.
+
+   While a region is selected, the window under the pointer is
+   highlighted and a click selects its frame. Asking the X server which
+   window is under the pointer on every motion event would cost a round
+   trip each time, so the top-level windows are listed once, with
+   XQueryTree and their attributes, and kept in stacking order.
+
+   The screen is cut in square cells and each cell lists the windows which
+   overlap it, from the top of the stack. A lookup only tests the
+   windows of the cell under the pointer. The cells are rebuilt lazily
+   after a change.
+
+   When the index follows the changes, the root window reports the
+   creation, destruction, mapping and configuration of its children.
+   ConfigureNotify gives the new geometry and the sibling the window is
+   now above, so the stacking order is kept without a round trip.
+   Override-redirect windows, like menus and our own selection window,
+   are not indexed.
+*/
+
+#include "screenshooter-window-index.h"
+
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Size of the cells, in pixels */
+#define CELL_SIZE 64
+
+
+
+typedef struct
+{
+  Window       xid;
+  GdkRectangle frame;
+  gboolean     viewable;
+  gboolean     override_redirect;
+}
+IndexedWindow;
+
+struct _ScreenshooterWindowIndex
+{
+  GdkWindow    *root;
+  GdkEventMask  root_events;
+  gboolean      follow;
+
+  /* From the bottom to the top of the stack */
+  GArray       *windows;
+
+  /* Indexes in windows, from the top of the stack, or NULL if the cells
+   * must be rebuilt */
+  GArray      **cells;
+  gint          n_columns;
+  gint          n_rows;
+};
+
+
+
+static gint            find_window        (ScreenshooterWindowIndex *index,
+                                           Window                    xid);
+static void            add_window         (ScreenshooterWindowIndex *index,
+                                           Window                    xid,
+                                           gint                      x,
+                                           gint                      y,
+                                           gint                      width,
+                                           gint                      height,
+                                           gint                      border,
+                                           gboolean                  viewable,
+                                           gboolean                  override_redirect);
+static void            restack_window     (ScreenshooterWindowIndex *index,
+                                           gint                      position,
+                                           Window                    above);
+static void            free_cells         (ScreenshooterWindowIndex *index);
+static void            build_cells        (ScreenshooterWindowIndex *index);
+static GdkFilterReturn index_filter_func  (GdkXEvent                *xevent,
+                                           GdkEvent                 *event,
+                                           ScreenshooterWindowIndex *index);
+
+
+
+/* Internals */
+
+
+
+/* Returns the position of xid in the stack, or -1 */
+static gint
+find_window (ScreenshooterWindowIndex *index, Window xid)
+{
+  guint i;
+
+  for (i = 0; i < index->windows->len; i++)
+    if (g_array_index (index->windows, IndexedWindow, i).xid == xid)
+      return i;
+
+  return -1;
+}
+
+
+
+/* Adds a window on the top of the stack */
+static void
+add_window (ScreenshooterWindowIndex *index,
+            Window                    xid,
+            gint                      x,
+            gint                      y,
+            gint                      width,
+            gint                      height,
+            gint                      border,
+            gboolean                  viewable,
+            gboolean                  override_redirect)
+{
+  IndexedWindow window;
+
+  window.xid = xid;
+  window.frame.x = x;
+  window.frame.y = y;
+  window.frame.width = width + 2 * border;
+  window.frame.height = height + 2 * border;
+  window.viewable = viewable;
+  window.override_redirect = override_redirect;
+
+  g_array_append_val (index->windows, window);
+}
+
+
+
+/* Moves the window at position right above the sibling above, or to the
+ * bottom of the stack if above is None */
+static void
+restack_window (ScreenshooterWindowIndex *index, gint position, Window above)
+{
+  IndexedWindow window = g_array_index (index->windows, IndexedWindow, position);
+  gint sibling;
+
+  g_array_remove_index (index->windows, position);
+
+  sibling = above != None ? find_window (index, above) : -1;
+  g_array_insert_val (index->windows, sibling + 1, window);
+}
+
+
+
+static void
+free_cells (ScreenshooterWindowIndex *index)
+{
+  gint i;
+
+  if (index->cells == NULL)
+    return;
+
+  for (i = 0; i < index->n_columns * index->n_rows; i++)
+    if (index->cells[i] != NULL)
+      g_array_free (index->cells[i], TRUE);
+
+  g_free (index->cells);
+  index->cells = NULL;
+}
+
+
+
+static void
+build_cells (ScreenshooterWindowIndex *index)
+{
+  GdkRectangle screen, visible;
+  gint i, column, row;
+
+  screen.x = screen.y = 0;
+  screen.width = gdk_screen_width ();
+  screen.height = gdk_screen_height ();
+
+  index->n_columns = (screen.width + CELL_SIZE - 1) / CELL_SIZE;
+  index->n_rows = (screen.height + CELL_SIZE - 1) / CELL_SIZE;
+  index->cells = g_new0 (GArray *, index->n_columns * index->n_rows);
+
+  /* From the top of the stack, so that the first window of a cell which
+   * contains a point is the one shown there */
+  for (i = (gint) index->windows->len - 1; i >= 0; i--)
+    {
+      IndexedWindow *window = &g_array_index (index->windows, IndexedWindow, i);
+
+      if (!window->viewable || window->override_redirect ||
+          !gdk_rectangle_intersect (&window->frame, &screen, &visible))
+        continue;
+
+      for (row = visible.y / CELL_SIZE;
+           row <= (visible.y + visible.height - 1) / CELL_SIZE; row++)
+        for (column = visible.x / CELL_SIZE;
+             column <= (visible.x + visible.width - 1) / CELL_SIZE; column++)
+          {
+            GArray **cell = &index->cells[row * index->n_columns + column];
+
+            if (*cell == NULL)
+              *cell = g_array_new (FALSE, FALSE, sizeof (gint));
+
+            g_array_append_val (*cell, i);
+          }
+    }
+
+  TRACE ("Indexed %u windows in %dx%d cells", index->windows->len,
+         index->n_columns, index->n_rows);
+}
+
+
+
+static GdkFilterReturn
+index_filter_func (GdkXEvent                *xevent,
+                   GdkEvent                 *event,
+                   ScreenshooterWindowIndex *index)
+{
+  XEvent *x_event = (XEvent *) xevent;
+  Window root = GDK_WINDOW_XID (index->root);
+  gint position;
+
+  switch (x_event->type)
+    {
+      case CreateNotify:
+        if (x_event->xcreatewindow.parent == root)
+          add_window (index, x_event->xcreatewindow.window,
+                      x_event->xcreatewindow.x, x_event->xcreatewindow.y,
+                      x_event->xcreatewindow.width,
+                      x_event->xcreatewindow.height,
+                      x_event->xcreatewindow.border_width, FALSE,
+                      x_event->xcreatewindow.override_redirect);
+        break;
+
+      case DestroyNotify:
+        position = find_window (index, x_event->xdestroywindow.window);
+
+        if (position >= 0)
+          g_array_remove_index (index->windows, position);
+        break;
+
+      case ReparentNotify:
+        /* Reparenting window managers move the new windows into frames */
+        position = find_window (index, x_event->xreparent.window);
+
+        if (position >= 0 && x_event->xreparent.parent != root)
+          g_array_remove_index (index->windows, position);
+        else if (position < 0 && x_event->xreparent.parent == root)
+          add_window (index, x_event->xreparent.window,
+                      x_event->xreparent.x, x_event->xreparent.y,
+                      0, 0, 0, FALSE, x_event->xreparent.override_redirect);
+        break;
+
+      case MapNotify:
+      case UnmapNotify:
+        position = find_window (index, x_event->type == MapNotify ?
+                                x_event->xmap.window : x_event->xunmap.window);
+
+        if (position >= 0)
+          {
+            IndexedWindow *window =
+              &g_array_index (index->windows, IndexedWindow, position);
+
+            window->viewable = x_event->type == MapNotify;
+
+            /* Our selection window becomes override-redirect after its
+             * creation */
+            if (x_event->type == MapNotify)
+              window->override_redirect = x_event->xmap.override_redirect;
+          }
+        break;
+
+      case ConfigureNotify:
+        position = find_window (index, x_event->xconfigure.window);
+
+        if (position >= 0)
+          {
+            IndexedWindow *window =
+              &g_array_index (index->windows, IndexedWindow, position);
+
+            window->frame.x = x_event->xconfigure.x;
+            window->frame.y = x_event->xconfigure.y;
+            window->frame.width = x_event->xconfigure.width +
+              2 * x_event->xconfigure.border_width;
+            window->frame.height = x_event->xconfigure.height +
+              2 * x_event->xconfigure.border_width;
+            window->override_redirect = x_event->xconfigure.override_redirect;
+
+            restack_window (index, position, x_event->xconfigure.above);
+          }
+        break;
+
+      default:
+        return GDK_FILTER_CONTINUE;
+    }
+
+  free_cells (index);
+
+  return GDK_FILTER_CONTINUE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_window_index_new:
+ * @follow: whether the index follows the changes of the windows.
+ *
+ * Lists the top-level windows of the default screen in stacking order.
+ * The windows are usually the frames of the window manager. If @follow is
+ * %FALSE, the index describes the screen as it was when it was created,
+ * like a frozen image of the screen.
+ *
+ * Return value: a new #ScreenshooterWindowIndex, to be freed with
+ * screenshooter_window_index_free().
+ **/
+ScreenshooterWindowIndex *
+screenshooter_window_index_new (gboolean follow)
+{
+  ScreenshooterWindowIndex *index = g_new0 (ScreenshooterWindowIndex, 1);
+  Display *display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+  Window root, parent, *children = NULL;
+  guint n_children = 0, i;
+
+  index->root = gdk_get_default_root_window ();
+  index->follow = follow;
+  index->windows = g_array_new (FALSE, FALSE, sizeof (IndexedWindow));
+
+  /* Follow the changes from now on, so that none is missed while the
+   * windows are listed */
+  if (follow)
+    {
+      index->root_events = gdk_window_get_events (index->root);
+      gdk_window_set_events (index->root,
+                             index->root_events | GDK_SUBSTRUCTURE_MASK);
+      gdk_window_add_filter (index->root,
+                             (GdkFilterFunc) index_filter_func, index);
+    }
+
+  gdk_error_trap_push ();
+
+  /* The children are listed from the bottom of the stack */
+  if (XQueryTree (display, GDK_WINDOW_XID (index->root), &root, &parent,
+                  &children, &n_children))
+    {
+      for (i = 0; i < n_children; i++)
+        {
+          XWindowAttributes attributes;
+
+          /* The window may be destroyed meanwhile */
+          if (!XGetWindowAttributes (display, children[i], &attributes))
+            continue;
+
+          add_window (index, children[i], attributes.x, attributes.y,
+                      attributes.width, attributes.height,
+                      attributes.border_width,
+                      attributes.map_state == IsViewable,
+                      attributes.override_redirect);
+        }
+
+      XFree (children);
+    }
+
+  gdk_error_trap_pop ();
+
+  return index;
+}
+
+
+
+/**
+ * screenshooter_window_index_lookup:
+ * @index: a #ScreenshooterWindowIndex.
+ * @x: the horizontal position on the screen.
+ * @y: the vertical position on the screen.
+ * @frame: return location for the frame of the window.
+ *
+ * Finds the window shown at @x, @y, without talking to the X server.
+ *
+ * Return value: %FALSE if no window is shown there.
+ **/
+gboolean
+screenshooter_window_index_lookup (ScreenshooterWindowIndex *index,
+                                   gint                      x,
+                                   gint                      y,
+                                   GdkRectangle             *frame)
+{
+  GArray *cell;
+  gint column, row;
+  guint i;
+
+  g_return_val_if_fail (index != NULL, FALSE);
+  g_return_val_if_fail (frame != NULL, FALSE);
+
+  if (index->cells == NULL)
+    build_cells (index);
+
+  if (x < 0 || y < 0)
+    return FALSE;
+
+  column = x / CELL_SIZE;
+  row = y / CELL_SIZE;
+
+  if (column >= index->n_columns || row >= index->n_rows)
+    return FALSE;
+
+  cell = index->cells[row * index->n_columns + column];
+
+  for (i = 0; cell != NULL && i < cell->len; i++)
+    {
+      IndexedWindow *window =
+        &g_array_index (index->windows, IndexedWindow,
+                        g_array_index (cell, gint, i));
+
+      if (x >= window->frame.x && x < window->frame.x + window->frame.width &&
+          y >= window->frame.y && y < window->frame.y + window->frame.height)
+        {
+          *frame = window->frame;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+
+
+/**
+ * screenshooter_window_index_free:
+ * @index: a #ScreenshooterWindowIndex.
+ *
+ * Stops following the windows and frees @index.
+ **/
+void
+screenshooter_window_index_free (ScreenshooterWindowIndex *index)
+{
+  g_return_if_fail (index != NULL);
+
+  if (index->follow)
+    {
+      gdk_window_remove_filter (index->root,
+                                (GdkFilterFunc) index_filter_func, index);
+      gdk_window_set_events (index->root, index->root_events);
+    }
+
+  free_cells (index);
+  g_array_free (index->windows, TRUE);
+  g_free (index);
+}
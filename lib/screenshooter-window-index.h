@@ -0,0 +1,38 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_WINDOW_INDEX_H__
+#define __HAVE_WINDOW_INDEX_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtk/gtk.h>
+
+typedef struct _ScreenshooterWindowIndex ScreenshooterWindowIndex;
+
+ScreenshooterWindowIndex *screenshooter_window_index_new    (gboolean                  follow);
+gboolean                  screenshooter_window_index_lookup (ScreenshooterWindowIndex *index,
+                                                             gint                      x,
+                                                             gint                      y,
+                                                             GdkRectangle             *frame);
+void                      screenshooter_window_index_free   (ScreenshooterWindowIndex *index);
+
+#endif
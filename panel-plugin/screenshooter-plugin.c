@@ -33,6 +33,7 @@ t */
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <X11/Xatom.h>
 
 #include "libscreenshooter.h"
@@ -49,11 +50,27 @@ typedef struct
 
   int style_id;
   ScreenshotData *sd;
+
+  /* The captures running in other processes */
+  GSList *captures;
 }
 PluginData;
 
 
 
+/* A capture taken by a xfce4-screenshooter process */
+typedef struct
+{
+  PluginData *pd;
+  guint watch_id;
+
+  /* Copy of the rc file of the plugin, read and saved by the process */
+  gchar *rc_file;
+}
+PluginCapture;
+
+
+
 /* Protoypes */
 
 static void
@@ -85,6 +102,14 @@ static void
 cb_free_data                         (XfcePanelPlugin      *plugin,
                                       PluginData           *pd);
 
+static void
+cb_capture_exited                    (GPid                  pid,
+                                      gint                  status,
+                                      PluginCapture        *capture);
+
+static gboolean
+screenshooter_plugin_spawn_capture   (PluginData           *pd);
+
 static void
 cb_button_clicked                    (GtkWidget            *button,
                                       PluginData           *pd);
@@ -151,20 +176,198 @@ pd: the associated PluginData.
 static void
 cb_free_data (XfcePanelPlugin *plugin, PluginData *pd)
 {
+  GSList *l;
+
   if (pd->style_id)
     g_signal_handler_disconnect (plugin, pd->style_id);
 
   pd->style_id = 0;
+
+  /* The running captures finish on their own. Their copy of the rc file
+   * holds the upload settings, it is removed and they do not save it
+   * again */
+  for (l = pd->captures; l != NULL; l = l->next)
+    {
+      PluginCapture *capture = l->data;
+
+      g_source_remove (capture->watch_id);
+      g_unlink (capture->rc_file);
+      g_free (capture->rc_file);
+      g_free (capture);
+    }
+
+  g_slist_free (pd->captures);
+
   g_free (pd->sd->screenshot_dir);
   g_free (pd->sd->title);
   g_free (pd->sd->app);
   g_free (pd->sd->last_user);
+  screenshooter_custom_upload_free (pd->sd->custom_upload);
+  screenshooter_s3_free (pd->sd->s3);
   g_free (pd->sd);
   g_free (pd);
 }
 
 
 
+/* Called when a capture process exits.
+pid: the process.
+status: its exit status.
+capture: the PluginCapture of the process.
+*/
+static void
+cb_capture_exited (GPid pid, gint status, PluginCapture *capture)
+{
+  PluginData *pd = capture->pd;
+  XfceRc *rc;
+
+  TRACE ("The capture process exited with status %d", status);
+
+  g_spawn_close_pid (pid);
+  pd->captures = g_slist_remove (pd->captures, capture);
+
+  /* Pick up the action chosen in the process so that it is preselected
+   * for the next capture. The other options may have been changed in the
+   * plugin meanwhile. */
+  rc = xfce_rc_simple_open (capture->rc_file, TRUE);
+
+  if (rc != NULL)
+    {
+      gint action = xfce_rc_read_int_entry (rc, "action", pd->sd->action);
+
+      if ((action != UPLOAD_CUSTOM || pd->sd->custom_upload != NULL) &&
+          (action != UPLOAD_S3 || pd->sd->s3 != NULL))
+        {
+          pd->sd->action = action;
+          g_free (pd->sd->app);
+          pd->sd->app = g_strdup (xfce_rc_read_entry (rc, "app", "none"));
+        }
+
+      xfce_rc_close (rc);
+    }
+
+  g_unlink (capture->rc_file);
+  g_free (capture->rc_file);
+  g_free (capture);
+
+  /* Only the plugin writes its rc file, the processes have their copy */
+  screenshooter_plugin_write_rc_file (pd->plugin, pd);
+}
+
+
+
+/* Start a xfce4-screenshooter process taking the screenshot with the
+options of the plugin.
+pd: the PluginData storing the options for taking the screenshot.
+Returns TRUE if the process was started.
+*/
+static gboolean
+screenshooter_plugin_spawn_capture (PluginData *pd)
+{
+  PluginCapture *capture;
+  GError *error = NULL;
+  const gchar *argv[6];
+  gchar *rc_file, *capture_rc_file, *contents, *rc_arg, *delay_arg;
+  gint argc = 0, fd;
+  gsize length;
+  GPid pid;
+  gboolean spawned;
+
+  /* The process reads the options from a copy of the rc file of the
+   * plugin and saves the action chosen in its dialog there, the captures
+   * running at the same time do not write the same file */
+  screenshooter_plugin_write_rc_file (pd->plugin, pd);
+  rc_file = xfce_panel_plugin_save_location (pd->plugin, TRUE);
+
+  if (G_UNLIKELY (rc_file == NULL))
+    return FALSE;
+
+  if (!g_file_get_contents (rc_file, &contents, &length, &error))
+    {
+      g_warning ("Could not read %s: %s", rc_file, error->message);
+      g_error_free (error);
+      g_free (rc_file);
+
+      return FALSE;
+    }
+
+  g_free (rc_file);
+  fd = g_file_open_tmp ("xfce4-screenshooter-XXXXXX.rc", &capture_rc_file,
+                        &error);
+
+  if (fd >= 0)
+    {
+      close (fd);
+
+      if (!g_file_set_contents (capture_rc_file, contents, length, &error))
+        {
+          g_unlink (capture_rc_file);
+          g_free (capture_rc_file);
+          fd = -1;
+        }
+    }
+
+  g_free (contents);
+
+  if (fd < 0)
+    {
+      g_warning ("Could not copy the rc file: %s", error->message);
+      g_error_free (error);
+
+      return FALSE;
+    }
+
+  rc_arg = g_strconcat ("--rc-file=", capture_rc_file, NULL);
+  delay_arg = g_strdup_printf ("--delay=%dms", pd->sd->delay);
+
+  argv[argc++] = SCREENSHOOTER_BINARY;
+
+  if (pd->sd->region == ACTIVE_WINDOW)
+    argv[argc++] = "--window";
+  else if (pd->sd->region == SELECT)
+    argv[argc++] = "--region";
+  else
+    argv[argc++] = "--fullscreen";
+
+  argv[argc++] = delay_arg;
+
+  if (pd->sd->show_mouse)
+    argv[argc++] = "--mouse";
+
+  argv[argc++] = rc_arg;
+  argv[argc] = NULL;
+
+  TRACE ("Spawn %s", SCREENSHOOTER_BINARY);
+
+  spawned = g_spawn_async (NULL, (gchar **) argv, NULL,
+                           G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+                           &pid, &error);
+  g_free (rc_arg);
+  g_free (delay_arg);
+
+  if (!spawned)
+    {
+      g_warning ("Could not start %s: %s", SCREENSHOOTER_BINARY,
+                 error->message);
+      g_error_free (error);
+      g_unlink (capture_rc_file);
+      g_free (capture_rc_file);
+
+      return FALSE;
+    }
+
+  capture = g_new0 (PluginCapture, 1);
+  capture->pd = pd;
+  capture->rc_file = capture_rc_file;
+  capture->watch_id =
+    g_child_watch_add (pid, (GChildWatchFunc) cb_capture_exited, capture);
+  pd->captures = g_slist_prepend (pd->captures, capture);
+
+  return TRUE;
+}
+
+
+
 /* Take the screenshot when the button is clicked.
 button: the panel button.
 pd: the PluginData storing the options for taking the screenshot.
@@ -172,16 +375,14 @@ pd: the PluginData storing the options for taking the screenshot.
 static void
 cb_button_clicked (GtkWidget *button, PluginData *pd)
 {
-  /* Make the button unclickable so that the user does not press it while
-	another screenshot is in progress */
-  gtk_widget_set_sensitive (GTK_WIDGET (button), FALSE);
-
   TRACE ("Start taking the screenshot");
 
-  screenshooter_take_screenshot_idle (pd->sd);
-
-  /* Make the panel button clickable */
-  gtk_widget_set_sensitive (GTK_WIDGET (button), TRUE);
+  /* The delay, the dialogs, the encoding and the uploads would block the
+   * panel, let another process take the screenshot and run the actions.
+   * The button stays clickable, each click starts its own capture */
+  if (!screenshooter_plugin_spawn_capture (pd))
+    screenshooter_error (_("The screenshot could not be taken, %s could not"
+                           " be started."), SCREENSHOOTER_BINARY);
 }
 
 
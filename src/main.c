@@ -24,6 +24,8 @@
 #include "libscreenshooter.h"
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 
 
@@ -37,9 +39,36 @@ gboolean upload = FALSE;
 gboolean clipboard = FALSE;
 gboolean upload_imgur = FALSE;
 gboolean upload_imgur_copy = FALSE;
+gboolean upload_imgur_album = FALSE;
+gboolean upload_custom = FALSE;
+gboolean upload_s3 = FALSE;
 gchar *screenshot_dir;
 gchar *application;
 gint delay = 0;
+gboolean queue_list = FALSE;
+gboolean queue_flush = FALSE;
+gchar *queue_cancel = NULL;
+gboolean no_cache = FALSE;
+gint jobs = 4;
+gint bandwidth_limit = -1;
+gboolean print_timings = FALSE;
+gboolean daemon_mode = FALSE;
+gboolean no_daemon = FALSE;
+gchar *rc_path = NULL;
+gint when_stable = 0;
+gboolean freeze = FALSE;
+gchar **files = NULL;
+
+/* Time the headless capture spent in the delay before it gave up, in
+ * milliseconds */
+gint headless_waited = 0;
+
+
+
+static gboolean parse_delay (const gchar  *option_name,
+                             const gchar  *value,
+                             gpointer      data,
+                             GError      **error);
 
 
 
@@ -52,8 +81,18 @@ static GOptionEntry entries[] =
     NULL
   },
   {
-    "delay", 'd', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &delay,
-    N_("Delay in seconds before taking the screenshot"),
+    "daemon", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &daemon_mode,
+    N_("Stay in the background and take the screenshots requested by other instances"),
+    NULL
+  },
+  {
+    "delay", 'd', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_CALLBACK, parse_delay,
+    N_("Delay before taking the screenshot, in seconds or with a unit like 250ms"),
+    N_("DELAY")
+  },
+  {
+    "freeze", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &freeze,
+    N_("Select the region on a still image of the screen"),
     NULL
   },
   {
@@ -61,16 +100,56 @@ static GOptionEntry entries[] =
     N_("Take a screenshot of the entire screen"),
     NULL
   },
+  {
+    "bandwidth-limit", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &bandwidth_limit,
+    N_("Maximum upload rate in KiB/s, 0 for no limit"),
+    N_("KIB")
+  },
+  {
+    "jobs", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &jobs,
+    N_("Number of files uploaded at the same time when files are given"),
+    N_("N")
+  },
   {
     "mouse", 'm', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &mouse,
     N_("Display the mouse on the screenshot"),
     NULL
   },
+  {
+    "no-cache", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &no_cache,
+    N_("Upload the screenshot even if the same image was already uploaded"),
+    NULL
+  },
   {
     "open", 'o', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING, &application,
     N_("Application to open the screenshot"),
     NULL
   },
+  {
+    "queue-cancel", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING, &queue_cancel,
+    N_("Remove the given entry from the upload queue"),
+    N_("ID")
+  },
+  {
+    "queue-flush", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &queue_flush,
+    N_("Upload the screenshots of the upload queue now"),
+    NULL
+  },
+  {
+    "no-daemon", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &no_daemon,
+    N_("Take the screenshot in this process even if a daemon is running"),
+    NULL
+  },
+  {
+    "queue-list", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &queue_list,
+    N_("List the screenshots waiting to be uploaded"),
+    NULL
+  },
+  {
+    "rc-file", 0, G_OPTION_FLAG_IN_MAIN | G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME, &rc_path,
+    N_("Read and save the preferences in this file"),
+    N_("FILE")
+  },
   {
     "region", 'r', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &region,
     N_("Select a region to be captured by clicking a point of the screen "
@@ -98,16 +177,46 @@ static GOptionEntry entries[] =
     N_("Host the screenshot on Imgur, and copy uploaded image's link do clipboard"),
     NULL
   },
+  {
+    "imgur-album", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &upload_imgur_album,
+    N_("Host the given files on Imgur in a single album, and show its link"),
+    NULL
+  },
+  {
+    "timings", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &print_timings,
+    N_("Print the timings of each upload, and of the shortcut captures of the daemon, on stderr"),
+    NULL
+  },
+  {
+    "upload-custom", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &upload_custom,
+    N_("Host the screenshot on the upload service set up in the configuration file"),
+    NULL
+  },
+  {
+    "upload-s3", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &upload_s3,
+    N_("Upload the screenshot to the S3 bucket set up in the configuration file"),
+    NULL
+  },
   {
     "version", 'V', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &version,
     N_("Version information"),
     NULL
   },
+  {
+    "when-stable", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_INT, &when_stable,
+    N_("Take the screenshot once nothing was drawn on the screen or the window for this many milliseconds"),
+    N_("MS")
+  },
   {
     "window", 'w', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &window,
     N_("Take a screenshot of the active window"),
     NULL
   },
+  {
+    G_OPTION_REMAINING, ' ', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_FILENAME_ARRAY, &files,
+    NULL,
+    N_("[FILE...]")
+  },
   {
     NULL, ' ', 0, 0, NULL,
     NULL,
@@ -117,6 +226,244 @@ static GOptionEntry entries[] =
 
 
 
+/* Reads the --delay option, in milliseconds */
+static gboolean
+parse_delay (const gchar  *option_name,
+             const gchar  *value,
+             gpointer      data,
+             GError      **error)
+{
+  if (screenshooter_delay_parse (value, &delay))
+    return TRUE;
+
+  g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+               _("Cannot parse the delay: %s"), value);
+
+  return FALSE;
+}
+
+
+
+static void
+print_upload_queue (const ScreenshooterUploadModule *module)
+{
+  GList *entries = module->queue_list ();
+  GList *l;
+
+  if (entries == NULL)
+    g_print (_("The upload queue is empty.\n"));
+
+  for (l = entries; l != NULL; l = l->next)
+    {
+      ScreenshooterQueueEntry *entry = l->data;
+      time_t next_attempt = (time_t) entry->next_attempt;
+      gchar next_time[64];
+
+      if (strftime (next_time, sizeof (next_time), "%c",
+                    localtime (&next_attempt)) == 0)
+        next_time[0] = '\0';
+
+      g_print ("%s\t%s\t%s\n", entry->id, entry->backend,
+               entry->title != NULL ? entry->title : "");
+      g_print (_("\tAttempts: %d, next attempt: %s, last error: %s\n"),
+               entry->attempts, next_time, entry->last_error);
+    }
+
+  g_list_foreach (entries, (GFunc) module->queue_entry_free, NULL);
+  g_list_free (entries);
+}
+
+
+
+/* Saves a fullscreen or window capture to a local folder without GTK.
+ * Returns -1 if the capture should be done with GTK, else the exit
+ * status. */
+static gint
+capture_headless (void)
+{
+  GFile *dir = g_file_new_for_commandline_arg (screenshot_dir);
+  gchar *uri, *title, *path;
+  const gchar *rc_file;
+  gboolean timestamp = TRUE;
+  GError *error = NULL;
+  XfceRc *rc;
+  gint64 started;
+
+  /* Missing folders are reported by the usual path */
+  if (!g_file_is_native (dir) ||
+      g_file_query_file_type (dir, G_FILE_QUERY_INFO_NONE, NULL) != G_FILE_TYPE_DIRECTORY)
+    {
+      g_object_unref (dir);
+      return -1;
+    }
+
+  uri = g_file_get_uri (dir);
+  g_object_unref (dir);
+
+  title = g_strdup (_("Screenshot"));
+  rc_file = xfce_resource_lookup (XFCE_RESOURCE_CONFIG, "xfce4/xfce4-screenshooter");
+  rc = rc_file != NULL ? xfce_rc_simple_open (rc_file, TRUE) : NULL;
+
+  if (rc != NULL)
+    {
+      g_free (title);
+      title = g_strdup (xfce_rc_read_entry (rc, "title", _("Screenshot")));
+      timestamp = xfce_rc_read_bool_entry (rc, "timestamp", TRUE);
+      xfce_rc_close (rc);
+    }
+
+  started = g_get_monotonic_time ();
+  path = screenshooter_headless_capture (window ? ACTIVE_WINDOW : FULLSCREEN,
+                                         delay, mouse, uri, title, timestamp,
+                                         &error);
+  g_free (title);
+  g_free (uri);
+
+  if (path != NULL)
+    {
+      g_free (path);
+      return EXIT_SUCCESS;
+    }
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+    {
+      TRACE ("Capture with GTK: %s", error->message);
+      g_error_free (error);
+
+      /* The screen may have been read after the delay, do not wait for
+       * it again */
+      headless_waited = (g_get_monotonic_time () - started) / 1000;
+      delay = MAX (0, delay - headless_waited);
+
+      return -1;
+    }
+
+  g_printerr ("%s\n", error->message);
+  g_error_free (error);
+
+  return EXIT_FAILURE;
+}
+
+
+
+/* Takes the capture before GTK is initialized, when the options allow it:
+ * plain saves to a local folder are done by this process without the
+ * toolkit, the other plain captures are sent to the daemon. Returns -1 if
+ * the capture should be done by this process with GTK, else the exit
+ * status. */
+static gint
+capture_without_gtk (gint argc, gchar **argv)
+{
+  GOptionContext *context;
+  GVariantBuilder builder;
+  GError *error = NULL;
+  const gchar *display;
+  gchar **args;
+  gint n_args = argc, n_actions, status;
+  gboolean parsed, taken;
+
+  /* The options are parsed again by gtk_init_with_args () */
+  args = g_new0 (gchar *, argc + 1);
+  memcpy (args, argv, argc * sizeof (gchar *));
+
+  context = g_option_context_new (NULL);
+  g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+  g_option_context_set_help_enabled (context, FALSE);
+  g_option_context_set_ignore_unknown_options (context, TRUE);
+  parsed = g_option_context_parse (context, &n_args, &args, NULL);
+  g_option_context_free (context);
+  g_free (args);
+
+  n_actions = (application != NULL) + upload + clipboard + upload_imgur +
+    upload_imgur_copy + upload_custom + upload_s3;
+
+  /* Leave everything but plain captures to this process. The options
+   * left, like --display, are only known by GTK. */
+  if (!parsed || n_args > 1 || daemon_mode || version || files != NULL ||
+      (fullscreen + window + region) != 1 || n_actions > 1 ||
+      (n_actions == 1 && screenshot_dir != NULL) ||
+      queue_list || queue_flush || queue_cancel != NULL || no_cache ||
+      upload_imgur_album || bandwidth_limit >= 0 || print_timings ||
+      rc_path != NULL || when_stable != 0)
+    goto fallback;
+
+  if (!region && n_actions == 0 && screenshot_dir != NULL)
+    {
+      status = capture_headless ();
+
+      if (status >= 0)
+        return status;
+    }
+
+  if (no_daemon)
+    goto fallback;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&builder, "{sv}", "region",
+                         g_variant_new_uint32 (window ? ACTIVE_WINDOW :
+                                               (fullscreen ? FULLSCREEN : SELECT)));
+  g_variant_builder_add (&builder, "{sv}", "delay", g_variant_new_int32 (delay));
+  g_variant_builder_add (&builder, "{sv}", "show-mouse", g_variant_new_boolean (mouse));
+
+  if (freeze)
+    g_variant_builder_add (&builder, "{sv}", "freeze", g_variant_new_boolean (TRUE));
+
+  if (application != NULL)
+    {
+      g_variant_builder_add (&builder, "{sv}", "action", g_variant_new_int32 (OPEN));
+      g_variant_builder_add (&builder, "{sv}", "app", g_variant_new_string (application));
+    }
+  else if (n_actions == 1)
+    g_variant_builder_add (&builder, "{sv}", "action",
+                           g_variant_new_int32 (upload ? UPLOAD :
+                                                clipboard ? CLIPBOARD :
+                                                upload_imgur ? UPLOAD_IMGUR :
+                                                upload_imgur_copy ? UPLOAD_IMGUR_COPY :
+                                                upload_custom ? UPLOAD_CUSTOM :
+                                                UPLOAD_S3));
+
+  if (screenshot_dir != NULL)
+    {
+      GFile *dir = g_file_new_for_commandline_arg (screenshot_dir);
+      gchar *uri = g_file_get_uri (dir);
+
+      g_variant_builder_add (&builder, "{sv}", "screenshot-dir",
+                             g_variant_new_string (uri));
+      g_free (uri);
+      g_object_unref (dir);
+    }
+
+  /* A daemon of another display would capture the wrong screen */
+  display = g_getenv ("DISPLAY");
+
+  if (display != NULL)
+    g_variant_builder_add (&builder, "{sv}", "display",
+                           g_variant_new_string (display));
+
+  if (screenshooter_daemon_capture (g_variant_builder_end (&builder),
+                                    &taken, &error))
+    return taken ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  TRACE ("The daemon did not take the capture: %s", error->message);
+  g_error_free (error);
+
+fallback:
+  g_free (application);
+  application = NULL;
+  g_free (screenshot_dir);
+  screenshot_dir = NULL;
+  g_free (queue_cancel);
+  queue_cancel = NULL;
+  g_strfreev (files);
+  files = NULL;
+  g_free (rc_path);
+  rc_path = NULL;
+
+  return -1;
+}
+
+
+
 static void
 cb_dialog_response (GtkWidget *dialog, gint response, ScreenshotData *sd)
 {
@@ -128,6 +475,9 @@ cb_dialog_response (GtkWidget *dialog, gint response, ScreenshotData *sd)
   else if (response == GTK_RESPONSE_OK)
     {
       gtk_widget_destroy (dialog);
+
+      /* Wait for the dialog to be gone from the screen */
+      sd->own_ui = TRUE;
       g_idle_add ((GSourceFunc) screenshooter_take_screenshot_idle, sd);
     }
   else
@@ -148,6 +498,8 @@ int main (int argc, char **argv)
   GError *cli_error = NULL;
   GFile *default_save_dir;
   const gchar *rc_file;
+  gboolean rc_existed;
+  gint exit_status = EXIT_SUCCESS;
   const gchar *conflict_error =
     _("Conflicting options: --%s and --%s cannot be used at the same time.\n");
   const gchar *ignore_error =
@@ -159,6 +511,30 @@ int main (int argc, char **argv)
 
   xfce_textdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR, "UTF-8");
 
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+  /* The uploads run in threads */
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+#endif
+
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+  /* GIO is used before GTK is initialized */
+  g_type_init ();
+#endif
+
+  /* Save plain captures without GTK, or let a running daemon take the
+   * screenshot, it is ready to read the screen right away */
+  exit_status = capture_without_gtk (argc, argv);
+
+  if (exit_status >= 0)
+    {
+      g_free (sd);
+
+      return exit_status;
+    }
+
+  exit_status = EXIT_SUCCESS;
+
   /* Print a message to advise to use help when a non existing cli option is
   passed to the executable. */
   if (!gtk_init_with_args(&argc, &argv, "", entries, PACKAGE, &cli_error))
@@ -176,6 +552,9 @@ int main (int argc, char **argv)
         }
     }
 
+  /* The options were parsed again, with the whole delay */
+  delay = MAX (0, delay - headless_waited);
+
   /* Exit if two region options were given */
   if (window && fullscreen)
     {
@@ -199,6 +578,15 @@ int main (int argc, char **argv)
       return EXIT_FAILURE;
     }
 
+  /* The selected region is only known once the user is done */
+  if (when_stable && region)
+    {
+      g_printerr (conflict_error, "when-stable", "region");
+
+      g_free (sd);
+      return EXIT_FAILURE;
+    }
+
   /* Exit if two actions options were given */
   if (upload && (application != NULL))
     {
@@ -282,6 +670,50 @@ int main (int argc, char **argv)
     	g_printerr (conflict_error, "imgur-copy", "save");
     	return EXIT_FAILURE;
     }
+  else if (upload_custom && (upload || upload_imgur || upload_imgur_copy))
+    {
+      g_printerr (conflict_error, "upload-custom",
+                  upload ? "upload" : (upload_imgur ? "imgur" : "imgur-copy"));
+      return EXIT_FAILURE;
+    }
+  else if (upload_custom && clipboard)
+    {
+      g_printerr (conflict_error, "upload-custom", "clipboard");
+      return EXIT_FAILURE;
+    }
+  else if (upload_custom && (application != NULL))
+    {
+      g_printerr (conflict_error, "upload-custom", "open");
+      return EXIT_FAILURE;
+    }
+  else if (upload_custom && (screenshot_dir != NULL))
+    {
+      g_printerr (conflict_error, "upload-custom", "save");
+      return EXIT_FAILURE;
+    }
+  else if (upload_s3 &&
+           (upload || upload_imgur || upload_imgur_copy || upload_custom))
+    {
+      g_printerr (conflict_error, "upload-s3",
+                  upload ? "upload" : (upload_imgur ? "imgur" :
+                  (upload_imgur_copy ? "imgur-copy" : "upload-custom")));
+      return EXIT_FAILURE;
+    }
+  else if (upload_s3 && clipboard)
+    {
+      g_printerr (conflict_error, "upload-s3", "clipboard");
+      return EXIT_FAILURE;
+    }
+  else if (upload_s3 && (application != NULL))
+    {
+      g_printerr (conflict_error, "upload-s3", "open");
+      return EXIT_FAILURE;
+    }
+  else if (upload_s3 && (screenshot_dir != NULL))
+    {
+      g_printerr (conflict_error, "upload-s3", "save");
+      return EXIT_FAILURE;
+    }
 
   /* Warn that action options, mouse and delay will be ignored in
    * non-cli mode */
@@ -289,18 +721,40 @@ int main (int argc, char **argv)
     g_printerr (ignore_error, "open");
   if ((screenshot_dir != NULL)  && !(fullscreen || window || region ))
     g_printerr (ignore_error, "save");
-  if (upload_imgur && !(fullscreen || window || region))
+  if (upload_imgur && !(fullscreen || window || region || files))
     g_printerr (ignore_error, "imgur");
-  if (upload_imgur_copy && !(fullscreen || window || region))
+  if (upload_imgur_copy && !(fullscreen || window || region || files))
     g_printerr (ignore_error, "imgur-copy");
+  if (upload_imgur_album && !files)
+    g_printerr (_("%s only applies to files given on the command line.\n"),
+                "--imgur-album");
   if (upload && !(fullscreen || window || region))
     g_printerr (ignore_error, "upload");
+  if (upload_custom && !(fullscreen || window || region || files))
+    g_printerr (ignore_error, "upload-custom");
+  if (upload_s3 && !(fullscreen || window || region || files))
+    g_printerr (ignore_error, "upload-s3");
   if (clipboard && !(fullscreen || window || region))
     g_printerr (ignore_error, "clipboard");
   if (delay && !(fullscreen || window || region))
     g_printerr (ignore_error, "delay");
   if (mouse && !(fullscreen || window || region))
     g_printerr (ignore_error, "mouse");
+  if (freeze && !region)
+    g_printerr (_("The --%s option is only used when --region is given."
+                  " It will be ignored.\n"), "freeze");
+  if (when_stable && !(fullscreen || window))
+    g_printerr (_("The --%s option is only used when --fullscreen or --window"
+                  " is given. It will be ignored.\n"), "when-stable");
+
+  if (when_stable < 0)
+    {
+      g_printerr (_("The --%s option takes a positive number of milliseconds.\n"),
+                  "when-stable");
+
+      g_free (sd);
+      return EXIT_FAILURE;
+    }
 
   /* Just print the version if we are in version mode */
   if (version)
@@ -312,9 +766,134 @@ int main (int argc, char **argv)
       return EXIT_SUCCESS;
     }
 
-  /* Read the preferences */
-  rc_file = xfce_resource_save_location (XFCE_RESOURCE_CONFIG, "xfce4/xfce4-screenshooter", TRUE);
+  /* Read the preferences, the panel plugin gives a copy of its own file
+   * to the captures it starts */
+  if (rc_path != NULL)
+    rc_file = rc_path;
+  else
+    rc_file = xfce_resource_save_location (XFCE_RESOURCE_CONFIG, "xfce4/xfce4-screenshooter", TRUE);
+  rc_existed = g_file_test (rc_file, G_FILE_TEST_EXISTS);
   screenshooter_read_rc_file (rc_file, sd);
+  screenshooter_upload_module_configure (sd->upload_max_conns,
+                                         sd->upload_max_conns_per_host);
+
+  /* The command line limit replaces the one of the rc file, for this
+   * run only */
+  screenshooter_upload_module_set_bandwidth_limit (bandwidth_limit >= 0 ?
+                                                   bandwidth_limit :
+                                                   sd->upload_bandwidth_limit);
+  screenshooter_upload_module_set_print_timings (print_timings);
+  screenshooter_daemon_set_print_timings (print_timings);
+  screenshooter_upload_module_set_cache_enabled (!no_cache);
+
+  /* Manage the upload queue and exit */
+  if (queue_list || queue_flush || queue_cancel != NULL)
+    {
+      const ScreenshooterUploadModule *module = screenshooter_upload_module_get ();
+      gint status = EXIT_SUCCESS;
+
+      if (module == NULL)
+        status = EXIT_FAILURE;
+      else
+        {
+          if (queue_cancel != NULL && !module->queue_cancel (queue_cancel))
+            {
+              g_printerr (_("There is no %s entry in the upload queue.\n"),
+                          queue_cancel);
+              status = EXIT_FAILURE;
+            }
+
+          if (queue_flush && module->queue_flush () > 0)
+            status = EXIT_FAILURE;
+
+          if (queue_list)
+            print_upload_queue (module);
+        }
+
+      screenshooter_upload_module_shutdown ();
+
+      g_free (queue_cancel);
+      g_free (sd->screenshot_dir);
+      g_free (sd->title);
+      g_free (sd->app);
+      g_free (sd->last_user);
+      screenshooter_custom_upload_free (sd->custom_upload);
+      screenshooter_s3_free (sd->s3);
+      g_free (sd);
+
+      return status;
+    }
+
+  /* Upload the given files and exit */
+  if (files != NULL)
+    {
+      const ScreenshooterUploadModule *module = NULL;
+      gint status = EXIT_FAILURE;
+
+      if (fullscreen || window || region)
+        g_printerr (_("Files to upload cannot be given with --fullscreen,"
+                      " --window or --region.\n"));
+      else if (upload_custom && sd->custom_upload == NULL)
+        g_printerr (_("No upload service is set up in %s.\n"), rc_file);
+      else if (upload_s3 && sd->s3 == NULL)
+        g_printerr (_("No S3 bucket is set up in %s.\n"), rc_file);
+      else if (upload_imgur_album &&
+               (upload_imgur || upload_imgur_copy || upload_custom || upload_s3))
+        g_printerr (conflict_error, "imgur-album",
+                    upload_imgur ? "imgur" : (upload_imgur_copy ? "imgur-copy" :
+                    (upload_custom ? "upload-custom" : "upload-s3")));
+      else if (!(upload_imgur || upload_imgur_copy || upload_custom ||
+                 upload_s3 || upload_imgur_album))
+        g_printerr (_("Choose where to upload the files with --imgur,"
+                      " --imgur-album, --upload-custom or --upload-s3.\n"));
+      else if ((module = screenshooter_upload_module_get ()) == NULL)
+        TRACE ("The upload module is not available");
+      else if (upload_imgur_album)
+        {
+          gchar **paths = module->batch_expand_files (files);
+
+          /* Upload the images of the album in parallel */
+          screenshooter_upload_module_configure (MAX (sd->upload_max_conns, jobs),
+                                                 MAX (sd->upload_max_conns_per_host, jobs));
+          module->upload_to_imgur_album (paths, sd->title);
+          status = EXIT_SUCCESS;
+
+          g_strfreev (paths);
+        }
+      else
+        {
+          if (upload_custom)
+            sd->action = UPLOAD_CUSTOM;
+          else if (upload_s3)
+            sd->action = UPLOAD_S3;
+          else
+            sd->action = UPLOAD_IMGUR;
+
+          /* Let every worker have its own connection */
+          screenshooter_upload_module_configure (MAX (sd->upload_max_conns, jobs),
+                                                 MAX (sd->upload_max_conns_per_host, jobs));
+
+          if (module->batch_upload (files, sd, jobs) == 0)
+            status = EXIT_SUCCESS;
+        }
+
+      screenshooter_upload_module_shutdown ();
+
+      g_strfreev (files);
+      g_free (sd->screenshot_dir);
+      g_free (sd->title);
+      g_free (sd->app);
+      g_free (sd->last_user);
+      screenshooter_custom_upload_free (sd->custom_upload);
+      screenshooter_s3_free (sd->s3);
+      g_free (sd);
+
+      return status;
+    }
+
+  /* Retry the uploads which failed earlier while this instance runs,
+   * including the captures started by the panel plugin */
+  screenshooter_upload_module_start_queue ();
 
   /* Default to no action specified */
   sd->action_specified = FALSE;
@@ -330,8 +909,11 @@ int main (int argc, char **argv)
 
   g_object_unref (default_save_dir);
 
+  /* Wait for the captures requested by the other instances */
+  if (daemon_mode)
+    screenshooter_daemon_start (sd, rc_file);
   /* If a region cli option is given, take the screenshot accordingly.*/
-  if (fullscreen || window || region)
+  else if (fullscreen || window || region)
     {
       /* Set the region to be captured */
       if (window)
@@ -345,6 +927,11 @@ int main (int argc, char **argv)
       mouse ? (sd->show_mouse = 1) : (sd->show_mouse = 0);
 
       sd->delay = delay;
+      sd->when_stable = when_stable;
+
+      /* The preference is not saved when given on the command line */
+      if (freeze)
+        sd->freeze_selection = TRUE;
 
       if (application != NULL)
         {
@@ -376,7 +963,34 @@ int main (int argc, char **argv)
           sd->action = UPLOAD_IMGUR_COPY;
           sd->action_specified = TRUE;
         }
-      else
+      else if (upload_custom)
+        {
+          if (sd->custom_upload == NULL)
+            {
+              g_printerr (_("No upload service is set up in %s.\n"), rc_file);
+
+              return EXIT_FAILURE;
+            }
+
+          sd->app = g_strdup ("none");
+          sd->action = UPLOAD_CUSTOM;
+          sd->action_specified = TRUE;
+        }
+      else if (upload_s3)
+        {
+          if (sd->s3 == NULL)
+            {
+              g_printerr (_("No S3 bucket is set up in %s.\n"), rc_file);
+
+              return EXIT_FAILURE;
+            }
+
+          sd->app = g_strdup ("none");
+          sd->action = UPLOAD_S3;
+          sd->action_specified = TRUE;
+        }
+      /* Preselect the last action of the panel plugin in the dialog */
+      else if (rc_path == NULL)
         {
           sd->app = g_strdup ("none");
           sd->action = SAVE;
@@ -402,6 +1016,9 @@ int main (int argc, char **argv)
           g_free (screenshot_dir);
         }
 
+      /* Connect to the upload host while the screenshot is taken */
+      screenshooter_action_warm_up (sd);
+
       g_idle_add ((GSourceFunc) screenshooter_take_screenshot_idle, sd);
     }
   /* Else we show a dialog which allows to set the screenshot options */
@@ -409,10 +1026,6 @@ int main (int argc, char **argv)
     {
       GtkWidget *dialog;
 
-      /* Use 1 as the minimal delay, 0 may show corrupted windows */
-      if (sd->delay == 0)
-        sd->delay = 1;
-
       /* Set the dialog up */
       dialog = screenshooter_region_dialog_new (sd, FALSE);
       g_signal_connect (dialog, "response",
@@ -424,16 +1037,31 @@ int main (int argc, char **argv)
 
   gtk_main ();
 
-  /* Save preferences */
-  screenshooter_write_rc_file (rc_file, sd);
+  if (daemon_mode && !screenshooter_daemon_stop ())
+    exit_status = EXIT_FAILURE;
+
+  if (sd->aborted)
+    exit_status = EXIT_FAILURE;
+
+  /* Save preferences, unless the panel plugin removed its copy of the rc
+   * file meanwhile */
+  if (!rc_existed || g_file_test (rc_file, G_FILE_TEST_EXISTS))
+    screenshooter_write_rc_file (rc_file, sd);
+
+  /* Wait for the uploads of the queue and close the connections kept
+   * open by the uploads */
+  screenshooter_upload_module_shutdown ();
 
   g_free (sd->screenshot_dir);
   g_free (sd->title);
   g_free (sd->app);
   g_free (sd->last_user);
+  screenshooter_custom_upload_free (sd->custom_upload);
+  screenshooter_s3_free (sd->s3);
   g_free (sd);
+  g_free (rc_path);
 
   TRACE ("Ciao");
 
-  return EXIT_SUCCESS;
+  return exit_status;
 }
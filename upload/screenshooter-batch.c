@@ -0,0 +1,311 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Upload of existing files from the command line.
+
+   The files are sent by a pool of threads to the service of sd->action,
+   in the same process and over the same session, so the connections are
+   opened once for the whole batch. A line is printed for each file as
+   soon as its upload is over: the file and the link on the standard
+   output, or the file and the error on the standard error.
+*/
+
+#include "screenshooter-batch.h"
+#include "screenshooter-imgur.h"
+#include "screenshooter-custom-upload-send.h"
+#include "screenshooter-s3-send.h"
+
+#include <string.h>
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+
+
+
+typedef struct
+{
+  ScreenshotData *sd;
+  gint            failures;
+}
+BatchData;
+
+
+
+G_LOCK_DEFINE_STATIC (batch_output);
+
+
+
+static gint       batch_compare_paths  (const gchar **a,
+                                        const gchar **b);
+static void       batch_expand_pattern (const gchar *pattern,
+                                        GPtrArray   *paths);
+static GPtrArray *batch_expand         (gchar      **files);
+static gboolean   batch_send           (ScreenshotData *sd,
+                                        const gchar    *path,
+                                        gchar         **link,
+                                        GError        **error);
+static void       batch_upload_file    (gchar       *path,
+                                        BatchData   *batch);
+
+
+
+/* Internals */
+
+
+
+/* g_ptr_array_sort passes pointers to the elements */
+static gint
+batch_compare_paths (const gchar **a, const gchar **b)
+{
+  return g_strcmp0 (*a, *b);
+}
+
+
+
+/* Adds the files matching the wildcards of the last component of
+ * @pattern, for the patterns which were quoted on the command line */
+static void
+batch_expand_pattern (const gchar *pattern, GPtrArray *paths)
+{
+  gchar *dirname, *basename;
+  GPatternSpec *spec;
+  GPtrArray *matches;
+  const gchar *name;
+  GDir *dir;
+  guint i;
+
+  if (strpbrk (pattern, "*?") == NULL)
+    {
+      g_ptr_array_add (paths, g_strdup (pattern));
+      return;
+    }
+
+  dirname = g_path_get_dirname (pattern);
+  basename = g_path_get_basename (pattern);
+  dir = g_dir_open (dirname, 0, NULL);
+
+  if (dir == NULL)
+    {
+      /* Will be reported as a file which cannot be read */
+      g_ptr_array_add (paths, g_strdup (pattern));
+      g_free (basename);
+      g_free (dirname);
+
+      return;
+    }
+
+  spec = g_pattern_spec_new (basename);
+  matches = g_ptr_array_new ();
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *path;
+
+      if (!g_pattern_match_string (spec, name))
+        continue;
+
+      path = g_build_filename (dirname, name, NULL);
+
+      if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+        g_ptr_array_add (matches, path);
+      else
+        g_free (path);
+    }
+
+  g_ptr_array_sort (matches, (GCompareFunc) batch_compare_paths);
+
+  for (i = 0; i < matches->len; i++)
+    g_ptr_array_add (paths, g_ptr_array_index (matches, i));
+
+  if (matches->len == 0)
+    g_ptr_array_add (paths, g_strdup (pattern));
+
+  g_ptr_array_free (matches, TRUE);
+  g_pattern_spec_free (spec);
+  g_dir_close (dir);
+  g_free (basename);
+  g_free (dirname);
+}
+
+
+
+static GPtrArray
+*batch_expand (gchar **files)
+{
+  GPtrArray *paths = g_ptr_array_new ();
+  gchar **file;
+
+  for (file = files; *file != NULL; file++)
+    batch_expand_pattern (*file, paths);
+
+  return paths;
+}
+
+
+
+static gboolean
+batch_send (ScreenshotData *sd, const gchar *path, gchar **link, GError **error)
+{
+  gchar *title;
+  gboolean result = FALSE;
+
+  /* Use the file name as the title */
+  title = g_path_get_basename (path);
+
+  if (g_strrstr (title, ".") != NULL)
+    *g_strrstr (title, ".") = '\0';
+
+  switch (sd->action)
+    {
+      case UPLOAD_IMGUR:
+      case UPLOAD_IMGUR_COPY:
+        {
+          gchar *id = NULL;
+
+          /* The file may have been sent in another format */
+          result = screenshooter_imgur_upload_file (path, title, &id, NULL,
+                                                    link, error);
+          g_free (id);
+        }
+        break;
+      case UPLOAD_CUSTOM:
+        result = screenshooter_custom_upload_file (sd->custom_upload, path,
+                                                   title, link, error);
+        break;
+      case UPLOAD_S3:
+        result = screenshooter_s3_upload_file (sd->s3, path, link,
+                                               NULL, NULL, error);
+        break;
+      default:
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                     _("This service cannot be used to upload several"
+                       " files."));
+        break;
+    }
+
+  g_free (title);
+
+  return result;
+}
+
+
+
+/* Thread function of the pool */
+static void
+batch_upload_file (gchar *path, BatchData *batch)
+{
+  GError *error = NULL;
+  gchar *link = NULL;
+
+  if (!g_file_test (path, G_FILE_TEST_IS_REGULAR))
+    g_set_error (&error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                 _("%s is not a file."), path);
+  else
+    batch_send (batch->sd, path, &link, &error);
+
+  G_LOCK (batch_output);
+
+  if (error == NULL)
+    g_print ("%s\t%s\n", path, link);
+  else
+    {
+      g_printerr ("%s\t%s\n", path, error->message);
+      batch->failures++;
+    }
+
+  G_UNLOCK (batch_output);
+
+  if (error != NULL)
+    g_error_free (error);
+
+  g_free (link);
+  g_free (path);
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_batch_expand_files:
+ * @files: a %NULL-terminated array of paths, which can contain wildcards.
+ *
+ * Expands the wildcards of @files the same way screenshooter_batch_upload()
+ * does. Patterns which do not match any file are kept as they are, so
+ * that the upload reports them.
+ *
+ * Return value: a %NULL-terminated array of paths, to be freed with
+ * g_strfreev().
+ **/
+gchar
+**screenshooter_batch_expand_files (gchar **files)
+{
+  GPtrArray *paths;
+
+  g_return_val_if_fail (files != NULL, NULL);
+
+  paths = batch_expand (files);
+  g_ptr_array_add (paths, NULL);
+
+  return (gchar **) g_ptr_array_free (paths, FALSE);
+}
+
+
+
+/**
+ * screenshooter_batch_upload:
+ * @files: a %NULL-terminated array of paths, which may contain the * and ?
+ * wildcards in their last component.
+ * @sd: the #ScreenshotData whose action is the service to upload to.
+ * @jobs: the number of files uploaded at the same time.
+ *
+ * Uploads the files to the service of @sd and prints the results. Returns
+ * once all the files were processed.
+ *
+ * Return value: the number of files which could not be uploaded.
+ **/
+gint
+screenshooter_batch_upload (gchar **files, ScreenshotData *sd, gint jobs)
+{
+  BatchData batch = { sd, 0 };
+  GThreadPool *pool;
+  GPtrArray *paths;
+  guint i;
+
+  g_return_val_if_fail (files != NULL, 0);
+  g_return_val_if_fail (sd != NULL, 0);
+
+  paths = batch_expand (files);
+  jobs = CLAMP (jobs, 1, (gint) MAX (paths->len, 1));
+
+  TRACE ("Upload %u files, %d at a time", paths->len, jobs);
+
+  pool = g_thread_pool_new ((GFunc) batch_upload_file, &batch, jobs, FALSE, NULL);
+
+  for (i = 0; i < paths->len; i++)
+    g_thread_pool_push (pool, g_ptr_array_index (paths, i), NULL);
+
+  /* Wait for all the uploads */
+  g_thread_pool_free (pool, FALSE, TRUE);
+  /* The workers freed the paths */
+  g_ptr_array_free (paths, TRUE);
+
+  return batch.failures;
+}
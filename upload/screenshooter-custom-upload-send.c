@@ -0,0 +1,504 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Sending images to the upload service defined by the user, see
+   lib/screenshooter-custom-upload.c for the keys of the rc file.
+
+   The image is streamed from the disk and sent over the shared session,
+   so the uploads reuse the connections to the server.
+*/
+
+#include "screenshooter-custom-upload-send.h"
+#include "screenshooter-job-callbacks.h"
+#include "screenshooter-stream-body.h"
+#include "screenshooter-transcode.h"
+#include "screenshooter-upload-session.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
+#include <libxml/parser.h>
+#include <libxml/xpath.h>
+
+
+
+static SoupMessage *custom_build_message     (ScreenshooterCustomUpload  *custom,
+                                              SoupSession                *session,
+                                              const gchar                *image_path,
+                                              const gchar                *mime_type,
+                                              const gchar                *title,
+                                              GError                    **error);
+static gchar       *custom_extract_xpath     (SoupMessage                *msg,
+                                              const gchar                *expression);
+static gchar       *custom_extract_regex     (SoupMessage                *msg,
+                                              const gchar                *pattern);
+static gchar       *custom_extract_link      (ScreenshooterCustomUpload  *custom,
+                                              SoupMessage                *msg);
+static void         cb_job_progress          (goffset                     sent,
+                                              goffset                     total,
+                                              gdouble                     elapsed,
+                                              ScreenshooterJob           *job);
+static gboolean     custom_upload_job        (ScreenshooterJob           *job,
+                                              GArray                     *param_values,
+                                              GError                    **error);
+
+
+
+/* Internals */
+
+
+
+static SoupMessage
+*custom_build_message (ScreenshooterCustomUpload  *custom,
+                       SoupSession                *session,
+                       const gchar                *image_path,
+                       const gchar                *mime_type,
+                       const gchar                *title,
+                       GError                    **error)
+{
+  ScreenshooterStreamBody *body = screenshooter_stream_body_new ();
+  SoupMessage *msg;
+  gchar *boundary = NULL;
+  gchar **header;
+
+  msg = soup_message_new (custom->method, custom->url);
+
+  if (msg == NULL)
+    {
+      g_set_error (error, SOUP_HTTP_ERROR, SOUP_STATUS_MALFORMED,
+                   _("%s is not a valid URL."), custom->url);
+      screenshooter_stream_body_free (body);
+
+      return NULL;
+    }
+
+  if (custom->multipart)
+    {
+      gchar *file_name = g_path_get_basename (image_path);
+      gchar *part;
+
+      boundary = g_strdup_printf ("screenshooter-%08x%08x",
+                                  g_random_int (), g_random_int ());
+
+      if (custom->title_field != NULL && title != NULL && *title != '\0')
+        {
+          part = g_strdup_printf ("--%s\r\n"
+                                  "Content-Disposition: form-data; name=\"%s\"\r\n"
+                                  "\r\n%s\r\n",
+                                  boundary, custom->title_field, title);
+          screenshooter_stream_body_append_data (body, part, -1);
+          g_free (part);
+        }
+
+      part = g_strdup_printf ("--%s\r\n"
+                              "Content-Disposition: form-data; name=\"%s\"; "
+                              "filename=\"%s\"\r\n"
+                              "Content-Type: %s\r\n\r\n",
+                              boundary, custom->field, file_name, mime_type);
+      screenshooter_stream_body_append_data (body, part, -1);
+      g_free (part);
+      g_free (file_name);
+    }
+
+  if (!screenshooter_stream_body_append_file (body, image_path, FALSE, error))
+    {
+      screenshooter_stream_body_free (body);
+      g_object_unref (msg);
+      g_free (boundary);
+
+      return NULL;
+    }
+
+  for (header = custom->headers; header != NULL && *header != NULL; header++)
+    {
+      gchar **pair = g_strsplit (*header, ":", 2);
+
+      if (pair[0] != NULL && pair[1] != NULL)
+        soup_message_headers_append (msg->request_headers,
+                                     g_strstrip (pair[0]),
+                                     g_strstrip (pair[1]));
+
+      g_strfreev (pair);
+    }
+
+  if (custom->multipart)
+    {
+      gchar *content_type, *end;
+
+      end = g_strdup_printf ("\r\n--%s--\r\n", boundary);
+      screenshooter_stream_body_append_data (body, end, -1);
+      g_free (end);
+
+      content_type = g_strdup_printf ("multipart/form-data; boundary=%s",
+                                      boundary);
+      screenshooter_stream_body_attach (body, session, msg, content_type);
+      g_free (content_type);
+      g_free (boundary);
+    }
+  else
+    screenshooter_stream_body_attach (body, session, msg, mime_type);
+
+  return msg;
+}
+
+
+
+static gchar
+*custom_extract_xpath (SoupMessage *msg, const gchar *expression)
+{
+  xmlDoc *doc;
+  xmlXPathContext *context;
+  xmlXPathObject *result = NULL;
+  gchar *link = NULL;
+
+  doc = xmlParseMemory (msg->response_body->data, msg->response_body->length);
+
+  if (doc == NULL)
+    return NULL;
+
+  context = xmlXPathNewContext (doc);
+
+  if (context != NULL)
+    result = xmlXPathEvalExpression ((const xmlChar *) expression, context);
+
+  if (result != NULL)
+    {
+      xmlChar *value = xmlXPathCastToString (result);
+
+      link = g_strdup ((const gchar *) value);
+      xmlFree (value);
+      xmlXPathFreeObject (result);
+    }
+
+  if (context != NULL)
+    xmlXPathFreeContext (context);
+
+  xmlFreeDoc (doc);
+
+  return link;
+}
+
+
+
+static gchar
+*custom_extract_regex (SoupMessage *msg, const gchar *pattern)
+{
+  GRegex *regex;
+  GMatchInfo *match_info;
+  gchar *body, *link = NULL;
+
+  regex = g_regex_new (pattern, 0, 0, NULL);
+
+  if (regex == NULL)
+    return NULL;
+
+  body = g_strndup (msg->response_body->data, msg->response_body->length);
+
+  if (g_regex_match (regex, body, 0, &match_info))
+    link = g_match_info_fetch (match_info,
+                               g_regex_get_capture_count (regex) > 0 ? 1 : 0);
+
+  g_match_info_free (match_info);
+  g_regex_unref (regex);
+  g_free (body);
+
+  return link;
+}
+
+
+
+static gchar
+*custom_extract_link (ScreenshooterCustomUpload *custom, SoupMessage *msg)
+{
+  const gchar *response = custom->response;
+  gchar *link;
+
+  if (response == NULL || *response == '\0')
+    link = g_strndup (msg->response_body->data, msg->response_body->length);
+  else if (g_str_has_prefix (response, "xpath:"))
+    link = custom_extract_xpath (msg, response + strlen ("xpath:"));
+  else if (g_str_has_prefix (response, "regex:"))
+    link = custom_extract_regex (msg, response + strlen ("regex:"));
+  else if (g_str_has_prefix (response, "header:"))
+    link = g_strdup (soup_message_headers_get_one (msg->response_headers,
+                                                   response + strlen ("header:")));
+  else
+    {
+      TRACE ("Unknown response format: %s", response);
+      link = NULL;
+    }
+
+  if (link != NULL && *g_strstrip (link) == '\0')
+    {
+      g_free (link);
+      link = NULL;
+    }
+
+  return link;
+}
+
+
+
+static void
+cb_job_progress (goffset sent, goffset total, gdouble elapsed, ScreenshooterJob *job)
+{
+  screenshooter_job_upload_progress (job, sent, total, elapsed);
+}
+
+
+
+static gboolean
+custom_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  ScreenshooterCustomUpload *custom;
+  ScreenshooterUploadTimings timings;
+  const gchar *image_path, *title;
+  gchar *link = NULL;
+
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), FALSE);
+  g_return_val_if_fail (param_values != NULL, FALSE);
+  g_return_val_if_fail (param_values->len == 3, FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (g_array_index(param_values, GValue*, 0))), FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (g_array_index(param_values, GValue*, 1))), FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_POINTER (g_array_index(param_values, GValue*, 2))), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_object_set_data (G_OBJECT (job), "jobtype", "custom");
+  if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+    return FALSE;
+
+  image_path = g_value_get_string (g_array_index (param_values, GValue*, 0));
+  title = g_value_get_string (g_array_index (param_values, GValue*, 1));
+  custom = g_value_get_pointer (g_array_index (param_values, GValue*, 2));
+
+  g_object_set_data_full (G_OBJECT (job), "service", g_strdup (custom->name), g_free);
+
+  exo_job_info_message (EXO_JOB (job), _("Upload the screenshot..."));
+
+  if (!screenshooter_custom_upload_file_full (custom, image_path, title, &link,
+                                              (ScreenshooterUploadProgressFunc) cb_job_progress,
+                                              job, &timings, error))
+    return FALSE;
+
+  g_object_set_data_full (G_OBJECT (job), "timings",
+                          screenshooter_upload_timings_to_string (&timings),
+                          g_free);
+  screenshooter_job_image_uploaded (job, link);
+  g_free (link);
+
+  return TRUE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_custom_upload_warm_up:
+ * @custom: a #ScreenshooterCustomUpload.
+ *
+ * Opens a connection to the service while the screenshot is taken, see
+ * screenshooter_upload_session_warm_up().
+ **/
+void
+screenshooter_custom_upload_warm_up (ScreenshooterCustomUpload *custom)
+{
+  g_return_if_fail (custom != NULL);
+
+  screenshooter_upload_session_warm_up (custom->url);
+}
+
+
+
+/**
+ * screenshooter_custom_upload_file:
+ * @custom: a #ScreenshooterCustomUpload.
+ * @image_path: the local path of the image to upload.
+ * @title: the title of the image.
+ * @link: return location for the link to the uploaded image.
+ * @error: return location for errors.
+ *
+ * Uploads the image whose path is @image_path to the service described
+ * by @custom, and waits for the answer, see
+ * screenshooter_custom_upload_file_full().
+ *
+ * Return value: %TRUE if the image was uploaded. @link should then be
+ * freed with g_free().
+ **/
+gboolean
+screenshooter_custom_upload_file (ScreenshooterCustomUpload  *custom,
+                                  const gchar                *image_path,
+                                  const gchar                *title,
+                                  gchar                     **link,
+                                  GError                    **error)
+{
+  return screenshooter_custom_upload_file_full (custom, image_path, title,
+                                                link, NULL, NULL, NULL,
+                                                error);
+}
+
+
+
+/**
+ * screenshooter_custom_upload_file_full:
+ * @custom: a #ScreenshooterCustomUpload.
+ * @image_path: the local path of the image to upload.
+ * @title: the title of the image.
+ * @link: return location for the link to the uploaded image.
+ * @progress: function called regularly while the image is sent, or %NULL.
+ * @user_data: data passed to @progress.
+ * @timings: return location for the timings of the upload, or %NULL.
+ * @error: return location for errors.
+ *
+ * Uploads the image whose path is @image_path to the service described
+ * by @custom, and waits for the answer. This can be called from any
+ * thread.
+ *
+ * Return value: %TRUE if the image was uploaded. @link should then be
+ * freed with g_free().
+ **/
+gboolean
+screenshooter_custom_upload_file_full (ScreenshooterCustomUpload        *custom,
+                                       const gchar                      *image_path,
+                                       const gchar                      *title,
+                                       gchar                           **link,
+                                       ScreenshooterUploadProgressFunc   progress,
+                                       gpointer                          user_data,
+                                       ScreenshooterUploadTimings       *timings,
+                                       GError                          **error)
+{
+  ScreenshooterUploadTimings upload_timings;
+  SoupSession *session;
+  SoupMessage *msg;
+  const gchar *mime_type;
+  gchar *upload_path = NULL;
+  GTimer *timer;
+
+  g_return_val_if_fail (custom != NULL, FALSE);
+  g_return_val_if_fail (image_path != NULL, FALSE);
+  g_return_val_if_fail (link != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (!screenshooter_transcode_for_upload (image_path, &custom->limits,
+                                           &upload_path, &mime_type, error))
+    return FALSE;
+
+  session = screenshooter_upload_session_get ();
+  msg = custom_build_message (custom, session,
+                              upload_path != NULL ? upload_path : image_path,
+                              mime_type, title, error);
+
+  if (upload_path != NULL)
+    {
+      /* The body holds the file open */
+      g_unlink (upload_path);
+      g_free (upload_path);
+    }
+
+  if (msg == NULL)
+    {
+      g_object_unref (session);
+
+      return FALSE;
+    }
+
+  TRACE ("%s %s", custom->method, custom->url);
+
+  screenshooter_upload_session_send (session, msg, progress, user_data,
+                                     &upload_timings);
+  g_object_unref (session);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+    {
+      TRACE ("Error during the upload: %d %s",
+             msg->status_code, msg->reason_phrase);
+
+      g_set_error (error, SOUP_HTTP_ERROR, msg->status_code,
+                   _("An error occurred while transferring the data"
+                     " to %s."), custom->name);
+      g_object_unref (msg);
+
+      return FALSE;
+    }
+
+  timer = g_timer_new ();
+  *link = custom_extract_link (custom, msg);
+  upload_timings.phases[SCREENSHOOTER_UPLOAD_PHASE_PARSE] =
+    g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+  g_object_unref (msg);
+
+  if (*link == NULL)
+    {
+      g_set_error (error, SOUP_HTTP_ERROR, SOUP_STATUS_MALFORMED,
+                   _("The link to the screenshot could not be found in the"
+                     " answer of %s."), custom->name);
+
+      return FALSE;
+    }
+
+  TRACE ("Uploaded to %s", *link);
+
+  screenshooter_upload_timings_report (custom->name, &upload_timings);
+
+  if (timings != NULL)
+    *timings = upload_timings;
+
+  return TRUE;
+}
+
+
+
+/**
+ * screenshooter_upload_to_custom:
+ * @image_path: the local path of the image that should be uploaded.
+ * @title: the title of the image.
+ * @custom: the service to upload to.
+ *
+ * Uploads the image whose path is @image_path to the service described by
+ * @custom, and shows the link to the uploaded image.
+ **/
+void
+screenshooter_upload_to_custom (const gchar               *image_path,
+                                const gchar               *title,
+                                ScreenshooterCustomUpload *custom)
+{
+  ScreenshooterJob *job;
+  GtkWidget *dialog, *label;
+
+  g_return_if_fail (image_path != NULL);
+  g_return_if_fail (custom != NULL);
+
+  dialog = create_throbber_dialog (custom->name, &label);
+
+  job = screenshooter_simple_job_launch (custom_upload_job, 3,
+                                         G_TYPE_STRING, image_path,
+                                         G_TYPE_STRING, title,
+                                         G_TYPE_POINTER, custom);
+
+  g_signal_connect (job, "ask", G_CALLBACK (cb_ask_for_information), NULL);
+  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_uploaded), NULL);
+  g_signal_connect (job, "error", G_CALLBACK (cb_error), NULL);
+  g_signal_connect (job, "finished", G_CALLBACK (cb_finished), dialog);
+  g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+
+  gtk_dialog_run (GTK_DIALOG (dialog));
+}
@@ -0,0 +1,53 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_CUSTOM_UPLOAD_SEND_H__
+#define __HAVE_CUSTOM_UPLOAD_SEND_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "screenshooter-custom-upload.h"
+#include "screenshooter-utils.h"
+#include "screenshooter-simple-job.h"
+#include "katze-throbber.h"
+#include "screenshooter-upload-session.h"
+
+void                       screenshooter_custom_upload_warm_up     (ScreenshooterCustomUpload *custom);
+gboolean                   screenshooter_custom_upload_file        (ScreenshooterCustomUpload *custom,
+                                                                    const gchar               *image_path,
+                                                                    const gchar               *title,
+                                                                    gchar                    **link,
+                                                                    GError                   **error);
+gboolean                   screenshooter_custom_upload_file_full   (ScreenshooterCustomUpload        *custom,
+                                                                    const gchar                      *image_path,
+                                                                    const gchar                      *title,
+                                                                    gchar                           **link,
+                                                                    ScreenshooterUploadProgressFunc   progress,
+                                                                    gpointer                          user_data,
+                                                                    ScreenshooterUploadTimings       *timings,
+                                                                    GError                          **error);
+void                       screenshooter_upload_to_custom          (const gchar               *image_path,
+                                                                    const gchar               *title,
+                                                                    ScreenshooterCustomUpload *custom);
+
+#endif
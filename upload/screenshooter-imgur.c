@@ -0,0 +1,736 @@
+/*  $Id$
+ *
+ *  Copyright © 2009-2010 Sebastian Waisbrot <seppo0010@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+
+#include "screenshooter-imgur.h"
+#include "screenshooter-job-callbacks.h"
+#include "screenshooter-upload-session.h"
+#include "screenshooter-upload-queue.h"
+#include "screenshooter-upload-cache.h"
+#include "screenshooter-transcode.h"
+#include "screenshooter-stream-body.h"
+#include <string.h>
+#include <stdlib.h>
+#include <libsoup/soup.h>
+#include <libxml/parser.h>
+#include <glib/gstdio.h>
+
+/* Larger PNG files are converted to JPEG by imgur, do it with a better
+ * quality before sending them */
+static const ScreenshooterUploadLimits imgur_limits =
+  { 5 * 1024 * 1024, 0, "png,jpeg" };
+
+/* Number of images of an album uploaded at the same time */
+#define IMGUR_ALBUM_PARALLEL 4
+
+/* State of the upload of the images of an album */
+typedef struct
+{
+  gchar       **image_paths;
+  const gchar  *title;
+  gchar       **delete_hashes;
+  gint          uploaded;
+  gint          remaining;
+  GError       *error;
+}
+ImgurAlbum;
+
+
+
+G_LOCK_DEFINE_STATIC (imgur_album);
+
+
+
+static const gchar      *imgur_get_upload_url      (void);
+static void              imgur_parse_response      (SoupMessage       *msg,
+                                                    gchar            **id,
+                                                    gchar            **delete_hash,
+                                                    gchar            **link);
+static void              cb_job_progress           (goffset            sent,
+                                                    goffset            total,
+                                                    gdouble            elapsed,
+                                                    ScreenshooterJob  *job);
+static gboolean          imgur_upload_job          (ScreenshooterJob  *job,
+                                                    GArray            *param_values,
+                                                    GError           **error);
+static void              imgur_album_upload_image  (gpointer           data,
+                                                    ImgurAlbum        *album);
+static gboolean          imgur_album_job           (ScreenshooterJob  *job,
+                                                    GArray            *param_values,
+                                                    GError           **error);
+
+
+
+/* Internals */
+
+
+
+static const gchar
+*imgur_get_upload_url (void)
+{
+  /* Allows to point the uploads to a local test server */
+  const gchar *url = g_getenv ("SCREENSHOOTER_IMGUR_URL");
+
+  return (url != NULL && *url != '\0') ? url : IMGUR_UPLOAD_URL;
+}
+
+
+
+/* Reads the id, the deletehash and, if @link is not %NULL, the link of an
+ * image or of an album */
+static void
+imgur_parse_response (SoupMessage *msg, gchar **id, gchar **delete_hash,
+                      gchar **link)
+{
+  xmlDoc *doc;
+  xmlNode *root_node, *child_node;
+
+  TRACE("response was %s\n", msg->response_body->data);
+  /* returned XML is like <data type="array" success="1" status="200"><id>xxxxxx</id> */
+  doc = xmlParseMemory (msg->response_body->data, msg->response_body->length);
+  root_node = doc != NULL ? xmlDocGetRootElement (doc) : NULL;
+
+  if (root_node != NULL)
+    for (child_node = root_node->children; child_node; child_node = child_node->next)
+      {
+        if (xmlStrEqual(child_node->name, (const xmlChar *) "id"))
+          *id = (gchar*)xmlNodeGetContent(child_node);
+        else if (xmlStrEqual(child_node->name, (const xmlChar *) "deletehash"))
+          *delete_hash = (gchar*)xmlNodeGetContent(child_node);
+        else if (link != NULL &&
+                 xmlStrEqual(child_node->name, (const xmlChar *) "link"))
+          *link = (gchar*)xmlNodeGetContent(child_node);
+      }
+
+  if (doc != NULL)
+    xmlFreeDoc(doc);
+}
+
+
+
+static void
+cb_job_progress (goffset sent, goffset total, gdouble elapsed, ScreenshooterJob *job)
+{
+  screenshooter_job_upload_progress (job, sent, total, elapsed);
+}
+
+
+
+static gboolean
+imgur_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  const gchar *image_path, *title;
+  gchar *online_file_name = NULL;
+  gchar *delete_hash = NULL;
+  gchar *link = NULL;
+
+  ScreenshooterUploadTimings timings = { { 0, }, };
+  GError *tmp_error = NULL;
+
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), FALSE);
+  g_return_val_if_fail (param_values != NULL, FALSE);
+  g_return_val_if_fail (param_values->len == 2, FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (g_array_index(param_values, GValue*, 0))), FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (g_array_index(param_values, GValue*, 1))), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_object_set_data (G_OBJECT (job), "jobtype", "imgur");
+  if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+    return FALSE;
+
+  image_path = g_value_get_string (g_array_index (param_values, GValue*, 0));
+  title = g_value_get_string (g_array_index (param_values, GValue*, 1));
+
+  exo_job_info_message (EXO_JOB (job), _("Upload the screenshot..."));
+
+  if (!screenshooter_imgur_upload_file_full (image_path, title,
+                                             &online_file_name, &delete_hash, &link,
+                                             (ScreenshooterUploadProgressFunc) cb_job_progress,
+                                             job, &timings, &tmp_error))
+    {
+      /* Keep the screenshot if imgur could not be reached, it will be
+       * uploaded again later */
+      if (screenshooter_upload_queue_is_transient_error (tmp_error) &&
+          screenshooter_upload_queue_add ("imgur", image_path, title,
+                                          tmp_error->message, NULL))
+        {
+          GError *queued_error =
+            g_error_new (tmp_error->domain, tmp_error->code,
+                         _("%s\nThe screenshot was added to the upload queue,"
+                           " it will be uploaded when imgur is reachable."),
+                         tmp_error->message);
+
+          g_error_free (tmp_error);
+          tmp_error = queued_error;
+        }
+
+      g_propagate_error (error, tmp_error);
+
+      return FALSE;
+    }
+
+  g_object_set_data_full (G_OBJECT (job), "deletehash", delete_hash, g_free);
+  g_object_set_data_full (G_OBJECT (job), "link", link, g_free);
+
+  /* Nothing was sent when the link came from the cache */
+  if (timings.sent > 0)
+    g_object_set_data_full (G_OBJECT (job), "timings",
+                            screenshooter_upload_timings_to_string (&timings),
+                            g_free);
+
+  screenshooter_job_image_uploaded (job, online_file_name);
+
+  return TRUE;
+}
+
+
+
+/* Thread function of the pool of the album job */
+static void
+imgur_album_upload_image (gpointer data, ImgurAlbum *album)
+{
+  gint i = GPOINTER_TO_INT (data) - 1;
+  gchar *id = NULL, *delete_hash = NULL;
+  GError *error = NULL;
+  gboolean failed;
+
+  G_LOCK (imgur_album);
+  failed = album->error != NULL;
+  G_UNLOCK (imgur_album);
+
+  /* The album will not be created anyway */
+  if (failed)
+    goto out;
+
+  if (screenshooter_imgur_upload_file (album->image_paths[i], album->title,
+                                       &id, &delete_hash, NULL, &error) &&
+      delete_hash == NULL)
+    {
+      /* Images are added to anonymous albums with their deletehash */
+      g_set_error (&error, SOUP_HTTP_ERROR, SOUP_STATUS_MALFORMED,
+                   _("%s cannot be added to an album, upload it again"
+                     " with --no-cache."), album->image_paths[i]);
+    }
+
+  G_LOCK (imgur_album);
+
+  if (error == NULL)
+    {
+      album->delete_hashes[i] = delete_hash;
+      album->uploaded++;
+    }
+  else if (album->error == NULL)
+    album->error = error;
+  else
+    g_error_free (error);
+
+  G_UNLOCK (imgur_album);
+
+  g_free (id);
+
+out:
+  g_atomic_int_add (&album->remaining, -1);
+}
+
+
+
+static gboolean
+imgur_album_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  ImgurAlbum album = { NULL, };
+  GThreadPool *pool;
+  gchar *album_id = NULL;
+  gint n_images, reported = -1, i;
+
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), FALSE);
+  g_return_val_if_fail (param_values != NULL, FALSE);
+  g_return_val_if_fail (param_values->len == 2, FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS (g_array_index(param_values, GValue*, 0), G_TYPE_STRV)), FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (g_array_index(param_values, GValue*, 1))), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_object_set_data (G_OBJECT (job), "jobtype", "imgur-album");
+  if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+    return FALSE;
+
+  album.image_paths = g_value_get_boxed (g_array_index (param_values, GValue*, 0));
+  album.title = g_value_get_string (g_array_index (param_values, GValue*, 1));
+
+  n_images = g_strv_length (album.image_paths);
+  album.delete_hashes = g_new0 (gchar *, n_images + 1);
+  album.remaining = n_images;
+
+  /* Upload the images over the connections of the shared session */
+  pool = g_thread_pool_new ((GFunc) imgur_album_upload_image, &album,
+                            MIN (n_images, IMGUR_ALBUM_PARALLEL), FALSE, NULL);
+
+  for (i = 0; i < n_images; i++)
+    g_thread_pool_push (pool, GINT_TO_POINTER (i + 1), NULL);
+
+  while (g_atomic_int_get (&album.remaining) > 0)
+    {
+      gint uploaded;
+
+      G_LOCK (imgur_album);
+      uploaded = album.uploaded;
+      G_UNLOCK (imgur_album);
+
+      if (uploaded != reported)
+        {
+          exo_job_info_message (EXO_JOB (job),
+                                _("Uploaded %d of %d screenshots..."),
+                                uploaded, n_images);
+          reported = uploaded;
+        }
+
+      g_usleep (G_USEC_PER_SEC / 5);
+    }
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  if (album.error == NULL)
+    {
+      exo_job_info_message (EXO_JOB (job), _("Create the album..."));
+      screenshooter_imgur_create_album (album.delete_hashes, album.title,
+                                        &album_id, &album.error);
+    }
+
+  g_strfreev (album.delete_hashes);
+
+  if (album.error != NULL)
+    {
+      g_propagate_error (error, album.error);
+
+      return FALSE;
+    }
+
+  screenshooter_job_image_uploaded (job, album_id);
+  g_free (album_id);
+
+  return TRUE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_imgur_upload_file:
+ * @image_path: the local path of the image to upload.
+ * @title: the title of the image.
+ * @id: return location for the imgur id of the image.
+ * @delete_hash: return location for the hash allowing to delete the image,
+ * or %NULL.
+ * @link: return location for the link to the image, or %NULL.
+ * @error: return location for errors.
+ *
+ * Uploads the image whose path is @image_path to imgur and waits for the
+ * answer, see screenshooter_imgur_upload_file_full().
+ *
+ * Return value: %TRUE if the image was uploaded. @id, @delete_hash and
+ * @link should then be freed with g_free().
+ **/
+gboolean
+screenshooter_imgur_upload_file (const gchar  *image_path,
+                                 const gchar  *title,
+                                 gchar       **id,
+                                 gchar       **delete_hash,
+                                 gchar       **link,
+                                 GError      **error)
+{
+  return screenshooter_imgur_upload_file_full (image_path, title, id,
+                                               delete_hash, link, NULL, NULL,
+                                               NULL, error);
+}
+
+
+
+/**
+ * screenshooter_imgur_upload_file_full:
+ * @image_path: the local path of the image to upload.
+ * @title: the title of the image.
+ * @id: return location for the imgur id of the image.
+ * @delete_hash: return location for the hash allowing to delete the image,
+ * or %NULL.
+ * @link: return location for the link to the image, or %NULL. Its
+ * extension is the one of the format actually sent, which may not be the
+ * one of @image_path.
+ * @progress: function called regularly while the image is sent, or %NULL.
+ * @user_data: data passed to @progress.
+ * @timings: return location for the timings of the upload, or %NULL.
+ * @error: return location for errors.
+ *
+ * Uploads the image whose path is @image_path to imgur and waits for the
+ * answer. If an image with the same contents was already uploaded, its
+ * link is returned from the upload cache without any request, and
+ * @timings is left untouched. This can be called from any thread, the
+ * errors from the HTTP exchange are in the #SOUP_HTTP_ERROR domain with
+ * the status code of the message.
+ *
+ * Return value: %TRUE if the image was uploaded. @id, @delete_hash and
+ * @link should then be freed with g_free().
+ **/
+gboolean
+screenshooter_imgur_upload_file_full (const gchar                      *image_path,
+                                      const gchar                      *title,
+                                      gchar                           **id,
+                                      gchar                           **delete_hash,
+                                      gchar                           **link,
+                                      ScreenshooterUploadProgressFunc   progress,
+                                      gpointer                          user_data,
+                                      ScreenshooterUploadTimings       *timings,
+                                      GError                          **error)
+{
+  ScreenshooterUploadTimings upload_timings;
+  ScreenshooterStreamBody *body;
+  gchar *online_file_name = NULL;
+  gchar *online_delete_hash = NULL;
+  gchar *online_link = NULL;
+  gchar *hash, *upload_path = NULL;
+  gchar *boundary, *part, *file_name, *content_type;
+  const gchar *mime_type;
+  gboolean appended;
+  GTimer *timer;
+
+  SoupSession *session;
+  SoupMessage *msg;
+
+  g_return_val_if_fail (image_path != NULL, FALSE);
+  g_return_val_if_fail (id != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* The image may have been uploaded already */
+  hash = screenshooter_upload_cache_hash_file (image_path, NULL);
+
+  if (hash != NULL &&
+      screenshooter_upload_cache_lookup ("imgur", hash, id, delete_hash, link))
+    {
+      TRACE ("%s was already uploaded as %s", image_path, *id);
+      g_free (hash);
+
+      return TRUE;
+    }
+
+  /* The cache is keyed on the original file, convert it afterwards */
+  if (!screenshooter_transcode_for_upload (image_path, &imgur_limits,
+                                           &upload_path, &mime_type, error))
+    {
+      g_free (hash);
+
+      return FALSE;
+    }
+
+  /* The file is streamed, so the progress is known chunk by chunk */
+  body = screenshooter_stream_body_new ();
+  boundary = g_strdup_printf ("screenshooter-%08x%08x",
+                              g_random_int (), g_random_int ());
+  file_name = g_path_get_basename (image_path);
+
+  part = g_strdup_printf ("--%s\r\n"
+                          "Content-Disposition: form-data; name=\"image\"; "
+                          "filename=\"%s\"\r\n"
+                          "Content-Type: %s\r\n\r\n",
+                          boundary, file_name, mime_type);
+  screenshooter_stream_body_append_data (body, part, -1);
+  g_free (part);
+  g_free (file_name);
+
+  appended =
+    screenshooter_stream_body_append_file (body,
+                                           upload_path != NULL ? upload_path : image_path,
+                                           FALSE, error);
+
+  if (upload_path != NULL)
+    {
+      /* The body holds the file open */
+      g_unlink (upload_path);
+      g_free (upload_path);
+    }
+
+  if (!appended)
+    {
+      screenshooter_stream_body_free (body);
+      g_free (boundary);
+      g_free (hash);
+
+      return FALSE;
+    }
+
+  part = g_strdup_printf ("\r\n--%s\r\n"
+                          "Content-Disposition: form-data; name=\"name\"\r\n\r\n%s"
+                          "\r\n--%s\r\n"
+                          "Content-Disposition: form-data; name=\"title\"\r\n\r\n%s"
+                          "\r\n--%s--\r\n",
+                          boundary, title != NULL ? title : "",
+                          boundary, title != NULL ? title : "",
+                          boundary);
+  screenshooter_stream_body_append_data (body, part, -1);
+  g_free (part);
+
+  /* Connections to imgur are kept alive between uploads */
+  session = screenshooter_upload_session_get ();
+
+  msg = soup_message_new ("POST", imgur_get_upload_url ());
+  content_type = g_strdup_printf ("multipart/form-data; boundary=%s", boundary);
+  screenshooter_stream_body_attach (body, session, msg, content_type);
+  g_free (content_type);
+  g_free (boundary);
+
+  // for v3 API - key registered *only* for xfce4-screenshooter!
+  // as this is xfce4-screenshooter fork, API key stays the same
+  soup_message_headers_append (msg->request_headers, "Authorization", "Client-ID 66ab680b597e293");
+  screenshooter_upload_session_send (session, msg, progress, user_data,
+                                     &upload_timings);
+  g_object_unref (session);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+    {
+      TRACE ("Error during the POST exchange: %d %s\n",
+             msg->status_code, msg->reason_phrase);
+
+      g_set_error (error, SOUP_HTTP_ERROR, msg->status_code,
+                   _("An error occurred while transferring the data"
+                     " to imgur."));
+      g_object_unref (msg);
+      g_free (hash);
+
+      return FALSE;
+    }
+
+  timer = g_timer_new ();
+  imgur_parse_response (msg, &online_file_name, &online_delete_hash,
+                        &online_link);
+  upload_timings.phases[SCREENSHOOTER_UPLOAD_PHASE_PARSE] =
+    g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  TRACE("found picture id %s\n", online_file_name);
+  g_object_unref (msg);
+
+  if (online_file_name == NULL)
+    {
+      g_set_error (error, SOUP_HTTP_ERROR, SOUP_STATUS_MALFORMED,
+                   _("An error occurred while transferring the data"
+                     " to imgur."));
+      g_free (online_delete_hash);
+      g_free (online_link);
+      g_free (hash);
+
+      return FALSE;
+    }
+
+  /* The link has the extension of the format which was sent */
+  if (online_link == NULL)
+    online_link = g_strdup_printf ("http://i.imgur.com/%s.%s", online_file_name,
+                                   g_strcmp0 (mime_type, "image/jpeg") == 0 ?
+                                   "jpg" : "png");
+
+  screenshooter_upload_timings_report ("imgur", &upload_timings);
+
+  if (timings != NULL)
+    *timings = upload_timings;
+
+  if (hash != NULL)
+    {
+      screenshooter_upload_cache_store ("imgur", hash, online_file_name,
+                                        online_delete_hash, online_link);
+      g_free (hash);
+    }
+
+  *id = online_file_name;
+
+  if (delete_hash != NULL)
+    *delete_hash = online_delete_hash;
+  else
+    g_free (online_delete_hash);
+
+  if (link != NULL)
+    *link = online_link;
+  else
+    g_free (online_link);
+
+  return TRUE;
+}
+
+
+
+/**
+ * screenshooter_imgur_create_album:
+ * @delete_hashes: a %NULL-terminated array of the deletehashes of the
+ * images of the album.
+ * @title: the title of the album.
+ * @id: return location for the imgur id of the album.
+ * @error: return location for errors.
+ *
+ * Creates an anonymous album holding the images whose deletehashes are
+ * given, in this order.
+ *
+ * Return value: %TRUE if the album was created. @id should then be freed
+ * with g_free().
+ **/
+gboolean
+screenshooter_imgur_create_album (gchar       **delete_hashes,
+                                  const gchar  *title,
+                                  gchar       **id,
+                                  GError      **error)
+{
+  SoupSession *session;
+  SoupMessage *msg;
+  gchar *joined, *album_delete_hash = NULL;
+
+  g_return_val_if_fail (delete_hashes != NULL, FALSE);
+  g_return_val_if_fail (id != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  joined = g_strjoinv (",", delete_hashes);
+  msg = soup_form_request_new ("POST", IMGUR_ALBUM_URL,
+                               "deletehashes", joined,
+                               "title", title != NULL ? title : "",
+                               NULL);
+  g_free (joined);
+
+  soup_message_headers_append (msg->request_headers, "Authorization", "Client-ID 66ab680b597e293");
+
+  session = screenshooter_upload_session_get ();
+  soup_session_send_message (session, msg);
+  g_object_unref (session);
+
+  *id = NULL;
+
+  if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+    imgur_parse_response (msg, id, &album_delete_hash, NULL);
+  else
+    TRACE ("Error during the album creation: %d %s\n",
+           msg->status_code, msg->reason_phrase);
+
+  if (*id == NULL)
+    g_set_error (error, SOUP_HTTP_ERROR,
+                 SOUP_STATUS_IS_SUCCESSFUL (msg->status_code) ?
+                 SOUP_STATUS_MALFORMED : msg->status_code,
+                 _("An error occurred while creating the album on imgur."));
+
+  g_free (album_delete_hash);
+  g_object_unref (msg);
+
+  return *id != NULL;
+}
+
+
+
+/**
+ * screenshooter_upload_to_imgur:
+ * @image_path: the local path of the image that should be uploaded to
+ * imgur.com.
+ *
+ * Uploads the image whose path is @image_path
+ *
+ **/
+
+void screenshooter_upload_to_imgur   (const gchar  *image_path,
+                                      const gchar  *title)
+{
+  ScreenshooterJob *job;
+  GtkWidget *dialog, *label;
+
+  g_return_if_fail (image_path != NULL);
+
+  dialog = create_throbber_dialog(_("Imgur"), &label);
+
+  job = screenshooter_simple_job_launch (imgur_upload_job, 2,
+                                          G_TYPE_STRING, image_path,
+                                          G_TYPE_STRING, title);
+
+  g_signal_connect (job, "ask", G_CALLBACK (cb_ask_for_information), NULL);
+  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_uploaded), NULL);
+  g_signal_connect (job, "error", G_CALLBACK (cb_error), NULL);
+  g_signal_connect (job, "finished", G_CALLBACK (cb_finished), dialog);
+  g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+
+  gtk_dialog_run (GTK_DIALOG (dialog));
+}
+
+
+/**
+ * screenshooter_upload_to_imgur_copy_link:
+ * @image_path: the local path of the image that should be uploaded to
+ * imgur.com.
+ *
+ * Uploads the image whose path is @image_path and copies link to clipboard
+ *
+ **/
+
+void screenshooter_upload_to_imgur_copy_link   (const gchar  *image_path,
+                                      const gchar  *title)
+{
+  ScreenshooterJob *job;
+  GtkWidget *dialog, *label;
+
+  g_return_if_fail (image_path != NULL);
+
+  dialog = create_throbber_dialog(_("Imgur"), &label);
+
+  job = screenshooter_simple_job_launch (imgur_upload_job, 2,
+                                          G_TYPE_STRING, image_path,
+                                          G_TYPE_STRING, title);
+
+  g_signal_connect (job, "ask", G_CALLBACK (cb_ask_for_information), NULL);
+  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_uploaded_to_imgur_to_copy), NULL);
+  g_signal_connect (job, "error", G_CALLBACK (cb_error), NULL);
+  g_signal_connect (job, "finished", G_CALLBACK (cb_finished_base), dialog);
+  g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+
+  gtk_dialog_run (GTK_DIALOG (dialog));
+}
+
+
+
+/**
+ * screenshooter_upload_to_imgur_album:
+ * @image_paths: a %NULL-terminated array of the local paths of the images.
+ * @title: the title of the album and of the images.
+ *
+ * Uploads the images concurrently, puts them in a new album and shows the
+ * link to the album. A single dialog shows the progress of all the
+ * uploads.
+ **/
+void
+screenshooter_upload_to_imgur_album (gchar       **image_paths,
+                                     const gchar  *title)
+{
+  ScreenshooterJob *job;
+  GtkWidget *dialog, *label;
+
+  g_return_if_fail (image_paths != NULL && image_paths[0] != NULL);
+
+  dialog = create_throbber_dialog (_("Imgur"), &label);
+
+  job = screenshooter_simple_job_launch (imgur_album_job, 2,
+                                         G_TYPE_STRV, image_paths,
+                                         G_TYPE_STRING, title);
+
+  g_signal_connect (job, "ask", G_CALLBACK (cb_ask_for_information), NULL);
+  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_uploaded), NULL);
+  g_signal_connect (job, "error", G_CALLBACK (cb_error), NULL);
+  g_signal_connect (job, "finished", G_CALLBACK (cb_finished), dialog);
+  g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+
+  gtk_dialog_run (GTK_DIALOG (dialog));
+}
@@ -0,0 +1,69 @@
+/*  $Id$
+ *
+ *  Copyright © 2009 Sebastian Waisbrot <seppo0010@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_IMGUR_H__
+#define __HAVE_IMGUR_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "screenshooter-utils.h"
+#include "screenshooter-simple-job.h"
+#include "katze-throbber.h"
+#include "screenshooter-upload-session.h"
+
+#define IMGUR_UPLOAD_URL "https://api.imgur.com/3/upload.xml"
+#define IMGUR_ALBUM_URL  "https://api.imgur.com/3/album.xml"
+
+gboolean screenshooter_imgur_upload_file (const gchar  *image_path,
+                                          const gchar  *title,
+                                          gchar       **id,
+                                          gchar       **delete_hash,
+                                          gchar       **link,
+                                          GError      **error);
+
+gboolean screenshooter_imgur_upload_file_full (const gchar                      *image_path,
+                                               const gchar                      *title,
+                                               gchar                           **id,
+                                               gchar                           **delete_hash,
+                                               gchar                           **link,
+                                               ScreenshooterUploadProgressFunc   progress,
+                                               gpointer                          user_data,
+                                               ScreenshooterUploadTimings       *timings,
+                                               GError                          **error);
+
+gboolean screenshooter_imgur_create_album (gchar       **delete_hashes,
+                                           const gchar  *title,
+                                           gchar       **id,
+                                           GError      **error);
+
+void screenshooter_upload_to_imgur 				(const gchar  *image_path,
+                                    			 const gchar  *title);
+
+void screenshooter_upload_to_imgur_copy_link 	(const gchar  *image_path,
+                                    			 const gchar  *title);
+
+void screenshooter_upload_to_imgur_album 	(gchar       **image_paths,
+                                         const gchar  *title);
+
+#endif
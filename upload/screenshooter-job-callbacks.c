@@ -376,7 +376,12 @@ void cb_image_uploaded_to_imgur_to_copy (ScreenshooterJob *job,
 
   g_return_if_fail (upload_name != NULL);
 
-  image_url = g_strdup_printf ("http://i.imgur.com/%s.png", upload_name);
+  /* The image may have been sent as a JPEG */
+  image_url = g_strdup (g_object_get_data (G_OBJECT (job), "link"));
+
+  if (image_url == NULL)
+    image_url = g_strdup_printf ("http://i.imgur.com/%s.png", upload_name);
+
   // TODO: copy image_url to clipboard
   screenshooter_copy_text_to_clipboard(image_url);
 }
@@ -394,20 +399,42 @@ void cb_image_uploaded (ScreenshooterJob  *job,
   GtkWidget *html_frame, *bb_frame;
   GtkWidget *links_alignment, *code_alignment;
   GtkWidget *links_box, *code_box;
+  GtkWidget *timings_label;
 
   GtkTextBuffer *html_buffer, *bb_buffer;
 
+  const gchar *timings;
   const gchar *image_url, *thumbnail_url, *small_thumbnail_url;
   const gchar *image_markup, *thumbnail_markup, *small_thumbnail_markup;
   const gchar *html_code, *bb_code;
   gchar *job_type, *title;
   gchar *last_user_temp;
+  gboolean thumbnails = TRUE;
 
   g_return_if_fail (upload_name != NULL);
   job_type = g_object_get_data(G_OBJECT (job), "jobtype");
-  if (!strcmp(job_type, "imgur")) {
+  if (!strcmp(job_type, "custom") || !strcmp(job_type, "s3")) {
+    /* The service gives the link to the image, and no thumbnails */
+    title = g_strdup_printf (_("My screenshot on %s"),
+                             (gchar *) g_object_get_data (G_OBJECT (job), "service"));
+    image_url = g_strdup (upload_name);
+    thumbnail_url = image_url;
+    small_thumbnail_url = image_url;
+    thumbnails = FALSE;
+  } else if (!strcmp(job_type, "imgur-album")) {
+    /* A single link to the page of the album */
+    title = _("My screenshots on Imgur");
+    image_url = g_strdup_printf ("http://imgur.com/a/%s", upload_name);
+    thumbnail_url = image_url;
+    small_thumbnail_url = image_url;
+    thumbnails = FALSE;
+  } else if (!strcmp(job_type, "imgur")) {
     title = _("My screenshot on Imgur");
-    image_url = g_strdup_printf ("http://i.imgur.com/%s.png", upload_name);
+    image_url = g_strdup (g_object_get_data (G_OBJECT (job), "link"));
+
+    if (image_url == NULL)
+      image_url = g_strdup_printf ("http://i.imgur.com/%s.png", upload_name);
+
     thumbnail_url =
       g_strdup_printf ("http://imgur.com/%sl.png", upload_name);
     small_thumbnail_url =
@@ -489,19 +516,22 @@ void cb_image_uploaded (ScreenshooterJob  *job,
   gtk_widget_set_tooltip_text (image_link, image_url);
   gtk_container_add (GTK_CONTAINER (links_box), image_link);
 
-  /* Create the thumbnail link */
-  thumbnail_link = gtk_label_new (NULL);
-  gtk_label_set_markup (GTK_LABEL (thumbnail_link), thumbnail_markup);
-  gtk_misc_set_alignment (GTK_MISC (thumbnail_link), 0, 0);
-  gtk_widget_set_tooltip_text (thumbnail_link, thumbnail_url);
-  gtk_container_add (GTK_CONTAINER (links_box), thumbnail_link);
-
-  /* Create the small thumbnail link */
-  small_thumbnail_link = gtk_label_new (NULL);
-  gtk_label_set_markup (GTK_LABEL (small_thumbnail_link), small_thumbnail_markup);
-  gtk_misc_set_alignment (GTK_MISC (small_thumbnail_link), 0, 0);
-  gtk_widget_set_tooltip_text (small_thumbnail_link, small_thumbnail_url);
-  gtk_container_add (GTK_CONTAINER (links_box), small_thumbnail_link);
+  if (thumbnails)
+    {
+      /* Create the thumbnail link */
+      thumbnail_link = gtk_label_new (NULL);
+      gtk_label_set_markup (GTK_LABEL (thumbnail_link), thumbnail_markup);
+      gtk_misc_set_alignment (GTK_MISC (thumbnail_link), 0, 0);
+      gtk_widget_set_tooltip_text (thumbnail_link, thumbnail_url);
+      gtk_container_add (GTK_CONTAINER (links_box), thumbnail_link);
+
+      /* Create the small thumbnail link */
+      small_thumbnail_link = gtk_label_new (NULL);
+      gtk_label_set_markup (GTK_LABEL (small_thumbnail_link), small_thumbnail_markup);
+      gtk_misc_set_alignment (GTK_MISC (small_thumbnail_link), 0, 0);
+      gtk_widget_set_tooltip_text (small_thumbnail_link, small_thumbnail_url);
+      gtk_container_add (GTK_CONTAINER (links_box), small_thumbnail_link);
+    }
 
   /* Examples bold label */
   example_label = gtk_label_new ("");
@@ -565,6 +595,17 @@ void cb_image_uploaded (ScreenshooterJob  *job,
                                GTK_WRAP_CHAR);
   gtk_container_add (GTK_CONTAINER (bb_frame), bb_code_view);
 
+  /* Timings of the upload, when it was not found in the cache */
+  timings = g_object_get_data (G_OBJECT (job), "timings");
+
+  if (timings != NULL)
+    {
+      timings_label = gtk_label_new (timings);
+      gtk_label_set_line_wrap (GTK_LABEL (timings_label), TRUE);
+      gtk_misc_set_alignment (GTK_MISC (timings_label), 0, 0);
+      gtk_container_add (GTK_CONTAINER (vbox), timings_label);
+    }
+
   /* Show the dialog and run it */
   gtk_widget_show_all (GTK_DIALOG(dialog)->vbox);
   gtk_dialog_run (GTK_DIALOG (dialog));
@@ -194,3 +194,37 @@ screenshooter_job_image_uploaded (ScreenshooterJob *job, const gchar *file_name)
   TRACE ("Emit image-uploaded signal.");
   exo_job_emit (EXO_JOB (job), job_signals[IMAGE_UPLOADED], 0, file_name);
 }
+
+
+
+/**
+ * screenshooter_job_upload_progress:
+ * @job: a #ScreenshooterJob.
+ * @sent: the number of bytes sent so far.
+ * @total: the total number of bytes to send.
+ * @elapsed: the number of seconds since the upload started.
+ *
+ * Shows the progress of an upload and its average throughput, through
+ * the info-message signal of @job.
+ **/
+void
+screenshooter_job_upload_progress (ScreenshooterJob *job,
+                                   goffset           sent,
+                                   goffset           total,
+                                   gdouble           elapsed)
+{
+  gchar *sent_size, *total_size, *rate;
+
+  g_return_if_fail (SCREENSHOOTER_IS_JOB (job));
+
+  sent_size = g_format_size (sent);
+  total_size = g_format_size (total);
+  rate = g_format_size (elapsed > 0 ? (guint64) (sent / elapsed) : 0);
+
+  exo_job_info_message (EXO_JOB (job), _("Uploaded %s of %s (%s/s)"),
+                        sent_size, total_size, rate);
+
+  g_free (sent_size);
+  g_free (total_size);
+  g_free (rate);
+}
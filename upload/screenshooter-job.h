@@ -71,6 +71,11 @@ void  screenshooter_job_ask_info       (ScreenshooterJob *job,
 void  screenshooter_job_image_uploaded (ScreenshooterJob *job,
                                         const gchar      *file_name);
 
+void  screenshooter_job_upload_progress (ScreenshooterJob *job,
+                                         goffset           sent,
+                                         goffset           total,
+                                         gdouble           elapsed);
+
 G_END_DECLS
 
 #endif /* !__SCREENSHOOTER_JOB_H__ */
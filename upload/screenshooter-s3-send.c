@@ -0,0 +1,923 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Multipart uploads to the S3 bucket defined by the user, see
+   lib/screenshooter-s3.c for the keys of the rc file.
+*/
+
+#include "screenshooter-s3-send.h"
+#include "screenshooter-job-callbacks.h"
+#include "screenshooter-upload-queue.h"
+#include "screenshooter-upload-session.h"
+
+#include <string.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
+#include <libxml/parser.h>
+
+#define S3_STATE_DIR          "xfce4/screenshooter/s3/"
+
+/* Number of times a part is sent before giving up */
+#define S3_PART_ATTEMPTS      3
+
+/* Microseconds between two progress reports */
+#define S3_PROGRESS_INTERVAL  250000
+
+#define S3_SIGNED_HEADERS     "host;x-amz-content-sha256;x-amz-date"
+
+
+
+/* State of one multipart upload, shared by the threads sending the parts */
+typedef struct
+{
+  ScreenshooterS3  *s3;
+  SoupSession      *session;
+  const gchar      *image_path;
+  gchar            *path;
+  gchar            *upload_id;
+  goffset           size;
+  gint              n_parts;
+  gchar           **etags;
+  goffset           sent;
+  gint              remaining;
+  GError           *error;
+  GKeyFile         *state;
+  gchar            *state_path;
+}
+S3Upload;
+
+typedef struct
+{
+  S3Upload *upload;
+  goffset   counted;
+}
+S3PartProgress;
+
+
+
+G_LOCK_DEFINE_STATIC (s3_upload);
+
+
+
+static gchar       *s3_uri_encode          (const gchar      *string,
+                                            gboolean          encode_slash);
+static void         s3_hmac                (const guchar     *key,
+                                            gsize             key_length,
+                                            const gchar      *data,
+                                            guchar           *digest);
+static SoupMessage *s3_new_message         (ScreenshooterS3  *s3,
+                                            const gchar      *method,
+                                            const gchar      *path,
+                                            const gchar      *query,
+                                            const gchar      *content_type,
+                                            const gchar      *data,
+                                            gsize             length);
+static gchar       *s3_find_xml_value      (xmlNode          *node,
+                                            const gchar      *name);
+static gchar       *s3_get_xml_value       (SoupMessage      *msg,
+                                            const gchar      *name);
+static gboolean     s3_check_message       (SoupMessage      *msg,
+                                            GError          **error);
+static void         s3_save_state          (S3Upload         *upload);
+static void         s3_load_state          (S3Upload         *upload,
+                                            GFileInfo        *info);
+static gboolean     s3_initiate            (S3Upload         *upload,
+                                            GError          **error);
+static gchar       *s3_read_part           (S3Upload         *upload,
+                                            gint              part,
+                                            gsize            *length,
+                                            GError          **error);
+static void         cb_wrote_body_data     (SoupMessage      *msg,
+                                            SoupBuffer       *chunk,
+                                            S3PartProgress   *progress);
+static void         s3_upload_part         (gpointer          data,
+                                            S3Upload         *upload);
+static gboolean     s3_complete            (S3Upload         *upload,
+                                            GError          **error);
+static void         s3_upload_free         (S3Upload         *upload);
+static void         cb_job_progress        (goffset           sent,
+                                            goffset           total,
+                                            gdouble           elapsed,
+                                            ScreenshooterJob *job);
+static gboolean     s3_upload_job          (ScreenshooterJob *job,
+                                            GArray           *param_values,
+                                            GError          **error);
+
+
+
+/* Internals */
+
+
+
+/* Percent-encodes everything but the unreserved characters, as required by
+ * the canonical requests of Signature Version 4 */
+static gchar
+*s3_uri_encode (const gchar *string, gboolean encode_slash)
+{
+  GString *encoded = g_string_sized_new (strlen (string) * 3);
+  const guchar *c;
+
+  for (c = (const guchar *) string; *c != '\0'; c++)
+    {
+      if (g_ascii_isalnum (*c) || *c == '-' || *c == '_' || *c == '.' ||
+          *c == '~' || (*c == '/' && !encode_slash))
+        g_string_append_c (encoded, *c);
+      else
+        g_string_append_printf (encoded, "%%%02X", *c);
+    }
+
+  return g_string_free (encoded, FALSE);
+}
+
+
+
+static void
+s3_hmac (const guchar *key, gsize key_length, const gchar *data, guchar *digest)
+{
+  GHmac *hmac = g_hmac_new (G_CHECKSUM_SHA256, key, key_length);
+  gsize digest_length = 32;
+
+  g_hmac_update (hmac, (const guchar *) data, -1);
+  g_hmac_get_digest (hmac, digest, &digest_length);
+  g_hmac_unref (hmac);
+}
+
+
+
+/* Creates a signed request. @path and @query must already be encoded, and
+ * the parameters of @query sorted by name. The message takes a copy of
+ * @data. */
+static SoupMessage
+*s3_new_message (ScreenshooterS3 *s3,
+                 const gchar     *method,
+                 const gchar     *path,
+                 const gchar     *query,
+                 const gchar     *content_type,
+                 const gchar     *data,
+                 gsize            length)
+{
+  SoupMessage *msg;
+  SoupURI *uri;
+  GDateTime *now;
+  gchar *url, *host, *payload_hash, *amz_date, *date, *scope;
+  gchar *canonical_request, *request_hash, *string_to_sign;
+  gchar *secret, *signature, *authorization;
+  guchar key[32];
+
+  url = g_strconcat (s3->endpoint, path, query != NULL ? "?" : NULL, query, NULL);
+  msg = soup_message_new (method, url);
+  g_free (url);
+
+  if (msg == NULL)
+    return NULL;
+
+  uri = soup_message_get_uri (msg);
+
+  if (soup_uri_uses_default_port (uri))
+    host = g_strdup (uri->host);
+  else
+    host = g_strdup_printf ("%s:%u", uri->host, uri->port);
+
+  now = g_date_time_new_now_utc ();
+  amz_date = g_date_time_format (now, "%Y%m%dT%H%M%SZ");
+  date = g_date_time_format (now, "%Y%m%d");
+  g_date_time_unref (now);
+
+  payload_hash = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                              (const guchar *) (data != NULL ? data : ""),
+                                              length);
+
+  canonical_request =
+    g_strdup_printf ("%s\n%s\n%s\n"
+                     "host:%s\nx-amz-content-sha256:%s\nx-amz-date:%s\n\n"
+                     "%s\n%s",
+                     method, path, query != NULL ? query : "",
+                     host, payload_hash, amz_date,
+                     S3_SIGNED_HEADERS, payload_hash);
+  request_hash = g_compute_checksum_for_string (G_CHECKSUM_SHA256,
+                                                canonical_request, -1);
+
+  scope = g_strdup_printf ("%s/%s/s3/aws4_request", date, s3->region);
+  string_to_sign = g_strdup_printf ("AWS4-HMAC-SHA256\n%s\n%s\n%s",
+                                    amz_date, scope, request_hash);
+
+  /* Derive the signing key from the secret key and the scope */
+  secret = g_strconcat ("AWS4", s3->secret_key, NULL);
+  s3_hmac ((const guchar *) secret, strlen (secret), date, key);
+  s3_hmac (key, sizeof (key), s3->region, key);
+  s3_hmac (key, sizeof (key), "s3", key);
+  s3_hmac (key, sizeof (key), "aws4_request", key);
+
+  signature = g_compute_hmac_for_string (G_CHECKSUM_SHA256, key, sizeof (key),
+                                         string_to_sign, -1);
+  authorization =
+    g_strdup_printf ("AWS4-HMAC-SHA256 Credential=%s/%s, SignedHeaders=%s, "
+                     "Signature=%s",
+                     s3->access_key, scope, S3_SIGNED_HEADERS, signature);
+
+  soup_message_headers_replace (msg->request_headers, "x-amz-date", amz_date);
+  soup_message_headers_replace (msg->request_headers, "x-amz-content-sha256",
+                                payload_hash);
+  soup_message_headers_replace (msg->request_headers, "Authorization",
+                                authorization);
+
+  if (data != NULL)
+    soup_message_set_request (msg, content_type, SOUP_MEMORY_COPY, data, length);
+
+  memset (key, 0, sizeof (key));
+  memset (secret, 0, strlen (secret));
+
+  g_free (authorization);
+  g_free (signature);
+  g_free (secret);
+  g_free (string_to_sign);
+  g_free (scope);
+  g_free (request_hash);
+  g_free (canonical_request);
+  g_free (payload_hash);
+  g_free (date);
+  g_free (amz_date);
+  g_free (host);
+
+  return msg;
+}
+
+
+
+static gchar
+*s3_find_xml_value (xmlNode *node, const gchar *name)
+{
+  gchar *value = NULL;
+
+  for (; node != NULL && value == NULL; node = node->next)
+    {
+      if (node->type != XML_ELEMENT_NODE)
+        continue;
+
+      if (xmlStrEqual (node->name, (const xmlChar *) name))
+        {
+          xmlChar *content = xmlNodeGetContent (node);
+
+          value = g_strdup ((const gchar *) content);
+          xmlFree (content);
+        }
+      else
+        value = s3_find_xml_value (node->children, name);
+    }
+
+  return value;
+}
+
+
+
+/* Returns the content of the first @name element of the XML answer */
+static gchar
+*s3_get_xml_value (SoupMessage *msg, const gchar *name)
+{
+  xmlDoc *doc;
+  gchar *value;
+
+  doc = xmlParseMemory (msg->response_body->data, msg->response_body->length);
+
+  if (doc == NULL)
+    return NULL;
+
+  value = s3_find_xml_value (xmlDocGetRootElement (doc), name);
+  xmlFreeDoc (doc);
+
+  return value;
+}
+
+
+
+static gboolean
+s3_check_message (SoupMessage *msg, GError **error)
+{
+  gchar *code;
+
+  if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+    return TRUE;
+
+  code = msg->response_body->length > 0 ? s3_get_xml_value (msg, "Code") : NULL;
+
+  TRACE ("S3 error: %d %s %s", msg->status_code, msg->reason_phrase, code);
+
+  g_set_error (error, SOUP_HTTP_ERROR, msg->status_code,
+               _("An error occurred while transferring the data"
+                 " to S3: %s."),
+               code != NULL ? code : msg->reason_phrase);
+  g_free (code);
+
+  return FALSE;
+}
+
+
+
+/* Must be called with the lock held */
+static void
+s3_save_state (S3Upload *upload)
+{
+  gchar *data;
+  gsize length;
+
+  data = g_key_file_to_data (upload->state, &length, NULL);
+  g_file_set_contents (upload->state_path, data, length, NULL);
+  g_free (data);
+}
+
+
+
+/* Looks for an interrupted upload of the same file */
+static void
+s3_load_state (S3Upload *upload, GFileInfo *info)
+{
+  gchar *dir, *id, *key, *upload_id;
+  gint i;
+
+  dir = xfce_resource_save_location (XFCE_RESOURCE_CACHE, S3_STATE_DIR, TRUE);
+  key = g_strdup_printf ("%s\n%s\n%" G_GINT64_FORMAT "\n%" G_GUINT64_FORMAT,
+                         upload->s3->endpoint, upload->path, upload->size,
+                         g_file_info_get_attribute_uint64 (info,
+                                                           G_FILE_ATTRIBUTE_TIME_MODIFIED));
+  id = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+
+  upload->state = g_key_file_new ();
+  upload->state_path = g_build_filename (dir, id, NULL);
+
+  g_free (key);
+  g_free (id);
+  g_free (dir);
+
+  if (!g_key_file_load_from_file (upload->state, upload->state_path,
+                                  G_KEY_FILE_NONE, NULL))
+    return;
+
+  upload_id = g_key_file_get_string (upload->state, "Upload", "UploadId", NULL);
+
+  /* The parts would not match */
+  if (upload_id == NULL ||
+      g_key_file_get_int64 (upload->state, "Upload", "PartSize", NULL) !=
+      upload->s3->part_size)
+    {
+      g_free (upload_id);
+      g_key_file_remove_group (upload->state, "Parts", NULL);
+
+      return;
+    }
+
+  upload->upload_id = upload_id;
+
+  for (i = 0; i < upload->n_parts; i++)
+    {
+      gchar *part = g_strdup_printf ("%d", i + 1);
+
+      upload->etags[i] = g_key_file_get_string (upload->state, "Parts", part, NULL);
+      g_free (part);
+    }
+
+  TRACE ("Resume the upload %s of %s", upload->upload_id, upload->image_path);
+}
+
+
+
+static gboolean
+s3_initiate (S3Upload *upload, GError **error)
+{
+  SoupMessage *msg;
+
+  msg = s3_new_message (upload->s3, "POST", upload->path, "uploads=",
+                        NULL, NULL, 0);
+
+  if (msg == NULL)
+    {
+      g_set_error (error, SOUP_HTTP_ERROR, SOUP_STATUS_MALFORMED,
+                   _("%s is not a valid URL."), upload->s3->endpoint);
+
+      return FALSE;
+    }
+
+  soup_message_headers_replace (msg->request_headers, "Content-Type", "image/png");
+  soup_session_send_message (upload->session, msg);
+
+  if (!s3_check_message (msg, error))
+    {
+      g_object_unref (msg);
+
+      return FALSE;
+    }
+
+  upload->upload_id = s3_get_xml_value (msg, "UploadId");
+  g_object_unref (msg);
+
+  if (upload->upload_id == NULL)
+    {
+      g_set_error (error, SOUP_HTTP_ERROR, SOUP_STATUS_MALFORMED,
+                   _("An error occurred while transferring the data"
+                     " to S3: %s."), "UploadId");
+
+      return FALSE;
+    }
+
+  TRACE ("Started the upload %s", upload->upload_id);
+
+  g_key_file_remove_group (upload->state, "Parts", NULL);
+  g_key_file_set_string (upload->state, "Upload", "UploadId", upload->upload_id);
+  g_key_file_set_int64 (upload->state, "Upload", "PartSize", upload->s3->part_size);
+  s3_save_state (upload);
+
+  return TRUE;
+}
+
+
+
+static gchar
+*s3_read_part (S3Upload *upload, gint part, gsize *length, GError **error)
+{
+  GFile *file = g_file_new_for_path (upload->image_path);
+  GFileInputStream *stream;
+  goffset offset = (goffset) (part - 1) * upload->s3->part_size;
+  gchar *data = NULL;
+
+  *length = MIN (upload->s3->part_size, upload->size - offset);
+
+  stream = g_file_read (file, NULL, error);
+  g_object_unref (file);
+
+  if (stream == NULL)
+    return NULL;
+
+  if (g_seekable_seek (G_SEEKABLE (stream), offset, G_SEEK_SET, NULL, error))
+    {
+      gsize read;
+
+      data = g_malloc (MAX (*length, 1));
+
+      if (!g_input_stream_read_all (G_INPUT_STREAM (stream), data, *length,
+                                    &read, NULL, error) || read != *length)
+        {
+          if (error != NULL && *error == NULL)
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                         _("%s changed while it was uploaded."),
+                         upload->image_path);
+
+          g_free (data);
+          data = NULL;
+        }
+    }
+
+  g_object_unref (stream);
+
+  return data;
+}
+
+
+
+static void
+cb_wrote_body_data (SoupMessage *msg, SoupBuffer *chunk, S3PartProgress *progress)
+{
+  G_LOCK (s3_upload);
+  progress->upload->sent += chunk->length;
+  progress->counted += chunk->length;
+  G_UNLOCK (s3_upload);
+}
+
+
+
+/* Thread function of the pool */
+static void
+s3_upload_part (gpointer data, S3Upload *upload)
+{
+  gint part = GPOINTER_TO_INT (data);
+  S3PartProgress progress = { upload, 0 };
+  GError *error = NULL;
+  gchar *query, *upload_id, *buffer;
+  gsize length;
+  gint attempt;
+  gboolean failed;
+
+  G_LOCK (s3_upload);
+  failed = upload->error != NULL;
+  G_UNLOCK (s3_upload);
+
+  /* Another part failed, the upload will not complete */
+  if (failed)
+    goto out;
+
+  buffer = s3_read_part (upload, part, &length, &error);
+
+  if (buffer == NULL)
+    goto out;
+
+  upload_id = s3_uri_encode (upload->upload_id, TRUE);
+  query = g_strdup_printf ("partNumber=%d&uploadId=%s", part, upload_id);
+  g_free (upload_id);
+
+  for (attempt = 0; attempt < S3_PART_ATTEMPTS; attempt++)
+    {
+      SoupMessage *msg;
+
+      g_clear_error (&error);
+
+      msg = s3_new_message (upload->s3, "PUT", upload->path, query,
+                            "application/octet-stream", buffer, length);
+      g_signal_connect (msg, "wrote-body-data",
+                        G_CALLBACK (cb_wrote_body_data), &progress);
+
+      screenshooter_upload_session_send (upload->session, msg, NULL, NULL, NULL);
+
+      if (s3_check_message (msg, &error))
+        {
+          const gchar *etag = soup_message_headers_get_one (msg->response_headers,
+                                                             "ETag");
+          gchar *name = g_strdup_printf ("%d", part);
+
+          G_LOCK (s3_upload);
+          upload->etags[part - 1] = g_strdup (etag != NULL ? etag : "");
+          g_key_file_set_string (upload->state, "Parts", name,
+                                 upload->etags[part - 1]);
+          s3_save_state (upload);
+          G_UNLOCK (s3_upload);
+
+          g_free (name);
+          g_object_unref (msg);
+
+          break;
+        }
+
+      g_object_unref (msg);
+
+      /* The bytes of this attempt will be sent again */
+      G_LOCK (s3_upload);
+      upload->sent -= progress.counted;
+      progress.counted = 0;
+      G_UNLOCK (s3_upload);
+
+      TRACE ("Part %d failed: %s", part, error->message);
+
+      if (!screenshooter_upload_queue_is_transient_error (error))
+        break;
+    }
+
+  g_free (query);
+  g_free (buffer);
+
+out:
+  if (error != NULL)
+    {
+      G_LOCK (s3_upload);
+      if (upload->error == NULL)
+        upload->error = error;
+      else
+        g_error_free (error);
+      G_UNLOCK (s3_upload);
+    }
+
+  g_atomic_int_add (&upload->remaining, -1);
+}
+
+
+
+static gboolean
+s3_complete (S3Upload *upload, GError **error)
+{
+  SoupMessage *msg;
+  GString *body;
+  gchar *upload_id, *query, *code;
+  gint i;
+
+  body = g_string_new ("<CompleteMultipartUpload>");
+
+  for (i = 0; i < upload->n_parts; i++)
+    {
+      gchar *etag = g_markup_escape_text (upload->etags[i], -1);
+
+      g_string_append_printf (body, "<Part><PartNumber>%d</PartNumber>"
+                              "<ETag>%s</ETag></Part>", i + 1, etag);
+      g_free (etag);
+    }
+
+  g_string_append (body, "</CompleteMultipartUpload>");
+
+  upload_id = s3_uri_encode (upload->upload_id, TRUE);
+  query = g_strdup_printf ("uploadId=%s", upload_id);
+
+  msg = s3_new_message (upload->s3, "POST", upload->path, query,
+                        "application/xml", body->str, body->len);
+  soup_session_send_message (upload->session, msg);
+
+  g_free (query);
+  g_free (upload_id);
+  g_string_free (body, TRUE);
+
+  if (!s3_check_message (msg, error))
+    {
+      g_object_unref (msg);
+
+      return FALSE;
+    }
+
+  /* The server may answer 200 and report an error in the body */
+  code = s3_get_xml_value (msg, "Code");
+  g_object_unref (msg);
+
+  if (code != NULL)
+    {
+      g_set_error (error, SOUP_HTTP_ERROR, SOUP_STATUS_INTERNAL_SERVER_ERROR,
+                   _("An error occurred while transferring the data"
+                     " to S3: %s."), code);
+      g_free (code);
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+s3_upload_free (S3Upload *upload)
+{
+  if (upload->session != NULL)
+    g_object_unref (upload->session);
+
+  if (upload->state != NULL)
+    g_key_file_free (upload->state);
+
+  g_strfreev (upload->etags);
+  g_free (upload->state_path);
+  g_free (upload->upload_id);
+  g_free (upload->path);
+  g_free (upload);
+}
+
+
+
+static void
+cb_job_progress (goffset sent, goffset total, gdouble elapsed, ScreenshooterJob *job)
+{
+  screenshooter_job_upload_progress (job, sent, total, elapsed);
+}
+
+
+
+static gboolean
+s3_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  ScreenshooterS3 *s3;
+  const gchar *image_path;
+  gchar *link = NULL;
+
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), FALSE);
+  g_return_val_if_fail (param_values != NULL, FALSE);
+  g_return_val_if_fail (param_values->len == 2, FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_STRING (g_array_index(param_values, GValue*, 0))), FALSE);
+  g_return_val_if_fail ((G_VALUE_HOLDS_POINTER (g_array_index(param_values, GValue*, 1))), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_object_set_data (G_OBJECT (job), "jobtype", "s3");
+  g_object_set_data (G_OBJECT (job), "service", "S3");
+  if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+    return FALSE;
+
+  image_path = g_value_get_string (g_array_index (param_values, GValue*, 0));
+  s3 = g_value_get_pointer (g_array_index (param_values, GValue*, 1));
+
+  exo_job_info_message (EXO_JOB (job), _("Upload the screenshot..."));
+
+  if (!screenshooter_s3_upload_file (s3, image_path, &link,
+                                     (ScreenshooterS3ProgressFunc) cb_job_progress,
+                                     job, error))
+    return FALSE;
+
+  screenshooter_job_image_uploaded (job, link);
+  g_free (link);
+
+  return TRUE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_s3_warm_up:
+ * @s3: a #ScreenshooterS3.
+ *
+ * Opens a connection to the server while the screenshot is taken, see
+ * screenshooter_upload_session_warm_up().
+ **/
+void
+screenshooter_s3_warm_up (ScreenshooterS3 *s3)
+{
+  g_return_if_fail (s3 != NULL);
+
+  screenshooter_upload_session_warm_up (s3->endpoint);
+}
+
+
+
+/**
+ * screenshooter_s3_upload_file:
+ * @s3: a #ScreenshooterS3.
+ * @image_path: the local path of the image to upload.
+ * @link: return location for the URL of the uploaded object.
+ * @progress: function called regularly with the number of bytes sent, or
+ * %NULL.
+ * @user_data: data passed to @progress.
+ * @error: return location for errors.
+ *
+ * Uploads the file whose path is @image_path to the bucket, and waits for
+ * the upload to complete. The parts are sent in parallel, and @progress is
+ * called from the calling thread. If an upload of the same file was
+ * interrupted, only the missing parts are sent.
+ *
+ * Return value: %TRUE if the file was uploaded. @link should then be freed
+ * with g_free().
+ **/
+gboolean
+screenshooter_s3_upload_file (ScreenshooterS3              *s3,
+                              const gchar                  *image_path,
+                              gchar                       **link,
+                              ScreenshooterS3ProgressFunc   progress,
+                              gpointer                      user_data,
+                              GError                      **error)
+{
+  S3Upload *upload;
+  GThreadPool *pool;
+  GFileInfo *info;
+  GFile *file;
+  GTimer *timer;
+  gchar *key, *name, *path, *encoded_path;
+  gint i, missing = 0;
+
+  g_return_val_if_fail (s3 != NULL, FALSE);
+  g_return_val_if_fail (image_path != NULL, FALSE);
+  g_return_val_if_fail (link != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  file = g_file_new_for_path (image_path);
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                            G_FILE_QUERY_INFO_NONE, NULL, error);
+  g_object_unref (file);
+
+  if (info == NULL)
+    return FALSE;
+
+  name = g_path_get_basename (image_path);
+  key = g_strconcat (s3->prefix, name, NULL);
+  path = g_strconcat (s3->bucket, "/", key, NULL);
+  encoded_path = s3_uri_encode (path, FALSE);
+
+  upload = g_new0 (S3Upload, 1);
+  upload->s3 = s3;
+  upload->image_path = image_path;
+  upload->path = g_strconcat ("/", encoded_path, NULL);
+  upload->size = g_file_info_get_size (info);
+  upload->n_parts = MAX (1, (upload->size + s3->part_size - 1) / s3->part_size);
+  upload->etags = g_new0 (gchar *, upload->n_parts + 1);
+  upload->session = screenshooter_upload_session_get ();
+
+  g_free (encoded_path);
+  g_free (path);
+  g_free (key);
+  g_free (name);
+
+  s3_load_state (upload, info);
+  g_object_unref (info);
+
+  if (upload->upload_id == NULL && !s3_initiate (upload, error))
+    {
+      s3_upload_free (upload);
+
+      return FALSE;
+    }
+
+  /* Send the missing parts */
+  for (i = 0; i < upload->n_parts; i++)
+    if (upload->etags[i] == NULL)
+      missing++;
+
+  upload->remaining = missing;
+  upload->sent = (goffset) (upload->n_parts - missing) * s3->part_size;
+  upload->sent = MIN (upload->sent, upload->size);
+
+  timer = g_timer_new ();
+
+  if (missing > 0)
+    {
+      pool = g_thread_pool_new ((GFunc) s3_upload_part, upload,
+                                MIN (s3->parallel, missing), FALSE, NULL);
+
+      for (i = 0; i < upload->n_parts; i++)
+        if (upload->etags[i] == NULL)
+          g_thread_pool_push (pool, GINT_TO_POINTER (i + 1), NULL);
+
+      while (g_atomic_int_get (&upload->remaining) > 0)
+        {
+          g_usleep (S3_PROGRESS_INTERVAL);
+
+          if (progress != NULL)
+            {
+              goffset sent;
+
+              G_LOCK (s3_upload);
+              sent = upload->sent;
+              G_UNLOCK (s3_upload);
+
+              progress (sent, upload->size, g_timer_elapsed (timer, NULL),
+                        user_data);
+            }
+        }
+
+      g_thread_pool_free (pool, FALSE, TRUE);
+    }
+
+  if (upload->error != NULL)
+    {
+      /* The server forgot the upload, start again next time */
+      if (upload->error->code == SOUP_STATUS_NOT_FOUND)
+        g_unlink (upload->state_path);
+
+      g_propagate_error (error, upload->error);
+      upload->error = NULL;
+      g_timer_destroy (timer);
+      s3_upload_free (upload);
+
+      return FALSE;
+    }
+
+  if (!s3_complete (upload, error))
+    {
+      g_timer_destroy (timer);
+      s3_upload_free (upload);
+
+      return FALSE;
+    }
+
+  TRACE ("Uploaded %" G_GINT64_FORMAT " bytes in %f seconds",
+         upload->size, g_timer_elapsed (timer, NULL));
+
+  g_unlink (upload->state_path);
+  *link = g_strconcat (s3->endpoint, upload->path, NULL);
+
+  g_timer_destroy (timer);
+  s3_upload_free (upload);
+
+  return TRUE;
+}
+
+
+
+/**
+ * screenshooter_upload_to_s3:
+ * @image_path: the local path of the image that should be uploaded.
+ * @s3: the bucket to upload to.
+ *
+ * Uploads the image whose path is @image_path to the bucket described by
+ * @s3, and shows the link to the uploaded image.
+ **/
+void
+screenshooter_upload_to_s3 (const gchar *image_path, ScreenshooterS3 *s3)
+{
+  ScreenshooterJob *job;
+  GtkWidget *dialog, *label;
+
+  g_return_if_fail (image_path != NULL);
+  g_return_if_fail (s3 != NULL);
+
+  dialog = create_throbber_dialog (_("S3"), &label);
+
+  job = screenshooter_simple_job_launch (s3_upload_job, 2,
+                                         G_TYPE_STRING, image_path,
+                                         G_TYPE_POINTER, s3);
+
+  g_signal_connect (job, "ask", G_CALLBACK (cb_ask_for_information), NULL);
+  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_uploaded), NULL);
+  g_signal_connect (job, "error", G_CALLBACK (cb_error), NULL);
+  g_signal_connect (job, "finished", G_CALLBACK (cb_finished), dialog);
+  g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+
+  gtk_dialog_run (GTK_DIALOG (dialog));
+}
@@ -0,0 +1,371 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Request bodies which are written to the network chunk by chunk.
+
+   A body is a list of pieces: in-memory strings (the XML or multipart
+   framing) and files, which can optionally be base64 encoded on the fly.
+   The total length is known in advance, so the message is sent with a
+   Content-Length header. The next chunk is produced each time libsoup has
+   written the previous one, and written chunks are not accumulated, so the
+   memory used does not depend on the size of the files.
+*/
+
+#include "screenshooter-stream-body.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Multiple of 3, so that full chunks are base64 encoded without padding */
+#define CHUNK_SIZE (3 * 16 * 1024)
+
+
+
+typedef struct
+{
+  /* In-memory piece */
+  gchar        *data;
+
+  /* File piece */
+  GInputStream *stream;
+  gboolean      base64;
+  gint          state;
+  gint          save;
+
+  /* Number of bytes this piece adds to the body */
+  goffset       length;
+}
+StreamPiece;
+
+struct _ScreenshooterStreamBody
+{
+  GList       *pieces;
+  GList       *current;
+  goffset      length;
+  goffset      produced;
+  gchar       *buffer;
+  SoupSession *session;
+};
+
+
+
+static SoupBuffer *stream_body_next_chunk (ScreenshooterStreamBody *body);
+static void        cb_wrote_chunk         (SoupMessage             *msg,
+                                           ScreenshooterStreamBody *body);
+
+
+
+/* Internals */
+
+
+
+static SoupBuffer
+*stream_body_next_chunk (ScreenshooterStreamBody *body)
+{
+  while (body->current != NULL)
+    {
+      StreamPiece *piece = body->current->data;
+      gchar *out;
+      gsize out_length;
+      gssize read;
+
+      if (piece->stream == NULL)
+        {
+          body->current = body->current->next;
+
+          if (piece->length == 0)
+            continue;
+
+          return soup_buffer_new (SOUP_MEMORY_STATIC, piece->data, piece->length);
+        }
+
+      read = g_input_stream_read (piece->stream, body->buffer, CHUNK_SIZE,
+                                  NULL, NULL);
+
+      if (read > 0)
+        {
+          if (!piece->base64)
+            return soup_buffer_new (SOUP_MEMORY_COPY, body->buffer, read);
+
+          out = g_malloc ((read / 3 + 1) * 4 + 4);
+          out_length = g_base64_encode_step ((guchar *) body->buffer, read, FALSE,
+                                             out, &piece->state, &piece->save);
+
+          if (out_length > 0)
+            return soup_buffer_new (SOUP_MEMORY_TAKE, out, out_length);
+
+          g_free (out);
+          continue;
+        }
+
+      /* End of the file, or a read error which will be caught by the
+       * length check of the caller */
+      g_input_stream_close (piece->stream, NULL, NULL);
+      g_object_unref (piece->stream);
+      piece->stream = NULL;
+      body->current = body->current->next;
+
+      if (piece->base64)
+        {
+          out = g_malloc (5);
+          out_length = g_base64_encode_close (FALSE, out,
+                                              &piece->state, &piece->save);
+
+          if (out_length > 0)
+            return soup_buffer_new (SOUP_MEMORY_TAKE, out, out_length);
+
+          g_free (out);
+        }
+    }
+
+  return NULL;
+}
+
+
+
+static void
+cb_wrote_chunk (SoupMessage *msg, ScreenshooterStreamBody *body)
+{
+  SoupBuffer *chunk = stream_body_next_chunk (body);
+
+  if (chunk != NULL)
+    {
+      body->produced += chunk->length;
+      soup_message_body_append_buffer (msg->request_body, chunk);
+      soup_buffer_free (chunk);
+    }
+  else if (body->produced != body->length)
+    {
+      /* A file changed while it was being sent, we would never reach the
+       * announced Content-Length */
+      TRACE ("The body is %" G_GINT64_FORMAT " bytes long instead of %"
+             G_GINT64_FORMAT, body->produced, body->length);
+
+      soup_session_cancel_message (body->session, msg, SOUP_STATUS_IO_ERROR);
+    }
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_stream_body_new:
+ *
+ * Creates an empty request body. Pieces are added with
+ * screenshooter_stream_body_append_data() and
+ * screenshooter_stream_body_append_file(), then the body is handed to a
+ * message with screenshooter_stream_body_attach().
+ *
+ * Return value: a new #ScreenshooterStreamBody.
+ **/
+ScreenshooterStreamBody
+*screenshooter_stream_body_new (void)
+{
+  return g_new0 (ScreenshooterStreamBody, 1);
+}
+
+
+
+/**
+ * screenshooter_stream_body_free:
+ * @body: a #ScreenshooterStreamBody.
+ *
+ * Frees @body and closes the files it still holds. Bodies which were
+ * attached to a message are freed with the message.
+ **/
+void
+screenshooter_stream_body_free (ScreenshooterStreamBody *body)
+{
+  GList *l;
+
+  if (body == NULL)
+    return;
+
+  for (l = body->pieces; l != NULL; l = l->next)
+    {
+      StreamPiece *piece = l->data;
+
+      if (piece->stream != NULL)
+        g_object_unref (piece->stream);
+
+      g_free (piece->data);
+      g_free (piece);
+    }
+
+  g_list_free (body->pieces);
+
+  if (body->session != NULL)
+    g_object_unref (body->session);
+
+  g_free (body->buffer);
+  g_free (body);
+}
+
+
+
+/**
+ * screenshooter_stream_body_append_data:
+ * @body: a #ScreenshooterStreamBody.
+ * @data: the data to append.
+ * @length: the length of @data, or -1 if it is nul-terminated.
+ *
+ * Appends a copy of @data to @body.
+ **/
+void
+screenshooter_stream_body_append_data (ScreenshooterStreamBody *body,
+                                       const gchar             *data,
+                                       gssize                   length)
+{
+  StreamPiece *piece;
+
+  g_return_if_fail (body != NULL);
+  g_return_if_fail (data != NULL);
+
+  if (length < 0)
+    length = strlen (data);
+
+  piece = g_new0 (StreamPiece, 1);
+  piece->data = g_memdup (data, length);
+  piece->length = length;
+
+  body->pieces = g_list_append (body->pieces, piece);
+  body->length += length;
+}
+
+
+
+/**
+ * screenshooter_stream_body_append_file:
+ * @body: a #ScreenshooterStreamBody.
+ * @path: the local path of the file to append.
+ * @base64: whether the file should be base64 encoded.
+ * @error: return location for errors.
+ *
+ * Appends the contents of the file at @path to @body. The file is opened
+ * now, but it is only read while the message is being sent.
+ *
+ * Return value: %FALSE if the file could not be opened.
+ **/
+gboolean
+screenshooter_stream_body_append_file (ScreenshooterStreamBody  *body,
+                                       const gchar              *path,
+                                       gboolean                  base64,
+                                       GError                  **error)
+{
+  StreamPiece *piece;
+  GFileInputStream *stream;
+  GFileInfo *info;
+  GFile *file;
+  goffset size;
+
+  g_return_val_if_fail (body != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  file = g_file_new_for_path (path);
+  stream = g_file_read (file, NULL, error);
+  g_object_unref (file);
+
+  if (stream == NULL)
+    return FALSE;
+
+  info = g_file_input_stream_query_info (stream, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                         NULL, error);
+
+  if (info == NULL)
+    {
+      g_object_unref (stream);
+      return FALSE;
+    }
+
+  size = g_file_info_get_size (info);
+  g_object_unref (info);
+
+  piece = g_new0 (StreamPiece, 1);
+  piece->stream = G_INPUT_STREAM (stream);
+  piece->base64 = base64;
+  piece->length = base64 ? ((size + 2) / 3) * 4 : size;
+
+  body->pieces = g_list_append (body->pieces, piece);
+  body->length += piece->length;
+
+  return TRUE;
+}
+
+
+
+/**
+ * screenshooter_stream_body_get_length:
+ * @body: a #ScreenshooterStreamBody.
+ *
+ * Return value: the number of bytes @body will write on the network.
+ **/
+goffset
+screenshooter_stream_body_get_length (ScreenshooterStreamBody *body)
+{
+  g_return_val_if_fail (body != NULL, 0);
+
+  return body->length;
+}
+
+
+
+/**
+ * screenshooter_stream_body_attach:
+ * @body: a #ScreenshooterStreamBody.
+ * @session: the #SoupSession which will send @msg.
+ * @msg: a #SoupMessage.
+ * @content_type: the MIME type of the body.
+ *
+ * Sets @body as the request body of @msg. @msg takes ownership of @body.
+ * Since the written chunks are discarded, @msg cannot be restarted, for
+ * example after a redirection.
+ **/
+void
+screenshooter_stream_body_attach (ScreenshooterStreamBody *body,
+                                  SoupSession             *session,
+                                  SoupMessage             *msg,
+                                  const gchar             *content_type)
+{
+  g_return_if_fail (body != NULL);
+  g_return_if_fail (SOUP_IS_SESSION (session));
+  g_return_if_fail (SOUP_IS_MESSAGE (msg));
+  g_return_if_fail (content_type != NULL);
+
+  body->session = g_object_ref (session);
+  body->buffer = g_malloc (CHUNK_SIZE);
+  body->current = body->pieces;
+
+  soup_message_headers_set_content_type (msg->request_headers, content_type, NULL);
+  soup_message_headers_set_content_length (msg->request_headers, body->length);
+  soup_message_body_set_accumulate (msg->request_body, FALSE);
+  soup_message_set_flags (msg, soup_message_get_flags (msg) | SOUP_MESSAGE_NO_REDIRECT);
+
+  /* The first chunk is queued once the headers are written, then a new one
+   * each time the previous one has been written */
+  g_signal_connect (msg, "wrote-headers", G_CALLBACK (cb_wrote_chunk), body);
+  g_signal_connect (msg, "wrote-chunk", G_CALLBACK (cb_wrote_chunk), body);
+
+  g_object_set_data_full (G_OBJECT (msg), "stream-body", body,
+                          (GDestroyNotify) screenshooter_stream_body_free);
+}
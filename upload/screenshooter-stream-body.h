@@ -0,0 +1,48 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_STREAM_BODY_H__
+#define __HAVE_STREAM_BODY_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+typedef struct _ScreenshooterStreamBody ScreenshooterStreamBody;
+
+ScreenshooterStreamBody *screenshooter_stream_body_new         (void);
+void                     screenshooter_stream_body_free        (ScreenshooterStreamBody  *body);
+void                     screenshooter_stream_body_append_data (ScreenshooterStreamBody  *body,
+                                                                const gchar              *data,
+                                                                gssize                    length);
+gboolean                 screenshooter_stream_body_append_file (ScreenshooterStreamBody  *body,
+                                                                const gchar              *path,
+                                                                gboolean                  base64,
+                                                                GError                  **error);
+goffset                  screenshooter_stream_body_get_length  (ScreenshooterStreamBody  *body);
+void                     screenshooter_stream_body_attach      (ScreenshooterStreamBody  *body,
+                                                                SoupSession              *session,
+                                                                SoupMessage              *msg,
+                                                                const gchar              *content_type);
+
+#endif
@@ -0,0 +1,396 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Conversion of the images which do not fit the limits of a service.
+
+   The size of the encoded image is predicted from the number of pixels,
+   so that the scale and the format are chosen before any work is done and
+   the image is encoded once. A PNG which is sent as is gives the number of
+   bytes per pixel of its contents, the other formats use a conservative
+   estimate for screenshots. The image is downscaled with the best
+   interpolation of gdk-pixbuf, each thread rendering a band of rows.
+*/
+
+#include "screenshooter-transcode.h"
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <libxfce4util/libxfce4util.h>
+
+/* Bytes per pixel of a screenshot saved as a JPEG at JPEG_QUALITY */
+#define JPEG_BYTES_PER_PIXEL 0.5
+#define JPEG_QUALITY         "90"
+
+/* Bytes per pixel of a PNG when the source does not tell */
+#define PNG_BYTES_PER_PIXEL  1.5
+
+/* Smoothing adds colors, so a downscaled PNG compresses less well */
+#define PNG_SCALE_OVERHEAD   1.25
+
+/* Part of the byte limit which is used, in case the estimate is low */
+#define BYTES_MARGIN         0.9
+
+#define MAX_THREADS          8
+
+
+
+typedef struct
+{
+  const GdkPixbuf *source;
+  GdkPixbuf       *dest;
+  gdouble          scale_x;
+  gdouble          scale_y;
+  gint             y;
+  gint             height;
+}
+TranscodeBand;
+
+
+
+static gint       transcode_n_threads       (void);
+static gboolean   transcode_format_accepted (const gchar   *formats,
+                                             const gchar   *format);
+static gdouble    transcode_bytes_per_pixel (const gchar   *format,
+                                             const gchar   *source_format,
+                                             goffset        source_size,
+                                             gint64         source_pixels,
+                                             gboolean       scaled);
+static void       transcode_scale_band      (TranscodeBand *band,
+                                             gpointer       unused);
+static GdkPixbuf *transcode_scale           (GdkPixbuf     *source,
+                                             gint           width,
+                                             gint           height);
+
+
+
+/* Internals */
+
+
+
+static gint
+transcode_n_threads (void)
+{
+#if GLIB_CHECK_VERSION (2, 36, 0)
+  return CLAMP ((gint) g_get_num_processors (), 1, MAX_THREADS);
+#else
+  return 4;
+#endif
+}
+
+
+
+static gboolean
+transcode_format_accepted (const gchar *formats, const gchar *format)
+{
+  gchar **names, **name;
+  gboolean accepted = FALSE;
+
+  names = g_strsplit (formats, ",", -1);
+
+  for (name = names; *name != NULL && !accepted; name++)
+    accepted = g_ascii_strcasecmp (g_strstrip (*name), format) == 0;
+
+  g_strfreev (names);
+
+  return accepted;
+}
+
+
+
+/* Predicted size of the image saved in @format, in bytes per pixel */
+static gdouble
+transcode_bytes_per_pixel (const gchar *format,
+                           const gchar *source_format,
+                           goffset      source_size,
+                           gint64       source_pixels,
+                           gboolean     scaled)
+{
+  gdouble bpp;
+
+  if (strcmp (format, "jpeg") == 0)
+    return JPEG_BYTES_PER_PIXEL;
+
+  if (strcmp (source_format, "png") == 0 && source_pixels > 0)
+    bpp = (gdouble) source_size / source_pixels;
+  else
+    bpp = PNG_BYTES_PER_PIXEL;
+
+  return scaled ? bpp * PNG_SCALE_OVERHEAD : bpp;
+}
+
+
+
+/* Thread function of the pool of transcode_scale */
+static void
+transcode_scale_band (TranscodeBand *band, gpointer unused)
+{
+  /* Renders the rows of the band only, with the transformation of the
+   * whole image */
+  gdk_pixbuf_scale (band->source, band->dest,
+                    0, band->y,
+                    gdk_pixbuf_get_width (band->dest), band->height,
+                    0, 0, band->scale_x, band->scale_y,
+                    GDK_INTERP_HYPER);
+}
+
+
+
+static GdkPixbuf
+*transcode_scale (GdkPixbuf *source, gint width, gint height)
+{
+  GdkPixbuf *dest;
+  GThreadPool *pool;
+  TranscodeBand *bands;
+  gint n_bands, band_height, i;
+
+  dest = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+                         gdk_pixbuf_get_has_alpha (source), 8,
+                         width, height);
+
+  if (dest == NULL)
+    return NULL;
+
+  n_bands = MIN (transcode_n_threads (), height);
+  band_height = (height + n_bands - 1) / n_bands;
+  bands = g_new0 (TranscodeBand, n_bands);
+
+  pool = g_thread_pool_new ((GFunc) transcode_scale_band, NULL,
+                            n_bands, FALSE, NULL);
+
+  for (i = 0; i < n_bands; i++)
+    {
+      bands[i].source = source;
+      bands[i].dest = dest;
+      bands[i].scale_x = (gdouble) width / gdk_pixbuf_get_width (source);
+      bands[i].scale_y = (gdouble) height / gdk_pixbuf_get_height (source);
+      bands[i].y = i * band_height;
+      bands[i].height = MIN (band_height, height - bands[i].y);
+
+      if (bands[i].height > 0)
+        g_thread_pool_push (pool, &bands[i], NULL);
+    }
+
+  /* Wait for all the bands */
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_free (bands);
+
+  return dest;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_transcode_for_upload:
+ * @image_path: the local path of the image.
+ * @limits: the limits of the service the image will be sent to.
+ * @upload_path: return location for the path of the converted image.
+ * @mime_type: return location for the MIME type of the file to send, or
+ * %NULL.
+ * @error: return location for errors.
+ *
+ * Makes the image at @image_path fit @limits. The number of pixels which
+ * can be kept is predicted for each accepted format, and the format
+ * keeping the most pixels is used, the first one of @limits in case of a
+ * tie. The image is then downscaled and encoded once, without trying
+ * other settings afterwards. This can be called from any thread.
+ *
+ * Return value: %FALSE if the image could not be converted. Otherwise,
+ * @upload_path is %NULL if the image can be sent as is, or the path of a
+ * temporary file which should be deleted and freed by the caller.
+ **/
+gboolean
+screenshooter_transcode_for_upload (const gchar                      *image_path,
+                                    const ScreenshooterUploadLimits  *limits,
+                                    gchar                           **upload_path,
+                                    const gchar                     **mime_type,
+                                    GError                          **error)
+{
+  GdkPixbufFormat *info;
+  GdkPixbuf *source, *scaled;
+  GStatBuf st;
+  gchar *source_format, *best_format = NULL, **formats, **format;
+  gchar *template, *path;
+  gint64 pixels, best_pixels = 0;
+  gint width, height, fd;
+  gboolean saved;
+
+  g_return_val_if_fail (image_path != NULL, FALSE);
+  g_return_val_if_fail (limits != NULL, FALSE);
+  g_return_val_if_fail (upload_path != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  *upload_path = NULL;
+
+  if (mime_type != NULL)
+    *mime_type = "image/png";
+
+  info = gdk_pixbuf_get_file_info (image_path, &width, &height);
+
+  if (info == NULL || g_stat (image_path, &st) != 0)
+    {
+      /* Let the upload report why the file cannot be read */
+      return TRUE;
+    }
+
+  source_format = gdk_pixbuf_format_get_name (info);
+  pixels = (gint64) width * height;
+
+  if (mime_type != NULL && strcmp (source_format, "jpeg") == 0)
+    *mime_type = "image/jpeg";
+
+  if ((limits->max_bytes <= 0 || st.st_size <= limits->max_bytes) &&
+      (limits->max_pixels <= 0 || pixels <= limits->max_pixels) &&
+      (limits->formats == NULL ||
+       transcode_format_accepted (limits->formats, source_format)))
+    {
+      g_free (source_format);
+
+      return TRUE;
+    }
+
+  /* Find the format which keeps the most pixels */
+  formats = g_strsplit (limits->formats != NULL ? limits->formats : "png", ",", -1);
+
+  for (format = formats; *format != NULL; format++)
+    {
+      gint64 kept = pixels;
+      gdouble bpp;
+
+      g_strstrip (*format);
+
+      if (strcmp (*format, "png") != 0 && strcmp (*format, "jpeg") != 0)
+        continue;
+
+      if (limits->max_pixels > 0)
+        kept = MIN (kept, limits->max_pixels);
+
+      if (limits->max_bytes > 0)
+        {
+          bpp = transcode_bytes_per_pixel (*format, source_format, st.st_size,
+                                           pixels, FALSE);
+
+          if (kept < pixels || kept * bpp > limits->max_bytes * BYTES_MARGIN)
+            bpp = transcode_bytes_per_pixel (*format, source_format, st.st_size,
+                                             pixels, TRUE);
+
+          kept = MIN (kept, (gint64) (limits->max_bytes * BYTES_MARGIN / bpp));
+        }
+
+      if (kept > best_pixels)
+        {
+          best_pixels = kept;
+          g_free (best_format);
+          best_format = g_strdup (*format);
+        }
+    }
+
+  g_strfreev (formats);
+  g_free (source_format);
+
+  if (best_format == NULL || best_pixels <= 0)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   _("The screenshot cannot be converted to fit the limits"
+                     " of the service."));
+      g_free (best_format);
+
+      return FALSE;
+    }
+
+  source = gdk_pixbuf_new_from_file (image_path, error);
+
+  if (source == NULL)
+    {
+      g_free (best_format);
+
+      return FALSE;
+    }
+
+  if (best_pixels < pixels)
+    {
+      gdouble scale = sqrt ((gdouble) best_pixels / pixels);
+      gint scaled_width = MAX (1, (gint) (width * scale));
+      gint scaled_height = MAX (1, (gint) (height * scale));
+
+      TRACE ("Scale %dx%d to %dx%d and save it as %s", width, height,
+             scaled_width, scaled_height, best_format);
+
+      scaled = transcode_scale (source, scaled_width, scaled_height);
+      g_object_unref (source);
+
+      if (scaled == NULL)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM,
+                       _("There is not enough memory to scale the screenshot."));
+          g_free (best_format);
+
+          return FALSE;
+        }
+    }
+  else
+    scaled = source;
+
+  template = g_strconcat ("screenshooter-upload-XXXXXX.",
+                          strcmp (best_format, "jpeg") == 0 ? "jpg" : "png",
+                          NULL);
+  fd = g_file_open_tmp (template, &path, error);
+  g_free (template);
+
+  if (fd < 0)
+    {
+      g_object_unref (scaled);
+      g_free (best_format);
+
+      return FALSE;
+    }
+
+  close (fd);
+
+  if (strcmp (best_format, "jpeg") == 0)
+    saved = gdk_pixbuf_save (scaled, path, "jpeg", error,
+                             "quality", JPEG_QUALITY, NULL);
+  else
+    saved = gdk_pixbuf_save (scaled, path, "png", error, NULL);
+
+  g_object_unref (scaled);
+
+  if (!saved)
+    {
+      g_unlink (path);
+      g_free (path);
+      g_free (best_format);
+
+      return FALSE;
+    }
+
+  if (mime_type != NULL)
+    *mime_type = strcmp (best_format, "jpeg") == 0 ? "image/jpeg" : "image/png";
+
+  *upload_path = path;
+  g_free (best_format);
+
+  return TRUE;
+}
@@ -0,0 +1,257 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Links of the images which were already uploaded.
+
+   The SHA-256 of the image file is mapped to the id returned by the
+   service, in a key file in $XDG_CACHE_HOME/xfce4/screenshooter. Uploading
+   a file with the same contents again gives the cached link without any
+   network traffic. PNG files saved from the same pixels are identical, so
+   a new screenshot of an unchanged window is found too.
+*/
+
+#include "screenshooter-upload-cache.h"
+
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+
+#define CACHE_FILE      "xfce4/screenshooter/uploads.cache"
+#define HASH_CHUNK_SIZE (64 * 1024)
+
+
+
+G_LOCK_DEFINE_STATIC (upload_cache);
+static gboolean cache_enabled = TRUE;
+
+
+
+static GKeyFile *cache_load (gchar **path);
+
+
+
+/* Internals */
+
+
+
+/* Must be called with the lock held */
+static GKeyFile
+*cache_load (gchar **path)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+
+  *path = xfce_resource_save_location (XFCE_RESOURCE_CACHE, CACHE_FILE, TRUE);
+
+  if (*path != NULL)
+    g_key_file_load_from_file (keyfile, *path, G_KEY_FILE_NONE, NULL);
+
+  return keyfile;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_upload_cache_set_enabled:
+ * @enabled: whether the cache should be used.
+ *
+ * When @enabled is %FALSE, the lookups fail so that the images are always
+ * uploaded. The new links are still stored.
+ **/
+void
+screenshooter_upload_cache_set_enabled (gboolean enabled)
+{
+  G_LOCK (upload_cache);
+  cache_enabled = enabled;
+  G_UNLOCK (upload_cache);
+}
+
+
+
+/**
+ * screenshooter_upload_cache_hash_file:
+ * @path: the local path of a file.
+ * @error: return location for errors.
+ *
+ * Return value: the SHA-256 of the contents of the file at @path, as an
+ * hexadecimal string to be freed with g_free(), or %NULL if the file could
+ * not be read.
+ **/
+gchar
+*screenshooter_upload_cache_hash_file (const gchar *path, GError **error)
+{
+  GChecksum *checksum;
+  GFileInputStream *stream;
+  GFile *file;
+  guchar *buffer;
+  gssize read;
+  gchar *hash = NULL;
+
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  file = g_file_new_for_path (path);
+  stream = g_file_read (file, NULL, error);
+  g_object_unref (file);
+
+  if (stream == NULL)
+    return NULL;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  buffer = g_malloc (HASH_CHUNK_SIZE);
+
+  while ((read = g_input_stream_read (G_INPUT_STREAM (stream), buffer,
+                                      HASH_CHUNK_SIZE, NULL, error)) > 0)
+    g_checksum_update (checksum, buffer, read);
+
+  if (read == 0)
+    hash = g_strdup (g_checksum_get_string (checksum));
+
+  g_free (buffer);
+  g_checksum_free (checksum);
+  g_object_unref (stream);
+
+  return hash;
+}
+
+
+
+/**
+ * screenshooter_upload_cache_lookup:
+ * @backend: the name of the service, "imgur" for example.
+ * @hash: the hash of the image, as returned by
+ * screenshooter_upload_cache_hash_file().
+ * @id: return location for the id of the uploaded image.
+ * @delete_hash: return location for the deletion hash of the image, or
+ * %NULL.
+ * @link: return location for the link to the image, or %NULL.
+ *
+ * Entries stored without a link are not found when @link is not %NULL, so
+ * that the image is uploaded again and its link is known.
+ *
+ * Return value: %TRUE if an image with the same @hash was already uploaded
+ * to @backend. @id, @delete_hash and @link should then be freed with
+ * g_free().
+ **/
+gboolean
+screenshooter_upload_cache_lookup (const gchar  *backend,
+                                   const gchar  *hash,
+                                   gchar       **id,
+                                   gchar       **delete_hash,
+                                   gchar       **link)
+{
+  GKeyFile *keyfile;
+  gchar *path, *group;
+
+  g_return_val_if_fail (backend != NULL, FALSE);
+  g_return_val_if_fail (hash != NULL, FALSE);
+  g_return_val_if_fail (id != NULL, FALSE);
+
+  G_LOCK (upload_cache);
+
+  if (!cache_enabled)
+    {
+      G_UNLOCK (upload_cache);
+      return FALSE;
+    }
+
+  keyfile = cache_load (&path);
+  group = g_strconcat (backend, " ", hash, NULL);
+
+  *id = g_key_file_get_string (keyfile, group, "Id", NULL);
+
+  if (*id != NULL && link != NULL)
+    {
+      *link = g_key_file_get_string (keyfile, group, "Link", NULL);
+
+      if (*link == NULL)
+        {
+          g_free (*id);
+          *id = NULL;
+        }
+    }
+
+  if (*id != NULL && delete_hash != NULL)
+    *delete_hash = g_key_file_get_string (keyfile, group, "DeleteHash", NULL);
+
+  G_UNLOCK (upload_cache);
+
+  TRACE ("Cache lookup of %s: %s", group, *id != NULL ? *id : "none");
+
+  g_free (group);
+  g_free (path);
+  g_key_file_free (keyfile);
+
+  return *id != NULL;
+}
+
+
+
+/**
+ * screenshooter_upload_cache_store:
+ * @backend: the name of the service, "imgur" for example.
+ * @hash: the hash of the image.
+ * @id: the id of the uploaded image.
+ * @delete_hash: the deletion hash of the image, or %NULL.
+ * @link: the link to the image, or %NULL.
+ *
+ * Remembers that the image whose hash is @hash was uploaded to @backend.
+ **/
+void
+screenshooter_upload_cache_store (const gchar *backend,
+                                  const gchar *hash,
+                                  const gchar *id,
+                                  const gchar *delete_hash,
+                                  const gchar *link)
+{
+  GKeyFile *keyfile;
+  gchar *path, *group, *data;
+  gsize length;
+
+  g_return_if_fail (backend != NULL);
+  g_return_if_fail (hash != NULL);
+  g_return_if_fail (id != NULL);
+
+  G_LOCK (upload_cache);
+
+  keyfile = cache_load (&path);
+  group = g_strconcat (backend, " ", hash, NULL);
+
+  g_key_file_set_string (keyfile, group, "Id", id);
+
+  if (delete_hash != NULL)
+    g_key_file_set_string (keyfile, group, "DeleteHash", delete_hash);
+
+  if (link != NULL)
+    g_key_file_set_string (keyfile, group, "Link", link);
+
+  data = g_key_file_to_data (keyfile, &length, NULL);
+
+  if (path != NULL)
+    g_file_set_contents (path, data, length, NULL);
+
+  G_UNLOCK (upload_cache);
+
+  g_free (data);
+  g_free (group);
+  g_free (path);
+  g_key_file_free (keyfile);
+}
@@ -0,0 +1,127 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Entry point of the upload module, see lib/screenshooter-upload-module.c.
+
+   The module exports a single symbol, which returns the table of the
+   functions called by the program.
+*/
+
+#include "screenshooter-upload-module.h"
+#include "screenshooter-batch.h"
+#include "screenshooter-custom-upload-send.h"
+#include "screenshooter-imgur.h"
+#include "screenshooter-s3-send.h"
+#include "screenshooter-upload-cache.h"
+#include "screenshooter-upload-queue.h"
+#include "screenshooter-upload-session.h"
+#include "screenshooter-zimagez.h"
+
+#include <gmodule.h>
+
+
+
+static void upload_warm_up  (ScreenshotData *sd);
+static void upload_shutdown (void);
+
+
+
+static const ScreenshooterUploadModule upload_module =
+{
+  SCREENSHOOTER_UPLOAD_MODULE_VERSION,
+
+  screenshooter_upload_session_configure,
+  screenshooter_upload_session_set_bandwidth_limit,
+  screenshooter_upload_session_set_print_timings,
+  screenshooter_upload_cache_set_enabled,
+  upload_warm_up,
+  upload_shutdown,
+
+  screenshooter_upload_to_zimagez,
+  screenshooter_upload_to_imgur,
+  screenshooter_upload_to_imgur_copy_link,
+  screenshooter_upload_to_imgur_album,
+  screenshooter_upload_to_custom,
+  screenshooter_upload_to_s3,
+
+  screenshooter_batch_expand_files,
+  screenshooter_batch_upload,
+
+  screenshooter_upload_queue_start,
+  screenshooter_upload_queue_list,
+  screenshooter_upload_queue_entry_free,
+  screenshooter_upload_queue_cancel,
+  screenshooter_upload_queue_flush,
+};
+
+
+
+G_MODULE_EXPORT const ScreenshooterUploadModule *screenshooter_upload_module_init (void);
+
+
+
+/* Internals */
+
+
+
+/* Connects to the upload host of the action while the screenshot is
+ * taken */
+static void
+upload_warm_up (ScreenshotData *sd)
+{
+  if (sd->action == UPLOAD)
+    screenshooter_upload_session_warm_up (ZIMAGEZ_API_URL);
+  else if (sd->action == UPLOAD_IMGUR || sd->action == UPLOAD_IMGUR_COPY)
+    screenshooter_upload_session_warm_up (IMGUR_UPLOAD_URL);
+  else if (sd->action == UPLOAD_CUSTOM && sd->custom_upload != NULL)
+    screenshooter_custom_upload_warm_up (sd->custom_upload);
+  else if (sd->action == UPLOAD_S3 && sd->s3 != NULL)
+    screenshooter_s3_warm_up (sd->s3);
+}
+
+
+
+/* Waits for the uploads of the queue and closes the ZimageZ session kept
+ * open by the uploads */
+static void
+upload_shutdown (void)
+{
+  screenshooter_upload_queue_stop ();
+  screenshooter_zimagez_logout ();
+  screenshooter_upload_session_shutdown ();
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_upload_module_init:
+ *
+ * Called by screenshooter_upload_module_get() once the module is loaded.
+ *
+ * Return value: the functions of the module.
+ **/
+const ScreenshooterUploadModule
+*screenshooter_upload_module_init (void)
+{
+  return &upload_module;
+}
@@ -0,0 +1,665 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* Uploads which failed because the host could not be reached.
+
+   Each entry is a copy of the screenshot and a key file describing it, in
+   $XDG_CACHE_HOME/xfce4/screenshooter/queue. Entries are retried by a pool
+   of worker threads, with an exponential and randomized delay between the
+   attempts so that several clients do not all retry at the same time. The
+   links of the images uploaded in the background are appended to
+   uploaded.log in the same directory.
+*/
+
+#include "screenshooter-upload-queue.h"
+#include "screenshooter-imgur.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
+#include <libxfce4util/libxfce4util.h>
+
+#define QUEUE_GROUP          "Entry"
+#define QUEUE_LOG            "uploaded.log"
+
+/* Seconds before the first retry, doubled after each failure */
+#define QUEUE_RETRY_BASE     30
+#define QUEUE_RETRY_MAX      (6 * 60 * 60)
+
+/* Seconds between two checks of the queue in long running processes */
+#define QUEUE_CHECK_INTERVAL 60
+
+/* Number of uploads running at the same time */
+#define QUEUE_MAX_UPLOADS    2
+
+
+
+G_LOCK_DEFINE_STATIC (upload_queue);
+
+/* Ids of the entries being uploaded */
+static GHashTable  *queue_in_flight = NULL;
+static GThreadPool *queue_pool = NULL;
+static guint        queue_timer = 0;
+
+
+
+static gchar                   *queue_get_dir         (void);
+static gchar                   *queue_get_entry_path  (const gchar             *id);
+static ScreenshooterQueueEntry *queue_load_entry      (const gchar             *id);
+static gboolean                 queue_save_entry      (ScreenshooterQueueEntry *entry,
+                                                       GError                 **error);
+static void                     queue_remove_entry    (ScreenshooterQueueEntry *entry);
+static gint                     queue_compare_entries (ScreenshooterQueueEntry *a,
+                                                       ScreenshooterQueueEntry *b);
+static gint64                   queue_get_retry_delay (gint                     attempts);
+static gboolean                 queue_send            (ScreenshooterQueueEntry *entry,
+                                                       gchar                  **url,
+                                                       GError                 **error);
+static void                     queue_log_upload      (ScreenshooterQueueEntry *entry,
+                                                       const gchar             *url);
+static void                     queue_upload_entry    (gchar                   *id,
+                                                       gpointer                 print);
+static gboolean                 queue_push            (GThreadPool             *pool,
+                                                       const gchar             *id);
+static gboolean                 cb_queue_check        (gpointer                 unused);
+
+
+
+/* Internals */
+
+
+
+static gchar
+*queue_get_dir (void)
+{
+  return xfce_resource_save_location (XFCE_RESOURCE_CACHE, SCREENSHOOTER_QUEUE_DIR, TRUE);
+}
+
+
+
+static gchar
+*queue_get_entry_path (const gchar *id)
+{
+  gchar *dir = queue_get_dir ();
+  gchar *name = g_strconcat (id, SCREENSHOOTER_QUEUE_ENTRY_SUFFIX, NULL);
+  gchar *path = g_build_filename (dir, name, NULL);
+
+  g_free (name);
+  g_free (dir);
+
+  return path;
+}
+
+
+
+static ScreenshooterQueueEntry
+*queue_load_entry (const gchar *id)
+{
+  ScreenshooterQueueEntry *entry;
+  GKeyFile *keyfile = g_key_file_new ();
+  gchar *path = queue_get_entry_path (id);
+  gchar *image, *dir;
+
+  if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, NULL))
+    {
+      g_key_file_free (keyfile);
+      g_free (path);
+
+      return NULL;
+    }
+
+  g_free (path);
+
+  image = g_key_file_get_string (keyfile, QUEUE_GROUP, "Image", NULL);
+
+  if (image == NULL)
+    {
+      g_key_file_free (keyfile);
+
+      return NULL;
+    }
+
+  dir = queue_get_dir ();
+
+  entry = g_new0 (ScreenshooterQueueEntry, 1);
+  entry->id = g_strdup (id);
+  entry->image_path = g_build_filename (dir, image, NULL);
+  entry->backend = g_key_file_get_string (keyfile, QUEUE_GROUP, "Backend", NULL);
+  entry->title = g_key_file_get_string (keyfile, QUEUE_GROUP, "Title", NULL);
+  entry->last_error = g_key_file_get_string (keyfile, QUEUE_GROUP, "LastError", NULL);
+  entry->attempts = g_key_file_get_integer (keyfile, QUEUE_GROUP, "Attempts", NULL);
+  entry->added = g_key_file_get_int64 (keyfile, QUEUE_GROUP, "Added", NULL);
+  entry->next_attempt = g_key_file_get_int64 (keyfile, QUEUE_GROUP, "NextAttempt", NULL);
+
+  g_free (dir);
+  g_free (image);
+  g_key_file_free (keyfile);
+
+  return entry;
+}
+
+
+
+static gboolean
+queue_save_entry (ScreenshooterQueueEntry *entry, GError **error)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  gchar *path = queue_get_entry_path (entry->id);
+  gchar *image = g_path_get_basename (entry->image_path);
+  gchar *data;
+  gsize length;
+  gboolean result;
+
+  g_key_file_set_string (keyfile, QUEUE_GROUP, "Backend", entry->backend);
+  g_key_file_set_string (keyfile, QUEUE_GROUP, "Image", image);
+  g_key_file_set_string (keyfile, QUEUE_GROUP, "Title",
+                         entry->title != NULL ? entry->title : "");
+  g_key_file_set_string (keyfile, QUEUE_GROUP, "LastError",
+                         entry->last_error != NULL ? entry->last_error : "");
+  g_key_file_set_integer (keyfile, QUEUE_GROUP, "Attempts", entry->attempts);
+  g_key_file_set_int64 (keyfile, QUEUE_GROUP, "Added", entry->added);
+  g_key_file_set_int64 (keyfile, QUEUE_GROUP, "NextAttempt", entry->next_attempt);
+
+  /* g_file_set_contents replaces the file atomically, a crash never leaves
+   * a truncated entry behind */
+  data = g_key_file_to_data (keyfile, &length, NULL);
+  result = g_file_set_contents (path, data, length, error);
+
+  g_free (data);
+  g_free (image);
+  g_free (path);
+  g_key_file_free (keyfile);
+
+  return result;
+}
+
+
+
+static void
+queue_remove_entry (ScreenshooterQueueEntry *entry)
+{
+  gchar *path = queue_get_entry_path (entry->id);
+
+  /* Remove the key file first, an image without key file is ignored */
+  g_unlink (path);
+  g_unlink (entry->image_path);
+
+  g_free (path);
+}
+
+
+
+/* Ids start with the time the entry was added */
+static gint
+queue_compare_entries (ScreenshooterQueueEntry *a, ScreenshooterQueueEntry *b)
+{
+  return strcmp (a->id, b->id);
+}
+
+
+
+static gint64
+queue_get_retry_delay (gint attempts)
+{
+  gint64 delay = QUEUE_RETRY_BASE;
+
+  while (--attempts > 0 && delay < QUEUE_RETRY_MAX)
+    delay *= 2;
+
+  delay = MIN (delay, QUEUE_RETRY_MAX);
+
+  /* Wait between half and all of the delay */
+  return delay / 2 + g_random_int_range (0, delay / 2 + 1);
+}
+
+
+
+static gboolean
+queue_send (ScreenshooterQueueEntry *entry, gchar **url, GError **error)
+{
+  gchar *id = NULL;
+
+  if (g_strcmp0 (entry->backend, "imgur") == 0)
+    {
+      if (!screenshooter_imgur_upload_file (entry->image_path, entry->title,
+                                            &id, NULL, url, error))
+        return FALSE;
+
+      g_free (id);
+
+      return TRUE;
+    }
+
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+               _("Unknown upload service: %s"), entry->backend);
+
+  return FALSE;
+}
+
+
+
+static void
+queue_log_upload (ScreenshooterQueueEntry *entry, const gchar *url)
+{
+  gchar *dir = queue_get_dir ();
+  gchar *path = g_build_filename (dir, QUEUE_LOG, NULL);
+  FILE *log;
+
+  G_LOCK (upload_queue);
+
+  log = g_fopen (path, "a");
+
+  if (log != NULL)
+    {
+      fprintf (log, "%" G_GINT64_FORMAT " %s %s\n",
+               (gint64) time (NULL), entry->id, url);
+      fclose (log);
+    }
+
+  G_UNLOCK (upload_queue);
+
+  g_free (path);
+  g_free (dir);
+}
+
+
+
+/* Thread function of the pools */
+static void
+queue_upload_entry (gchar *id, gpointer print)
+{
+  ScreenshooterQueueEntry *entry = queue_load_entry (id);
+  GError *error = NULL;
+  gchar *url = NULL;
+
+  /* The entry was cancelled meanwhile */
+  if (entry == NULL)
+    goto out;
+
+  TRACE ("Retry the upload of %s, attempt %d", id, entry->attempts + 1);
+
+  if (queue_send (entry, &url, &error))
+    {
+      TRACE ("%s uploaded to %s", id, url);
+
+      queue_log_upload (entry, url);
+      queue_remove_entry (entry);
+
+      if (print)
+        g_print ("%s %s\n", id, url);
+
+      g_free (url);
+    }
+  else
+    {
+      TRACE ("Upload of %s failed: %s", id, error->message);
+
+      entry->attempts++;
+      entry->next_attempt = (gint64) time (NULL) +
+                            queue_get_retry_delay (entry->attempts);
+      g_free (entry->last_error);
+      entry->last_error = g_strdup (error->message);
+
+      queue_save_entry (entry, NULL);
+
+      if (print)
+        g_printerr ("%s: %s\n", id, error->message);
+
+      g_error_free (error);
+    }
+
+  screenshooter_upload_queue_entry_free (entry);
+
+out:
+  G_LOCK (upload_queue);
+  if (queue_in_flight != NULL)
+    g_hash_table_remove (queue_in_flight, id);
+  G_UNLOCK (upload_queue);
+
+  g_free (id);
+}
+
+
+
+/* Pushes the entry to the pool, unless it is already being uploaded */
+static gboolean
+queue_push (GThreadPool *pool, const gchar *id)
+{
+  gboolean push = TRUE;
+
+  G_LOCK (upload_queue);
+
+  if (queue_in_flight == NULL)
+    queue_in_flight = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (g_hash_table_lookup (queue_in_flight, id) != NULL)
+    push = FALSE;
+  else
+    g_hash_table_insert (queue_in_flight, g_strdup (id), GINT_TO_POINTER (1));
+
+  G_UNLOCK (upload_queue);
+
+  if (push)
+    g_thread_pool_push (pool, g_strdup (id), NULL);
+
+  return push;
+}
+
+
+
+static gboolean
+cb_queue_check (gpointer unused)
+{
+  GList *entries = screenshooter_upload_queue_list ();
+  GList *l;
+  gint64 now = time (NULL);
+
+  for (l = entries; l != NULL; l = l->next)
+    {
+      ScreenshooterQueueEntry *entry = l->data;
+
+      if (entry->next_attempt <= now)
+        queue_push (queue_pool, entry->id);
+    }
+
+  g_list_foreach (entries, (GFunc) screenshooter_upload_queue_entry_free, NULL);
+  g_list_free (entries);
+
+  return TRUE;
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_upload_queue_is_transient_error:
+ * @error: an error returned by an upload.
+ *
+ * Return value: %TRUE if @error means that the host could not be reached
+ * or was not able to handle the upload, so that the same upload may work
+ * later.
+ **/
+gboolean
+screenshooter_upload_queue_is_transient_error (const GError *error)
+{
+  if (error == NULL || error->domain != SOUP_HTTP_ERROR)
+    return FALSE;
+
+  return (SOUP_STATUS_IS_TRANSPORT_ERROR (error->code) &&
+          error->code != SOUP_STATUS_CANCELLED &&
+          error->code != SOUP_STATUS_MALFORMED) ||
+         SOUP_STATUS_IS_SERVER_ERROR (error->code) ||
+         error->code == 429;
+}
+
+
+
+/**
+ * screenshooter_upload_queue_add:
+ * @backend: the service to upload to, only "imgur" for now.
+ * @image_path: the local path of the image.
+ * @title: the title of the image.
+ * @last_error: the message of the error which prevented the upload, or
+ * %NULL.
+ * @error: return location for errors.
+ *
+ * Copies the image to the queue so that the upload is retried later, even
+ * if the original file is deleted.
+ *
+ * Return value: %TRUE if the entry was added.
+ **/
+gboolean
+screenshooter_upload_queue_add (const gchar  *backend,
+                                const gchar  *image_path,
+                                const gchar  *title,
+                                const gchar  *last_error,
+                                GError      **error)
+{
+  ScreenshooterQueueEntry *entry;
+  GFile *source, *destination;
+  gchar *dir, *image;
+  gboolean result;
+
+  g_return_val_if_fail (backend != NULL, FALSE);
+  g_return_val_if_fail (image_path != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  entry = g_new0 (ScreenshooterQueueEntry, 1);
+  entry->added = (gint64) time (NULL);
+  entry->id = g_strdup_printf ("%" G_GINT64_FORMAT "-%08x",
+                               entry->added, g_random_int ());
+  entry->backend = g_strdup (backend);
+  entry->title = g_strdup (title);
+  entry->last_error = g_strdup (last_error);
+  entry->attempts = 1;
+  entry->next_attempt = entry->added + queue_get_retry_delay (entry->attempts);
+
+  dir = queue_get_dir ();
+  image = g_strconcat (entry->id, ".png", NULL);
+  entry->image_path = g_build_filename (dir, image, NULL);
+  g_free (image);
+  g_free (dir);
+
+  source = g_file_new_for_path (image_path);
+  destination = g_file_new_for_path (entry->image_path);
+
+  result = g_file_copy (source, destination, G_FILE_COPY_NONE,
+                        NULL, NULL, NULL, error) &&
+           queue_save_entry (entry, error);
+
+  if (!result)
+    g_file_delete (destination, NULL, NULL);
+  else
+    TRACE ("Queued %s as %s", image_path, entry->id);
+
+  g_object_unref (source);
+  g_object_unref (destination);
+  screenshooter_upload_queue_entry_free (entry);
+
+  return result;
+}
+
+
+
+/**
+ * screenshooter_upload_queue_list:
+ *
+ * Return value: a list of the #ScreenshooterQueueEntry<!---->s waiting to
+ * be uploaded, oldest first. Free the entries with
+ * screenshooter_upload_queue_entry_free() and the list with g_list_free().
+ **/
+GList
+*screenshooter_upload_queue_list (void)
+{
+  GList *entries = NULL;
+  gchar *path = queue_get_dir ();
+  GDir *dir = g_dir_open (path, 0, NULL);
+  const gchar *name;
+
+  g_free (path);
+
+  if (dir == NULL)
+    return NULL;
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      ScreenshooterQueueEntry *entry;
+      gchar *id;
+
+      if (!g_str_has_suffix (name, SCREENSHOOTER_QUEUE_ENTRY_SUFFIX))
+        continue;
+
+      id = g_strndup (name, strlen (name) - strlen (SCREENSHOOTER_QUEUE_ENTRY_SUFFIX));
+      entry = queue_load_entry (id);
+      g_free (id);
+
+      if (entry != NULL)
+        entries = g_list_prepend (entries, entry);
+    }
+
+  g_dir_close (dir);
+
+  return g_list_sort (entries, (GCompareFunc) queue_compare_entries);
+}
+
+
+
+/**
+ * screenshooter_upload_queue_entry_free:
+ * @entry: a #ScreenshooterQueueEntry.
+ *
+ * Frees @entry.
+ **/
+void
+screenshooter_upload_queue_entry_free (ScreenshooterQueueEntry *entry)
+{
+  if (entry == NULL)
+    return;
+
+  g_free (entry->id);
+  g_free (entry->backend);
+  g_free (entry->image_path);
+  g_free (entry->title);
+  g_free (entry->last_error);
+  g_free (entry);
+}
+
+
+
+/**
+ * screenshooter_upload_queue_cancel:
+ * @id: the id of an entry.
+ *
+ * Removes the entry @id from the queue, and deletes its copy of the image.
+ *
+ * Return value: %FALSE if there is no such entry.
+ **/
+gboolean
+screenshooter_upload_queue_cancel (const gchar *id)
+{
+  ScreenshooterQueueEntry *entry;
+
+  g_return_val_if_fail (id != NULL, FALSE);
+
+  entry = queue_load_entry (id);
+
+  if (entry == NULL)
+    return FALSE;
+
+  queue_remove_entry (entry);
+  screenshooter_upload_queue_entry_free (entry);
+
+  return TRUE;
+}
+
+
+
+/**
+ * screenshooter_upload_queue_flush:
+ *
+ * Retries all the entries of the queue now, without waiting for their
+ * next attempt time, and waits for the uploads to finish. The link of each
+ * uploaded image is printed on the standard output, the errors on the
+ * standard error.
+ *
+ * Return value: the number of entries still in the queue.
+ **/
+gint
+screenshooter_upload_queue_flush (void)
+{
+  GList *entries = screenshooter_upload_queue_list ();
+  GList *l;
+  GThreadPool *pool;
+  gint remaining;
+
+  pool = g_thread_pool_new ((GFunc) queue_upload_entry, GINT_TO_POINTER (TRUE),
+                            QUEUE_MAX_UPLOADS, FALSE, NULL);
+
+  for (l = entries; l != NULL; l = l->next)
+    queue_push (pool, ((ScreenshooterQueueEntry *) l->data)->id);
+
+  g_list_foreach (entries, (GFunc) screenshooter_upload_queue_entry_free, NULL);
+  g_list_free (entries);
+
+  /* Wait for all the uploads */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  entries = screenshooter_upload_queue_list ();
+  remaining = g_list_length (entries);
+
+  g_list_foreach (entries, (GFunc) screenshooter_upload_queue_entry_free, NULL);
+  g_list_free (entries);
+
+  return remaining;
+}
+
+
+
+/**
+ * screenshooter_upload_queue_start:
+ *
+ * Starts retrying the entries of the queue in the background, as soon as
+ * their next attempt time is reached. Needs a running main loop.
+ **/
+void
+screenshooter_upload_queue_start (void)
+{
+  if (queue_pool != NULL)
+    return;
+
+  queue_pool = g_thread_pool_new ((GFunc) queue_upload_entry,
+                                  GINT_TO_POINTER (FALSE),
+                                  QUEUE_MAX_UPLOADS, FALSE, NULL);
+
+  cb_queue_check (NULL);
+  queue_timer = g_timeout_add_seconds (QUEUE_CHECK_INTERVAL, cb_queue_check, NULL);
+}
+
+
+
+/**
+ * screenshooter_upload_queue_stop:
+ *
+ * Stops retrying the entries of the queue. Uploads which did not start yet
+ * are dropped, they stay in the queue, and the running ones are waited for.
+ **/
+void
+screenshooter_upload_queue_stop (void)
+{
+  if (queue_pool == NULL)
+    return;
+
+  g_source_remove (queue_timer);
+  queue_timer = 0;
+
+  g_thread_pool_free (queue_pool, TRUE, TRUE);
+  queue_pool = NULL;
+
+  /* Forget the dropped uploads */
+  G_LOCK (upload_queue);
+  if (queue_in_flight != NULL)
+    g_hash_table_remove_all (queue_in_flight);
+  G_UNLOCK (upload_queue);
+}
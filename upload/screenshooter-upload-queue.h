@@ -0,0 +1,44 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_UPLOAD_QUEUE_H__
+#define __HAVE_UPLOAD_QUEUE_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "screenshooter-upload-module.h"
+
+gboolean  screenshooter_upload_queue_is_transient_error (const GError            *error);
+gboolean  screenshooter_upload_queue_add                (const gchar             *backend,
+                                                         const gchar             *image_path,
+                                                         const gchar             *title,
+                                                         const gchar             *last_error,
+                                                         GError                 **error);
+GList    *screenshooter_upload_queue_list               (void);
+void      screenshooter_upload_queue_entry_free         (ScreenshooterQueueEntry *entry);
+gboolean  screenshooter_upload_queue_cancel             (const gchar             *id);
+gint      screenshooter_upload_queue_flush              (void);
+void      screenshooter_upload_queue_start              (void);
+void      screenshooter_upload_queue_stop               (void);
+
+#endif
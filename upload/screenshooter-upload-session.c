@@ -0,0 +1,577 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+/* HTTP session shared by all the uploads of the process.
+
+   The upload jobs used to create a new session each time, so each upload
+   paid the DNS resolution, the TCP connection and the TLS handshake. The
+   shared session keeps its connections alive between uploads, which in
+   processes uploading several files, or in the daemon, lets the next
+   upload to the same host start right away.
+
+   A synchronous session can be used from several threads at once, which
+   is what the upload jobs need.
+
+   Messages sent with screenshooter_upload_session_send() report the bytes
+   written, record how long each phase of the exchange took and are paced
+   so that all the uploads of the process together stay under the
+   bandwidth limit, if any.
+*/
+
+#include "screenshooter-upload-session.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+
+#define DEFAULT_MAX_CONNS          10
+#define DEFAULT_MAX_CONNS_PER_HOST 2
+
+/* Microseconds between two progress reports */
+#define PROGRESS_INTERVAL          (G_USEC_PER_SEC / 4)
+
+
+
+/* Times of the events of an exchange, in seconds since it started */
+typedef struct
+{
+  GTimer                          *timer;
+  ScreenshooterUploadProgressFunc  progress;
+  gpointer                         user_data;
+  goffset                          sent;
+  goffset                          total;
+  gint64                           last_report;
+
+  gdouble                          resolving;
+  gdouble                          resolved;
+  gdouble                          connecting;
+  gdouble                          connected;
+  gdouble                          tls_start;
+  gdouble                          tls_end;
+  gdouble                          ready;
+  gdouble                          wrote_body;
+  gdouble                          got_headers;
+}
+SendState;
+
+
+
+G_LOCK_DEFINE_STATIC (upload_session);
+static SoupSession *upload_session = NULL;
+static gint session_max_conns = DEFAULT_MAX_CONNS;
+static gint session_max_conns_per_host = DEFAULT_MAX_CONNS_PER_HOST;
+
+G_LOCK_DEFINE_STATIC (bandwidth);
+static gint64 bandwidth_limit = 0;
+static gint64 bandwidth_next = 0;
+
+static gboolean print_timings = FALSE;
+
+static const gchar *phase_names[SCREENSHOOTER_UPLOAD_N_PHASES] =
+  { "dns", "connect", "tls", "send", "wait", "parse" };
+
+
+
+static gboolean warm_up_job          (GIOSchedulerJob    *job,
+                                      GCancellable       *cancellable,
+                                      gchar              *uri);
+static void     bandwidth_throttle   (goffset             length);
+static void     cb_network_event     (SoupMessage        *msg,
+                                      GSocketClientEvent  event,
+                                      GIOStream          *connection,
+                                      SendState          *state);
+static void     cb_wrote_body_data   (SoupMessage        *msg,
+                                      SoupBuffer         *chunk,
+                                      SendState          *state);
+static void     cb_wrote_body        (SoupMessage        *msg,
+                                      SendState          *state);
+static void     cb_got_headers       (SoupMessage        *msg,
+                                      SendState          *state);
+
+
+
+/* Internals */
+
+
+
+static gboolean
+warm_up_job (GIOSchedulerJob *job, GCancellable *cancellable, gchar *uri)
+{
+  SoupSession *session = screenshooter_upload_session_get ();
+  SoupMessage *msg = soup_message_new ("HEAD", uri);
+
+  if (msg != NULL)
+    {
+      /* Whatever the status, the connection stays in the session */
+      soup_session_send_message (session, msg);
+      TRACE ("Connection to %s ready: %d", uri, msg->status_code);
+
+      g_object_unref (msg);
+    }
+
+  g_object_unref (session);
+
+  return FALSE;
+}
+
+
+
+/* Waits until @length more bytes fit the bandwidth limit. The time slots
+ * are shared by all the threads, so concurrent uploads split the limit. */
+static void
+bandwidth_throttle (goffset length)
+{
+  gint64 now, wait = 0;
+
+  G_LOCK (bandwidth);
+
+  if (bandwidth_limit > 0)
+    {
+      now = g_get_monotonic_time ();
+      bandwidth_next = MAX (bandwidth_next, now) +
+        length * G_USEC_PER_SEC / bandwidth_limit;
+      wait = bandwidth_next - now;
+    }
+
+  G_UNLOCK (bandwidth);
+
+  if (wait > 0)
+    g_usleep (wait);
+}
+
+
+
+static void
+cb_network_event (SoupMessage        *msg,
+                  GSocketClientEvent  event,
+                  GIOStream          *connection,
+                  SendState          *state)
+{
+  gdouble now = g_timer_elapsed (state->timer, NULL);
+
+  switch (event)
+    {
+    case G_SOCKET_CLIENT_RESOLVING:
+      state->resolving = now;
+      break;
+    case G_SOCKET_CLIENT_RESOLVED:
+      state->resolved = now;
+      break;
+    case G_SOCKET_CLIENT_CONNECTING:
+      state->connecting = now;
+      break;
+    case G_SOCKET_CLIENT_CONNECTED:
+      state->connected = now;
+      break;
+    case G_SOCKET_CLIENT_TLS_HANDSHAKING:
+      state->tls_start = now;
+      break;
+    case G_SOCKET_CLIENT_TLS_HANDSHAKED:
+      state->tls_end = now;
+      break;
+    case G_SOCKET_CLIENT_COMPLETE:
+      state->ready = now;
+      break;
+    default:
+      break;
+    }
+}
+
+
+
+static void
+cb_wrote_body_data (SoupMessage *msg, SoupBuffer *chunk, SendState *state)
+{
+  gint64 now;
+
+  state->sent += chunk->length;
+  bandwidth_throttle (chunk->length);
+
+  if (state->progress == NULL)
+    return;
+
+  now = g_get_monotonic_time ();
+
+  if (now - state->last_report >= PROGRESS_INTERVAL ||
+      state->sent == state->total)
+    {
+      state->last_report = now;
+      state->progress (state->sent, state->total,
+                       g_timer_elapsed (state->timer, NULL), state->user_data);
+    }
+}
+
+
+
+static void
+cb_wrote_body (SoupMessage *msg, SendState *state)
+{
+  state->wrote_body = g_timer_elapsed (state->timer, NULL);
+}
+
+
+
+static void
+cb_got_headers (SoupMessage *msg, SendState *state)
+{
+  /* Informational responses are not the answer of the server */
+  if (!SOUP_STATUS_IS_INFORMATIONAL (msg->status_code))
+    state->got_headers = g_timer_elapsed (state->timer, NULL);
+}
+
+
+
+/* Public */
+
+
+
+/**
+ * screenshooter_upload_session_get:
+ *
+ * Returns the session shared by the uploads, creating it if needed. The
+ * proxy set in the http_proxy environment variable is used.
+ *
+ * Return value: a new reference to the shared #SoupSession, which should
+ * be released with g_object_unref() once the upload is finished.
+ **/
+SoupSession
+*screenshooter_upload_session_get (void)
+{
+  SoupSession *session;
+
+  G_LOCK (upload_session);
+
+  if (upload_session == NULL)
+    {
+      const gchar *proxy_uri;
+#if DEBUG > 0
+      SoupLogger *log;
+#endif
+
+      TRACE ("Create the upload session");
+
+      upload_session =
+        soup_session_sync_new_with_options (SOUP_SESSION_MAX_CONNS,
+                                            session_max_conns,
+                                            SOUP_SESSION_MAX_CONNS_PER_HOST,
+                                            session_max_conns_per_host,
+                                            NULL);
+
+      /* Set the proxy URI if any */
+      proxy_uri = g_getenv ("http_proxy");
+
+      if (proxy_uri != NULL)
+        {
+          SoupURI *soup_proxy_uri = soup_uri_new (proxy_uri);
+
+          g_object_set (upload_session, "proxy-uri", soup_proxy_uri, NULL);
+          soup_uri_free (soup_proxy_uri);
+        }
+
+#if DEBUG > 0
+      log = soup_logger_new (SOUP_LOGGER_LOG_HEADERS, -1);
+      soup_session_add_feature (upload_session, (SoupSessionFeature *)log);
+      g_object_unref (log);
+#endif
+    }
+
+  session = g_object_ref (upload_session);
+
+  G_UNLOCK (upload_session);
+
+  return session;
+}
+
+
+
+/**
+ * screenshooter_upload_session_configure:
+ * @max_conns: the maximum number of connections of the session.
+ * @max_conns_per_host: the maximum number of connections to a given host.
+ *
+ * Sets the connection limits of the shared session. Values lower than 1
+ * restore the defaults.
+ **/
+void
+screenshooter_upload_session_configure (gint max_conns,
+                                        gint max_conns_per_host)
+{
+  G_LOCK (upload_session);
+
+  session_max_conns =
+    (max_conns > 0) ? max_conns : DEFAULT_MAX_CONNS;
+  session_max_conns_per_host =
+    (max_conns_per_host > 0) ? max_conns_per_host : DEFAULT_MAX_CONNS_PER_HOST;
+
+  if (upload_session != NULL)
+    g_object_set (upload_session,
+                  SOUP_SESSION_MAX_CONNS, session_max_conns,
+                  SOUP_SESSION_MAX_CONNS_PER_HOST, session_max_conns_per_host,
+                  NULL);
+
+  G_UNLOCK (upload_session);
+}
+
+
+
+/**
+ * screenshooter_upload_session_warm_up:
+ * @uri: the URI which is going to be requested.
+ *
+ * Opens a connection to the host of @uri in a thread, by sending a HEAD
+ * request. This resolves the host name, connects and does the TLS
+ * handshake while the screenshot is being taken, so that the upload can
+ * be sent as soon as the image is saved.
+ **/
+void
+screenshooter_upload_session_warm_up (const gchar *uri)
+{
+  g_return_if_fail (uri != NULL);
+
+  TRACE ("Open a connection to %s", uri);
+
+  g_io_scheduler_push_job ((GIOSchedulerJobFunc) warm_up_job,
+                           g_strdup (uri), g_free,
+                           G_PRIORITY_DEFAULT, NULL);
+}
+
+
+
+/**
+ * screenshooter_upload_session_shutdown:
+ *
+ * Releases the shared session. The uploads still running keep their own
+ * reference, the idle connections are closed once they are finished.
+ **/
+void
+screenshooter_upload_session_shutdown (void)
+{
+  SoupSession *session;
+
+  G_LOCK (upload_session);
+
+  session = upload_session;
+  upload_session = NULL;
+
+  G_UNLOCK (upload_session);
+
+  if (session != NULL)
+    g_object_unref (session);
+}
+
+
+
+/**
+ * screenshooter_upload_session_set_bandwidth_limit:
+ * @kib_per_second: the maximum upload rate in KiB per second, or 0 for
+ * no limit.
+ *
+ * Limits the rate at which all the messages sent with
+ * screenshooter_upload_session_send() write their bodies, so that
+ * background uploads leave room for the other users of the link.
+ **/
+void
+screenshooter_upload_session_set_bandwidth_limit (gint kib_per_second)
+{
+  G_LOCK (bandwidth);
+
+  bandwidth_limit = MAX (kib_per_second, 0) * (gint64) 1024;
+  bandwidth_next = 0;
+
+  G_UNLOCK (bandwidth);
+}
+
+
+
+/**
+ * screenshooter_upload_session_set_print_timings:
+ * @print: whether screenshooter_upload_timings_report() should print the
+ * timings.
+ *
+ * Enables the output of the timings of the uploads on stderr.
+ **/
+void
+screenshooter_upload_session_set_print_timings (gboolean print)
+{
+  print_timings = print;
+}
+
+
+
+/**
+ * screenshooter_upload_session_send:
+ * @session: the #SoupSession, usually the shared one.
+ * @msg: the #SoupMessage to send.
+ * @progress: function called regularly with the number of bytes of the
+ * body which were written, or %NULL.
+ * @user_data: data passed to @progress.
+ * @timings: return location for the timings of the exchange, or %NULL.
+ *
+ * Sends @msg and waits for the answer, like soup_session_send_message(),
+ * while applying the bandwidth limit. @progress is called from the
+ * current thread. The phases which did not happen, such as the
+ * connection when an idle one was reused, are reported as 0. The parse
+ * phase is left to the caller.
+ *
+ * Return value: the status code of @msg.
+ **/
+guint
+screenshooter_upload_session_send (SoupSession                     *session,
+                                   SoupMessage                     *msg,
+                                   ScreenshooterUploadProgressFunc  progress,
+                                   gpointer                         user_data,
+                                   ScreenshooterUploadTimings      *timings)
+{
+  SendState state = { NULL, };
+  guint status;
+  gdouble end;
+
+  g_return_val_if_fail (SOUP_IS_SESSION (session), SOUP_STATUS_NONE);
+  g_return_val_if_fail (SOUP_IS_MESSAGE (msg), SOUP_STATUS_NONE);
+
+  state.timer = g_timer_new ();
+  state.progress = progress;
+  state.user_data = user_data;
+  state.total = soup_message_headers_get_content_length (msg->request_headers);
+
+  if (state.total <= 0)
+    state.total = msg->request_body->length;
+
+  g_signal_connect (msg, "network-event", G_CALLBACK (cb_network_event), &state);
+  g_signal_connect (msg, "wrote-body-data", G_CALLBACK (cb_wrote_body_data), &state);
+  g_signal_connect (msg, "wrote-body", G_CALLBACK (cb_wrote_body), &state);
+  g_signal_connect (msg, "got-headers", G_CALLBACK (cb_got_headers), &state);
+
+  status = soup_session_send_message (session, msg);
+  end = g_timer_elapsed (state.timer, NULL);
+
+  g_signal_handlers_disconnect_matched (msg, G_SIGNAL_MATCH_DATA,
+                                        0, 0, NULL, NULL, &state);
+
+  if (timings != NULL)
+    {
+      memset (timings, 0, sizeof (ScreenshooterUploadTimings));
+
+      if (state.resolved > 0)
+        timings->phases[SCREENSHOOTER_UPLOAD_PHASE_DNS] =
+          state.resolved - state.resolving;
+      if (state.connected > 0)
+        timings->phases[SCREENSHOOTER_UPLOAD_PHASE_CONNECT] =
+          state.connected - state.connecting;
+      if (state.tls_end > 0)
+        timings->phases[SCREENSHOOTER_UPLOAD_PHASE_TLS] =
+          state.tls_end - state.tls_start;
+      if (state.wrote_body > 0)
+        timings->phases[SCREENSHOOTER_UPLOAD_PHASE_SEND] =
+          state.wrote_body - state.ready;
+      if (state.got_headers > 0 && state.wrote_body > 0)
+        timings->phases[SCREENSHOOTER_UPLOAD_PHASE_WAIT] =
+          state.got_headers - state.wrote_body;
+
+      timings->total = end;
+      timings->sent = state.sent;
+    }
+
+  g_timer_destroy (state.timer);
+
+  return status;
+}
+
+
+
+/**
+ * screenshooter_upload_timings_to_string:
+ * @timings: the timings of an upload.
+ *
+ * Return value: a newly allocated description of @timings to show to the
+ * user.
+ **/
+gchar
+*screenshooter_upload_timings_to_string (const ScreenshooterUploadTimings *timings)
+{
+  gchar *size, *rate, *text;
+
+  g_return_val_if_fail (timings != NULL, NULL);
+
+  size = g_format_size (timings->sent);
+  rate = g_format_size (timings->phases[SCREENSHOOTER_UPLOAD_PHASE_SEND] > 0 ?
+                        (guint64) (timings->sent /
+                                   timings->phases[SCREENSHOOTER_UPLOAD_PHASE_SEND]) :
+                        0);
+
+  text = g_strdup_printf (_("%s sent in %.2f s (%s/s). DNS: %.2f s, connection:"
+                            " %.2f s, TLS: %.2f s, sending: %.2f s, server:"
+                            " %.2f s, reading the answer: %.2f s"),
+                          size, timings->total, rate,
+                          timings->phases[SCREENSHOOTER_UPLOAD_PHASE_DNS],
+                          timings->phases[SCREENSHOOTER_UPLOAD_PHASE_CONNECT],
+                          timings->phases[SCREENSHOOTER_UPLOAD_PHASE_TLS],
+                          timings->phases[SCREENSHOOTER_UPLOAD_PHASE_SEND],
+                          timings->phases[SCREENSHOOTER_UPLOAD_PHASE_WAIT],
+                          timings->phases[SCREENSHOOTER_UPLOAD_PHASE_PARSE]);
+
+  g_free (size);
+  g_free (rate);
+
+  return text;
+}
+
+
+
+/**
+ * screenshooter_upload_timings_report:
+ * @service: the name of the service the file was sent to.
+ * @timings: the timings of the upload.
+ *
+ * Prints @timings on stderr as a single line of tab separated
+ * name=value fields, if it was enabled with
+ * screenshooter_upload_session_set_print_timings(). Durations are in
+ * seconds. The line can be written from any thread.
+ **/
+void
+screenshooter_upload_timings_report (const gchar                      *service,
+                                     const ScreenshooterUploadTimings *timings)
+{
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+  GString *line;
+  gint i;
+
+  g_return_if_fail (timings != NULL);
+
+  if (!print_timings)
+    return;
+
+  line = g_string_new ("timings");
+  g_string_append_printf (line, "\tservice=%s", service != NULL ? service : "");
+
+  /* Not localized, the decimal separator is always a dot */
+  for (i = 0; i < SCREENSHOOTER_UPLOAD_N_PHASES; i++)
+    g_string_append_printf (line, "\t%s=%s", phase_names[i],
+                            g_ascii_formatd (buffer, sizeof (buffer), "%.3f",
+                                             timings->phases[i]));
+
+  g_string_append_printf (line, "\ttotal=%s\tbytes=%" G_GINT64_FORMAT "\n",
+                          g_ascii_formatd (buffer, sizeof (buffer), "%.3f",
+                                           timings->total),
+                          (gint64) timings->sent);
+
+  /* A single write, so that lines of concurrent uploads do not mix */
+  fputs (line->str, stderr);
+  g_string_free (line, TRUE);
+}
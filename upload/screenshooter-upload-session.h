@@ -0,0 +1,76 @@
+/*  $Id$
+ *
+ *  Copyright © 2008-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+#ifndef __HAVE_UPLOAD_SESSION_H__
+#define __HAVE_UPLOAD_SESSION_H__
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+/* Phases of an HTTP exchange, see screenshooter_upload_session_send() */
+typedef enum
+{
+  SCREENSHOOTER_UPLOAD_PHASE_DNS,
+  SCREENSHOOTER_UPLOAD_PHASE_CONNECT,
+  SCREENSHOOTER_UPLOAD_PHASE_TLS,
+  SCREENSHOOTER_UPLOAD_PHASE_SEND,
+  SCREENSHOOTER_UPLOAD_PHASE_WAIT,
+  SCREENSHOOTER_UPLOAD_PHASE_PARSE,
+  SCREENSHOOTER_UPLOAD_N_PHASES
+}
+ScreenshooterUploadPhase;
+
+/* Durations are in seconds */
+typedef struct
+{
+  gdouble phases[SCREENSHOOTER_UPLOAD_N_PHASES];
+  gdouble total;
+  goffset sent;
+}
+ScreenshooterUploadTimings;
+
+typedef void (*ScreenshooterUploadProgressFunc) (goffset  sent,
+                                                 goffset  total,
+                                                 gdouble  elapsed,
+                                                 gpointer user_data);
+
+SoupSession *screenshooter_upload_session_get       (void);
+void         screenshooter_upload_session_configure (gint max_conns,
+                                                     gint max_conns_per_host);
+void         screenshooter_upload_session_warm_up   (const gchar *uri);
+void         screenshooter_upload_session_shutdown  (void);
+void         screenshooter_upload_session_set_bandwidth_limit
+                                                    (gint kib_per_second);
+void         screenshooter_upload_session_set_print_timings
+                                                    (gboolean print);
+guint        screenshooter_upload_session_send      (SoupSession                     *session,
+                                                     SoupMessage                     *msg,
+                                                     ScreenshooterUploadProgressFunc  progress,
+                                                     gpointer                         user_data,
+                                                     ScreenshooterUploadTimings      *timings);
+gchar       *screenshooter_upload_timings_to_string (const ScreenshooterUploadTimings *timings);
+void         screenshooter_upload_timings_report    (const gchar                      *service,
+                                                     const ScreenshooterUploadTimings *timings);
+
+#endif
@@ -0,0 +1,909 @@
+/*  $Id$
+ *
+ *  Copyright © 2009-2010 Jérôme Guelfucci <jeromeg@xfce.org>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * */
+
+
+/* XML-RPC API for ZimageZ */
+
+/* URL of the API: http://www.zimagez.com/apiXml.php
+
+   xmlrpcLogin: Takes the user name and the password (encrypted using rot13 and
+   reversed using g_strrev.
+   Returns a string containing the ID for the user session if the couple was correct.
+   Returns a boolean set to FALSE if the couple was wrong.
+
+   xmlrpcLogout: destroys the current user session.
+
+   xmlrpcUpload: Takes the file content encoded in base64, the name of the file,
+   the title of the picture, a comment and the user session ID.
+   Returns the name of the file on the website if the upload was succesful.
+   Returns a boolean set to FALSE if the upload failed.
+
+   If the returned name is "wii0". The URLs will be:
+   * http://www.zimagez.com/zimage/wii0.php for the image.
+   * http://www.zimagez.com/miniature/wii0.jpg for the thumbnail.
+   * http://www.zimagez.com/avatar/wii0.jpg for the avatar.
+
+*/
+
+#include "screenshooter-zimagez.h"
+#include "screenshooter-job-callbacks.h"
+#include "screenshooter-stream-body.h"
+#include "screenshooter-upload-session.h"
+
+#define ZIMAGEZ_METHOD_LOGIN  "apiXml.xmlrpcLogin"
+#define ZIMAGEZ_METHOD_LOGOUT "apiXml.xmlrpcLogout"
+#define ZIMAGEZ_METHOD_UPLOAD "apiXml.xmlrpcUpload"
+
+/* The user session is kept open between uploads, so that long-lived
+ * processes such as the daemon only log in once. The upload jobs run in
+ * threads. */
+G_LOCK_DEFINE_STATIC (zimagez_session);
+static gchar *session_user = NULL;
+static gchar *session_password = NULL;
+static gchar *session_id = NULL;
+
+static gboolean          send_xmlrpc               (SoupSession       *session,
+                                                    SoupMessage       *msg,
+                                                    GError           **error,
+                                                    GValue            *retval);
+static gboolean          do_xmlrpc                 (SoupSession       *session,
+                                                    const gchar       *uri,
+                                                    const gchar       *method,
+                                                    GError           **error,
+                                                    GValue            *retval,
+                                                    ...);
+static gboolean          do_xmlrpc_upload          (SoupSession       *session,
+                                                    const gchar       *uri,
+                                                    const gchar       *method,
+                                                    const gchar       *image_path,
+                                                    GError           **error,
+                                                    GValue            *retval,
+                                                    ...);
+static gboolean          has_empty_field           (GtkListStore      *liststore);
+static gboolean          zimagez_login             (SoupSession       *session,
+                                                    const gchar       *user,
+                                                    const gchar       *password,
+                                                    gchar            **login_response,
+                                                    GError           **error);
+static gchar            *zimagez_forget_session    (void);
+static void              zimagez_close_session     (SoupSession       *session);
+static void              zimagez_read_fields       (GtkListStore      *liststore,
+                                                    gchar            **user,
+                                                    gchar            **password,
+                                                    gchar            **title,
+                                                    gchar            **comment);
+static gboolean          zimagez_ask_and_login     (ScreenshooterJob  *job,
+                                                    SoupSession       *session,
+                                                    GtkListStore      *liststore,
+                                                    const gchar       *message,
+                                                    gchar            **user,
+                                                    gchar            **password,
+                                                    gchar            **title,
+                                                    gchar            **comment,
+                                                    gchar            **login_response,
+                                                    GError           **error);
+static gboolean          zimagez_upload_job        (ScreenshooterJob  *job,
+                                                    GArray            *param_values,
+                                                    GError           **error);
+
+
+/* Private */
+
+
+
+static gboolean
+do_xmlrpc (SoupSession *session, const gchar *uri, const gchar *method,
+           GError **error, GValue *retval, ...)
+{
+  SoupMessage *msg;
+  va_list args;
+  GArray *params = g_array_sized_new(FALSE, FALSE, sizeof(GValue), 1);
+  GError *err = NULL;
+  char *body;
+  GType type;
+  GValue val;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  va_start (args, retval);
+
+  //copy soup_value_array_from_args() in here and change datatypes respectivly
+  while ((type = va_arg (args, GType)) != G_TYPE_INVALID)
+  {
+    SOUP_VALUE_SETV (&val, type, args);
+    g_array_append_val (params, val);
+  }
+
+  va_end (args);
+
+  body = soup_xmlrpc_build_method_call (method, (GValue*)params->data,
+                                   params->len);
+  g_array_unref (params);
+
+  if (!body)
+    {
+      err = g_error_new (SOUP_XMLRPC_FAULT,
+                         SOUP_XMLRPC_FAULT_APPLICATION_ERROR,
+                         _("An error occurred while creating the XMLRPC"
+                           " request."));
+      g_propagate_error (error, err);
+
+      return FALSE;
+    }
+
+  msg = soup_message_new ("POST", uri);
+  soup_message_set_request (msg, "text/xml", SOUP_MEMORY_TAKE,
+                            body, strlen (body));
+
+  return send_xmlrpc (session, msg, error, retval);
+}
+
+
+
+/* Same as do_xmlrpc, except that the first parameter of the method is the
+ * file at @image_path, encoded in base64. The request body is streamed from
+ * the file, see screenshooter-stream-body.c. The other parameters must be
+ * strings. */
+static gboolean
+do_xmlrpc_upload (SoupSession *session, const gchar *uri, const gchar *method,
+                  const gchar *image_path, GError **error, GValue *retval, ...)
+{
+  ScreenshooterStreamBody *body;
+  SoupMessage *msg;
+  const gchar *param;
+  gchar *escaped;
+  va_list args;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  body = screenshooter_stream_body_new ();
+
+  escaped = g_markup_escape_text (method, -1);
+  screenshooter_stream_body_append_data (body, "<?xml version=\"1.0\"?>\n"
+                                         "<methodCall><methodName>", -1);
+  screenshooter_stream_body_append_data (body, escaped, -1);
+  screenshooter_stream_body_append_data (body, "</methodName><params>"
+                                         "<param><value><string>", -1);
+  g_free (escaped);
+
+  if (!screenshooter_stream_body_append_file (body, image_path, TRUE, error))
+    {
+      screenshooter_stream_body_free (body);
+
+      return FALSE;
+    }
+
+  screenshooter_stream_body_append_data (body, "</string></value></param>", -1);
+
+  va_start (args, retval);
+
+  while ((param = va_arg (args, const gchar *)) != NULL)
+    {
+      escaped = g_markup_escape_text (param, -1);
+      screenshooter_stream_body_append_data (body, "<param><value><string>", -1);
+      screenshooter_stream_body_append_data (body, escaped, -1);
+      screenshooter_stream_body_append_data (body, "</string></value></param>", -1);
+      g_free (escaped);
+    }
+
+  va_end (args);
+
+  screenshooter_stream_body_append_data (body, "</params></methodCall>", -1);
+
+  msg = soup_message_new ("POST", uri);
+  screenshooter_stream_body_attach (body, session, msg, "text/xml");
+
+  return send_xmlrpc (session, msg, error, retval);
+}
+
+
+
+/* Sends @msg and parses the XMLRPC response into @retval. Consumes @msg. */
+static gboolean
+send_xmlrpc (SoupSession *session, SoupMessage *msg, GError **error,
+             GValue *retval)
+{
+  GError *err = NULL;
+
+  screenshooter_upload_session_send (session, msg, NULL, NULL, NULL);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+    {
+      TRACE ("Error during the XMLRPC exchange: %d %s\n",
+             msg->status_code, msg->reason_phrase);
+
+      err = g_error_new (SOUP_XMLRPC_FAULT,
+                         SOUP_XMLRPC_FAULT_TRANSPORT_ERROR,
+                         _("An error occurred while transferring the data"
+                           " to ZimageZ."));
+      g_propagate_error (error, err);
+      g_object_unref (msg);
+
+      return FALSE;
+    }
+
+  if (!soup_xmlrpc_parse_method_response (msg->response_body->data,
+                                          msg->response_body->length,
+                                          retval, &err))
+    {
+      if (err)
+        {
+          TRACE ("Fault when parsing the response: %d %s\n",
+                 err->code, err->message);
+
+          g_propagate_error (error, err);
+        }
+      else
+        {
+          TRACE ("Unable to parse the response, and no error...");
+
+          err = g_error_new (SOUP_XMLRPC_FAULT,
+                             SOUP_XMLRPC_FAULT_APPLICATION_ERROR,
+                             _("An error occurred while parsing the response"
+                               " from ZimageZ."));
+          g_propagate_error (error, err);
+        }
+
+      g_object_unref (msg);
+      return FALSE;
+    }
+
+  g_object_unref (msg);
+
+  return TRUE;
+}
+
+
+
+static gboolean
+has_empty_field (GtkListStore *liststore)
+{
+  GtkTreeIter iter;
+  gboolean result = FALSE;
+
+  gtk_tree_model_get_iter_first (GTK_TREE_MODEL (liststore), &iter);
+
+  do
+    {
+      gchar *field = NULL;
+
+      gtk_tree_model_get (GTK_TREE_MODEL (liststore), &iter, 1, &field, -1);
+      result = result || g_str_equal (field, "");
+
+      g_free (field);
+
+    }
+  while (gtk_tree_model_iter_next (GTK_TREE_MODEL (liststore), &iter));
+
+  return result;
+}
+
+
+
+/* Logs @user in. Returns FALSE if an error occurred. If the user and the
+ * password do not match, returns TRUE and sets @login_response to NULL. */
+static gboolean
+zimagez_login (SoupSession  *session,
+               const gchar  *user,
+               const gchar  *password,
+               gchar       **login_response,
+               GError      **error)
+{
+  GValue response_value = { 0, };
+  gchar *encoded_password;
+  gchar *tmp;
+
+  g_return_val_if_fail (login_response != NULL && *login_response == NULL, FALSE);
+
+  /* rot13 works in place */
+  tmp = g_strdup (password);
+  encoded_password = g_utf8_strreverse (rot13 (tmp), -1);
+  g_free (tmp);
+
+  TRACE ("User: %s", user);
+  TRACE ("Encoded password: %s", encoded_password);
+
+  /* Start the user session */
+  TRACE ("Call the login method");
+
+  if (!do_xmlrpc (session, ZIMAGEZ_API_URL, ZIMAGEZ_METHOD_LOGIN,
+                  error, &response_value,
+                  G_TYPE_STRING, user,
+                  G_TYPE_STRING, encoded_password,
+                  G_TYPE_INVALID))
+    {
+      g_free (encoded_password);
+
+      return FALSE;
+    }
+
+  g_free (encoded_password);
+
+  TRACE ("Read the login response");
+
+  /* If the response is a boolean, the user and the password do not match */
+  if (G_VALUE_HOLDS_BOOLEAN (&response_value))
+    {
+      g_value_unset (&response_value);
+
+      return TRUE;
+    }
+  /* Else we read the string response to get the session ID */
+  else if (G_VALUE_HOLDS_STRING (&response_value))
+    {
+      TRACE ("Read the session ID");
+      *login_response = g_value_dup_string (&response_value);
+      g_value_unset (&response_value);
+
+      /* Keep the session for the next uploads */
+      G_LOCK (zimagez_session);
+
+      g_free (session_user);
+      g_free (session_password);
+      g_free (session_id);
+
+      session_user = g_strdup (user);
+      session_password = g_strdup (password);
+      session_id = g_strdup (*login_response);
+
+      G_UNLOCK (zimagez_session);
+
+      return TRUE;
+    }
+
+  /* We received an unexpected reply */
+  g_value_unset (&response_value);
+
+  g_set_error (error,
+               SOUP_XMLRPC_FAULT,
+               SOUP_XMLRPC_FAULT_PARSE_ERROR_NOT_WELL_FORMED,
+               "%s", _("An unexpected reply from ZimageZ was received."
+                       " The upload of the screenshot failed."));
+
+  return FALSE;
+}
+
+
+
+/* Forgets the session kept between uploads and returns its ID, which
+ * should be freed. */
+static gchar
+*zimagez_forget_session (void)
+{
+  gchar *id;
+
+  G_LOCK (zimagez_session);
+
+  id = session_id;
+  session_id = NULL;
+
+  g_free (session_user);
+  session_user = NULL;
+
+  g_free (session_password);
+  session_password = NULL;
+
+  G_UNLOCK (zimagez_session);
+
+  return id;
+}
+
+
+
+/* Closes the session kept between uploads on ZimageZ, if any */
+static void
+zimagez_close_session (SoupSession *session)
+{
+  GValue response_value = { 0, };
+  gchar *id = zimagez_forget_session ();
+
+  if (id == NULL)
+    return;
+
+  TRACE ("Closing the user session");
+
+  if (do_xmlrpc (session, ZIMAGEZ_API_URL, ZIMAGEZ_METHOD_LOGOUT,
+                 NULL, &response_value,
+                 G_TYPE_STRING, id,
+                 G_TYPE_INVALID))
+    {
+      g_value_unset (&response_value);
+    }
+
+  g_free (id);
+}
+
+
+
+/* Replaces the information items with the values entered in @liststore */
+static void
+zimagez_read_fields (GtkListStore  *liststore,
+                     gchar        **user,
+                     gchar        **password,
+                     gchar        **title,
+                     gchar        **comment)
+{
+  GtkTreeIter iter;
+
+  gtk_tree_model_get_iter_first (GTK_TREE_MODEL (liststore), &iter);
+
+  do
+    {
+      gint field_index;
+      gchar *field_value = NULL;
+
+      gtk_tree_model_get (GTK_TREE_MODEL (liststore), &iter,
+                          0, &field_index,
+                          1, &field_value,
+                          -1);
+
+      switch (field_index)
+        {
+          case USER:
+            g_free (*user);
+            *user = g_strdup (field_value);
+            break;
+          case PASSWORD:
+            g_free (*password);
+            *password = g_strdup (field_value);
+            break;
+          case TITLE:
+            g_free (*title);
+            *title = g_strdup (field_value);
+            break;
+          case COMMENT:
+            g_free (*comment);
+            *comment = g_strdup (field_value);
+            break;
+          default:
+            break;
+        }
+
+      g_free (field_value);
+    }
+  while (gtk_tree_model_iter_next (GTK_TREE_MODEL (liststore), &iter));
+}
+
+
+
+/* Asks the user to fill the information items with @message, then logs in
+ * until the user and the password match. Returns FALSE if an error
+ * occurred or if the job was cancelled. */
+static gboolean
+zimagez_ask_and_login (ScreenshooterJob  *job,
+                       SoupSession       *session,
+                       GtkListStore      *liststore,
+                       const gchar       *message,
+                       gchar            **user,
+                       gchar            **password,
+                       gchar            **title,
+                       gchar            **comment,
+                       gchar            **login_response,
+                       GError           **error)
+{
+  GtkTreeIter iter;
+  GError *tmp_error = NULL;
+
+  TRACE ("Ask the user to fill the information items.");
+  screenshooter_job_ask_info (job, liststore, message);
+  zimagez_read_fields (liststore, user, password, title, comment);
+
+  while (TRUE)
+    {
+      if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+        {
+          TRACE ("The upload job was cancelled.");
+          return FALSE;
+        }
+
+      exo_job_info_message (EXO_JOB (job), _("Check the user information..."));
+
+      /* Test if one of the information fields is empty */
+      if (has_empty_field (liststore))
+        {
+          TRACE ("One of the fields was empty, let the user file it.");
+          screenshooter_job_ask_info (job, liststore,
+                                      _("<span weight=\"bold\" foreground=\"darkred\" "
+                                        "stretch=\"semiexpanded\">You must fill all the "
+                                        "fields.</span>"));
+          zimagez_read_fields (liststore, user, password, title, comment);
+          continue;
+        }
+
+      /* Another user might still be logged in */
+      zimagez_close_session (session);
+
+      exo_job_info_message (EXO_JOB (job), _("Login on ZimageZ..."));
+
+      if (!zimagez_login (session, *user, *password, login_response, &tmp_error))
+        {
+          g_propagate_error (error, tmp_error);
+          return FALSE;
+        }
+
+      if (*login_response != NULL)
+        return TRUE;
+
+      /* Login failed, erase the password and ask for the correct on to the
+         user */
+      gtk_tree_model_get_iter_first (GTK_TREE_MODEL (liststore), &iter);
+
+      do
+        {
+          gint field_index;
+
+          gtk_tree_model_get (GTK_TREE_MODEL (liststore), &iter, 0, &field_index, -1);
+
+          if (field_index == PASSWORD)
+            {
+              gtk_list_store_set (liststore, &iter, 1, "", -1);
+              break;
+            }
+        }
+      while (gtk_tree_model_iter_next (GTK_TREE_MODEL (liststore), &iter));
+
+      screenshooter_job_ask_info (job, liststore,
+                                  _("<span weight=\"bold\" foreground=\"darkred\" "
+                                    "stretch=\"semiexpanded\">The user and the "
+                                    "password you entered do not match. "
+                                    "Please retry.</span>"));
+      zimagez_read_fields (liststore, user, password, title, comment);
+    }
+}
+
+
+
+static gboolean
+zimagez_upload_job (ScreenshooterJob *job, GArray *param_values, GError **error)
+{
+  const gchar *image_path;
+  const gchar *last_user;
+  /* For translators: the first wildcard is the date, the second one the time,
+   * e.g. "Taken on 12/31/99, at 23:13:48". */
+  gchar *comment = screenshooter_get_datetime (_("Taken on %x, at %X"));
+  gchar *file_name = NULL;
+  gchar *login_response = NULL;
+  gchar *online_file_name = NULL;
+  gchar *password = g_strdup ("");
+  gchar *title;
+  gchar *user;
+
+  gboolean cached_session = FALSE;
+
+  SoupSession *session;
+
+  GError *tmp_error = NULL;
+  GtkTreeIter iter;
+  GtkListStore *liststore;
+  GValue response_value = { 0, };
+
+  g_return_val_if_fail (SCREENSHOOTER_IS_JOB (job), FALSE);
+  g_return_val_if_fail (param_values != NULL, FALSE);
+  g_return_val_if_fail (param_values->len == 3, FALSE);
+  g_return_val_if_fail (G_VALUE_HOLDS_STRING (g_array_index (param_values, GValue*, 0)), FALSE);
+  g_return_val_if_fail (G_VALUE_HOLDS_STRING (g_array_index (param_values, GValue*, 1)), FALSE);
+  g_return_val_if_fail (G_VALUE_HOLDS_STRING (g_array_index (param_values, GValue*, 2)), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_object_set_data (G_OBJECT (job), "jobtype", "zimagez");
+  if (exo_job_set_error_if_cancelled (EXO_JOB (job), error))
+    {
+      g_free (comment);
+      g_free (password);
+
+      return FALSE;
+    }
+
+  /* Get the last user */
+  last_user = g_value_get_string (g_array_index (param_values, GValue*, 1));
+  user = g_strdup (last_user);
+
+  if (user == NULL)
+    user = g_strdup ("");
+
+  if (!g_utf8_validate (user, -1, NULL))
+    {
+      g_free (user);
+      user = g_strdup ("");
+    }
+
+  g_object_set_data_full (G_OBJECT (job), "user",
+                          g_strdup (user), (GDestroyNotify) g_free);
+
+  /* Reuse the session of the previous upload if this user is still
+   * logged in, without asking anything */
+  G_LOCK (zimagez_session);
+
+  if (session_id != NULL && g_str_equal (session_user, user))
+    {
+      g_free (password);
+      password = g_strdup (session_password);
+      login_response = g_strdup (session_id);
+      cached_session = TRUE;
+    }
+
+  G_UNLOCK (zimagez_session);
+
+  /* Get the default title */
+  title = g_strdup (g_value_get_string (g_array_index (param_values, GValue*, 2)));
+  if (title == NULL)
+    title = g_strdup ("");
+
+  if (!g_utf8_validate (title, -1, NULL))
+    {
+      g_free (title);
+      title = g_strdup ("");
+    }
+
+  /* Get the path of the image that is to be uploaded */
+  image_path = g_value_get_string (g_array_index (param_values, GValue*, 0));
+
+  /* Start the user soup session */
+  exo_job_info_message (EXO_JOB (job), _("Initialize the connection..."));
+  session = screenshooter_upload_session_get ();
+
+  TRACE ("Get the information liststore ready.");
+  liststore = gtk_list_store_new (2, G_TYPE_INT, G_TYPE_STRING);
+
+  TRACE ("Append the user");
+  gtk_list_store_append (liststore, &iter);
+  gtk_list_store_set (liststore, &iter,
+                      0, USER,
+                      1, user,
+                      -1);
+
+  TRACE ("Append the password");
+  gtk_list_store_append (liststore, &iter);
+  gtk_list_store_set (liststore, &iter,
+                      0, PASSWORD,
+                      1, password,
+                      -1);
+
+  TRACE ("Append the title");
+  gtk_list_store_append (liststore, &iter);
+  gtk_list_store_set (liststore, &iter,
+                      0, TITLE,
+                      1, title,
+                      -1);
+
+  TRACE ("Append the comment");
+  gtk_list_store_append (liststore, &iter);
+  gtk_list_store_set (liststore, &iter,
+                      0, COMMENT,
+                      1, comment,
+                      -1);
+
+  if (cached_session)
+    TRACE ("Reuse the session ID of the previous upload");
+  else if (!zimagez_ask_and_login (job, session, liststore,
+                                   _("Please fill the following fields with your "
+                                     "<a href=\"http://www.zimagez.com\">ZimageZ</a> \n"
+                                     "user name, passsword and details about the screenshot."),
+                                   &user, &password, &title, &comment,
+                                   &login_response, error))
+    {
+      g_object_unref (session);
+      g_object_unref (liststore);
+
+      g_free (user);
+      g_free (password);
+      g_free (title);
+      g_free (comment);
+
+      return FALSE;
+    }
+
+  g_object_set_data_full (G_OBJECT (job), "user",
+                          g_strdup (user), (GDestroyNotify) g_free);
+
+  /* Get the basename of the image path */
+  file_name = g_path_get_basename (image_path);
+
+  exo_job_info_message (EXO_JOB (job), _("Upload the screenshot..."));
+
+  /* The image is base64 encoded while it is sent */
+  TRACE ("Call the upload method");
+  do_xmlrpc_upload (session, ZIMAGEZ_API_URL, ZIMAGEZ_METHOD_UPLOAD, image_path,
+                    &tmp_error, &response_value,
+                    file_name,
+                    title,
+                    comment,
+                    login_response,
+                    NULL);
+
+  /* The session kept from a previous upload might have expired on the
+   * server, ask the user to log in again and retry once */
+  if (cached_session
+      && (tmp_error != NULL
+          || (G_VALUE_HOLDS_BOOLEAN (&response_value)
+              && !g_value_get_boolean (&response_value))))
+    {
+      TRACE ("The session ID was rejected, log in again");
+
+      g_clear_error (&tmp_error);
+
+      if (G_IS_VALUE (&response_value))
+        g_value_unset (&response_value);
+
+      g_free (zimagez_forget_session ());
+      g_free (login_response);
+      login_response = NULL;
+
+      if (zimagez_ask_and_login (job, session, liststore,
+                                 _("<span weight=\"bold\" foreground=\"darkred\" "
+                                   "stretch=\"semiexpanded\">Your ZimageZ session "
+                                   "has expired. Please log in again.</span>"),
+                                 &user, &password, &title, &comment,
+                                 &login_response, &tmp_error))
+        {
+          g_object_set_data_full (G_OBJECT (job), "user",
+                                  g_strdup (user), (GDestroyNotify) g_free);
+
+          exo_job_info_message (EXO_JOB (job), _("Upload the screenshot..."));
+
+          do_xmlrpc_upload (session, ZIMAGEZ_API_URL, ZIMAGEZ_METHOD_UPLOAD,
+                            image_path, &tmp_error, &response_value,
+                            file_name,
+                            title,
+                            comment,
+                            login_response,
+                            NULL);
+        }
+    }
+
+  g_object_unref (liststore);
+
+  g_free (user);
+  g_free (password);
+  g_free (title);
+  g_free (comment);
+  g_free (file_name);
+  g_free (login_response);
+
+  if (tmp_error)
+    {
+      g_object_unref (session);
+
+      g_propagate_error (error, tmp_error);
+
+      return FALSE;
+    }
+
+  /* If the response is a boolean, there was an error */
+  if (G_VALUE_HOLDS_BOOLEAN (&response_value))
+    {
+      if (!g_value_get_boolean (&response_value))
+        {
+          GError *tmp_err =
+            g_error_new (G_IO_ERROR, G_IO_ERROR_FAILED,
+                         _("An error occurred while uploading the screenshot."));
+
+          g_object_unref (session);
+          g_propagate_error (error, tmp_err);
+
+          return FALSE;
+        }
+    }
+  /* Else we get the file name */
+  else if (G_VALUE_HOLDS_STRING (&response_value))
+    {
+      TRACE ("The screenshot has been uploaded, get the file name.");
+      online_file_name = g_strdup (g_value_get_string (&response_value));
+    }
+  /* We received un unexpected reply */
+  else
+    {
+      GError *tmp_err =
+        g_error_new (SOUP_XMLRPC_FAULT,
+                     SOUP_XMLRPC_FAULT_PARSE_ERROR_NOT_WELL_FORMED,
+                     "%s", _("An unexpected reply from ZimageZ was received."
+                       " The upload of the screenshot failed."));
+      g_object_unref (session);
+      g_propagate_error (error, tmp_err);
+
+      return FALSE;
+    }
+
+  g_value_unset (&response_value);
+
+  /* The user session is not closed, the next uploads will reuse it. It is
+   * closed by screenshooter_zimagez_logout (). */
+  g_object_unref (session);
+
+  screenshooter_job_image_uploaded (job, online_file_name);
+  g_free (online_file_name);
+
+  return TRUE;
+}
+
+/* Public */
+
+/**
+ * screenshooter_upload_to_zimagez:
+ * @image_path: the local path of the image that should be uploaded to
+ * ZimageZ.com.
+ * @last_user: the last user name used, to pre-fill the user field.
+ * @title: a default title, to pre-fill the title field.
+ * @new_last_user: address of the string used to store the new user
+ * if the upload is succesful.
+ *
+ * Uploads the image whose path is @image_path: a dialog asks for the user
+ * login, password, a title for the image and a comment; then the image is
+ * uploaded. The dialog is shown again with a warning is the password did
+ * not match the user name. The user can also cancel the upload procedure.
+ *
+ * If the upload was succesful, @new_last_user points to the user name for
+ * which the upload was done.
+ *
+ **/
+
+void screenshooter_upload_to_zimagez (const gchar  *image_path,
+                                      const gchar  *last_user,
+                                      const gchar  *title,
+                                      gchar       **new_last_user)
+{
+  ScreenshooterJob *job;
+  GtkWidget *dialog, *label;
+
+  g_return_if_fail (image_path != NULL);
+  g_return_if_fail (new_last_user == NULL || *new_last_user == NULL);
+
+  dialog = create_throbber_dialog(_("ZimageZ"), &label);
+
+  job = screenshooter_simple_job_launch (zimagez_upload_job, 3,
+                                          G_TYPE_STRING, image_path,
+                                          G_TYPE_STRING, last_user,
+                                          G_TYPE_STRING, title);
+
+  g_signal_connect (job, "ask", G_CALLBACK (cb_ask_for_information), NULL);
+  g_signal_connect (job, "image-uploaded", G_CALLBACK (cb_image_uploaded), new_last_user);
+  g_signal_connect (job, "error", G_CALLBACK (cb_error), NULL);
+  g_signal_connect (job, "finished", G_CALLBACK (cb_finished), dialog);
+  g_signal_connect (job, "info-message", G_CALLBACK (cb_update_info), label);
+
+  gtk_dialog_run (GTK_DIALOG (dialog));
+}
+
+
+
+/**
+ * screenshooter_zimagez_logout:
+ *
+ * Closes the ZimageZ user session kept open by the previous uploads, if
+ * any. Should be called before the process exits.
+ **/
+void screenshooter_zimagez_logout (void)
+{
+  SoupSession *session;
+
+  G_LOCK (zimagez_session);
+
+  if (session_id == NULL)
+    {
+      G_UNLOCK (zimagez_session);
+      return;
+    }
+
+  G_UNLOCK (zimagez_session);
+
+  session = screenshooter_upload_session_get ();
+  zimagez_close_session (session);
+
+  g_object_unref (session);
+}
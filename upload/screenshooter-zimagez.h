@@ -32,10 +32,14 @@
 #include "screenshooter-simple-job.h"
 #include "katze-throbber.h"
 
+#define ZIMAGEZ_API_URL "http://www.zimagez.com/apiXml.php"
+
 void screenshooter_upload_to_zimagez (const gchar  *image_path,
                                       const gchar  *last_user,
                                       const gchar  *title,
                                       gchar       **new_last_user);
 
+void screenshooter_zimagez_logout    (void);
+
 
 #endif